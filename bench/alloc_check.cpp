@@ -0,0 +1,108 @@
+// 通过替换malloc统计堆内存分配次数，验证打印基础数据类型和结构化字段的日志全程没有堆内存分配
+#include <malloc.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "../src/Nlog.h"
+#include "../src/loggers/JsonFileLogger.h"
+#include "../src/loggers/RotateFileLogger.h"
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+static std::atomic<bool> g_counting(false);
+static std::atomic<uint64_t> g_alloc_count(0);
+
+static inline void CountAlloc()
+{
+    if (g_counting.load(std::memory_order_relaxed)) g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void* malloc(size_t size)
+{
+    CountAlloc();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    CountAlloc();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    CountAlloc();
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    CountAlloc();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    CountAlloc();
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr == nullptr ? ENOMEM : 0;
+}
+
+extern "C" void free(void* ptr) { __libc_free(ptr); }
+
+static void LogPrimitives(int i)
+{
+    LOG_INFO(alloc) << "int:" << i << " long:" << i * 1000003L << " double:" << i * 0.5 << " bool:" << (i % 2 == 0)
+                    << " char:" << 'x' << " str:" << "const char*";
+    LOG_INFO(alloc).kv("conn", i).kv("bytes", i * 1000003UL).kv("ratio", i * 0.5).kv("peer", "10.0.0.1:80")
+        << "closed";
+}
+
+// 统计iterations条日志的堆内存分配次数
+static uint64_t CountAllocations(int iterations)
+{
+    // 预热：第一次打印会分配线程级缓冲区、打开日志文件等，异步模式下还要等后台线程完成第一次输出
+    for (int i = 0; i < 16; ++i) LogPrimitives(i);
+    Nlog::Logging::FlushAllLoggers();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    g_alloc_count.store(0);
+    g_counting.store(true);
+    for (int i = 0; i < iterations; ++i) LogPrimitives(i);
+    g_counting.store(false);
+    return g_alloc_count.load();
+}
+
+int main()
+{
+    constexpr int kIterations = 10000;
+    char dir_name[] = "/tmp/nlog_alloc_check_XXXXXX";
+    if (mkdtemp(dir_name) == nullptr) return 1;
+
+    Nlog::Logging::SetLogSeverity(Nlog::LogSeverity::INFO);
+    Nlog::Logging::AddLogger(Nlog::RotateFileLogger::Create(dir_name));
+    Nlog::Logging::AddLogger(Nlog::JsonFileLogger::Create(std::string(dir_name) + "/app.json"));
+
+    uint64_t sync_allocs = CountAllocations(kIterations);
+    printf("sync  mode: %llu allocations for %d iterations\n", static_cast<unsigned long long>(sync_allocs), kIterations);
+
+    Nlog::Logging::EnableAsyncMode();
+    uint64_t async_allocs = CountAllocations(kIterations);
+    Nlog::Logging::DisableAsyncMode();
+    printf("async mode: %llu allocations for %d iterations\n", static_cast<unsigned long long>(async_allocs), kIterations);
+
+    Nlog::Logging::ShutDown();
+    std::string rm_cmd = std::string("rm -rf ") + dir_name;
+    (void)system(rm_cmd.c_str());
+    return (sync_allocs == 0 && async_allocs == 0) ? 0 : 1;
+}
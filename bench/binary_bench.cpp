@@ -0,0 +1,74 @@
+// 文本日志与二进制日志的单条延迟、磁盘字节数对比
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "../src/Nlog.h"
+#include "../src/loggers/RotateFileLogger.h"
+
+namespace
+{
+constexpr int kIterations = 1000000;
+
+template <typename Func>
+double Run(Func func)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        func(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / kIterations;
+}
+
+// 统计目录下所有文件的字节数
+long long GetDirectoryBytes(const std::string& dir)
+{
+    std::string cmd = "du -sb " + dir;
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (pipe == nullptr) return -1;
+    long long bytes = -1;
+    if (fscanf(pipe, "%lld", &bytes) != 1) bytes = -1;
+    pclose(pipe);
+    return bytes;
+}
+}  // namespace
+
+int main()
+{
+    char text_dir[] = "/tmp/nlog_binary_bench_text_XXXXXX";
+    char binary_dir[] = "/tmp/nlog_binary_bench_bin_XXXXXX";
+    if (mkdtemp(text_dir) == nullptr || mkdtemp(binary_dir) == nullptr) return 1;
+    const std::string binary_file = std::string(binary_dir) + "/bench.nlog";
+    const std::string peer = "10.0.0.1:8080";
+
+    Nlog::Logging::SetLogSeverity(Nlog::INFO);
+    Nlog::Logging::AddLogger(Nlog::RotateFileLogger::Create(text_dir));
+
+    Nlog::Logging::EnableAsyncMode(1 << 16);
+    double text_ns = Run([&](int i) {
+        LOG_INFO(net) << "recv fd:" << i << " bytes:" << i * 13L << " peer:" << peer << " ratio:" << i * 0.5;
+    });
+    Nlog::Logging::DisableAsyncMode();
+    Nlog::Logging::FlushAllLoggers();
+
+    Nlog::Logging::EnableBinaryMode(binary_file, 1 << 22);
+    double binary_ns = Run([&](int i) {
+        LOG_BINARY(INFO, net, "recv fd:%d bytes:%ld peer:%s ratio:%f", i, i * 13L, peer, i * 0.5);
+    });
+    Nlog::Logging::DisableBinaryMode();
+
+    printf("%-24s %8.1f ns/op %12lld bytes\n", "text(async)", text_ns, GetDirectoryBytes(text_dir));
+    printf("%-24s %8.1f ns/op %12lld bytes\n", "binary", binary_ns, GetDirectoryBytes(binary_dir));
+    printf("dropped: async %llu, binary %llu\n", static_cast<unsigned long long>(Nlog::Logging::GetAsyncDroppedCount()),
+           static_cast<unsigned long long>(Nlog::Logging::GetBinaryDroppedCount()));
+
+    Nlog::Logging::ShutDown();
+    std::string rm_cmd = std::string("rm -rf ") + text_dir + " " + binary_dir;
+    (void)system(rm_cmd.c_str());
+    return 0;
+}
@@ -0,0 +1,78 @@
+// LogStream与原std::ostream + 定长streambuf格式化路径的性能对比
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+#include "../src/details/LogStream.h"
+
+namespace
+{
+// 两种格式化路径使用相同大小的定长缓冲区
+constexpr size_t kBufferSize = 4096;
+
+// 原LogMessage使用的定长缓冲区，溢出的字符直接丢弃
+class FixedStreamBuf : public std::streambuf
+{
+  public:
+    FixedStreamBuf() { setp(buffer_, buffer_ + sizeof(buffer_)); }
+    size_t GetCount() const { return pptr() - pbase(); }
+
+  protected:
+    int_type overflow(int_type ch) override { return ch; }
+
+  private:
+    char buffer_[kBufferSize];
+};
+
+// 防止编译器优化掉格式化结果
+volatile size_t g_sink = 0;
+
+// LogStream使用的缓冲区，与LogMessage一样在每个线程内复用
+char g_buffer[kBufferSize + Nlog::LogStream::kReservedSize];
+
+template <typename Func>
+void Run(const char* name, int iterations, Func func)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        g_sink = g_sink + func(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+    printf("%-28s %8.1f ns/op\n", name, ns);
+}
+
+// 每个用例构造一个新的格式化对象，与每条日志新建LogMessage的情况一致
+#define BENCH_CASE(NAME, EXPR)                                                 \
+    Run("ostream/" NAME, kIterations, [&](int i) -> size_t {                   \
+        FixedStreamBuf buf;                                                    \
+        std::ostream stream(&buf);                                             \
+        stream << std::fixed;                                                  \
+        stream << EXPR;                                                        \
+        return buf.GetCount();                                                 \
+    });                                                                        \
+    Run("LogStream/" NAME, kIterations, [&](int i) -> size_t {                 \
+        Nlog::LogStream stream(g_buffer, kBufferSize);        \
+        stream << EXPR;                                                        \
+        return stream.GetCount();                                              \
+    });
+}  // namespace
+
+int main()
+{
+    constexpr int kIterations = 1000000;
+    const std::string str = "connection closed by peer";
+    const char* cstr = "hello world";
+
+    BENCH_CASE("int", i << ' ' << -i << ' ' << i * 7919L)
+    BENCH_CASE("long", static_cast<long>(i) * 1000003L << ' ' << static_cast<unsigned long>(i) * 99991UL)
+    BENCH_CASE("hex", std::hex << i << ' ' << i * 31)
+    BENCH_CASE("double_fixed", i * 0.001 << ' ' << i * 3.14159)
+    BENCH_CASE("double_shortest", std::defaultfloat << i * 0.001 << ' ' << i * 3.14159)
+    BENCH_CASE("string", str << ' ' << cstr << ' ' << str)
+    BENCH_CASE("mixed", "<net>" << str << " fd:" << i << " bytes:" << i * 13L << " ratio:" << i * 0.5)
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+// 被关闭的日志语句的开销：运行时等级判断与编译期移除
+#include <chrono>
+#include <cstdio>
+
+#include "../src/Nlog.h"
+
+// 定义在level_bench_stripped.cpp，该文件以NLOG_ACTIVE_LEVEL=NLOG_LEVEL_INFO编译，其中的LOG_VERBOSE被编译期移除
+void LogStrippedVerbose(int i);
+
+namespace
+{
+// 防止编译器把循环整体优化掉
+volatile int g_sink = 0;
+
+// 不打印日志的空循环，作为基准
+__attribute__((noinline)) void LogNothing(int i) { g_sink = i; }
+
+// 运行时等级为INFO时的LOG_VERBOSE，只做一次等级判断
+__attribute__((noinline)) void LogRuntimeDisabledVerbose(int i)
+{
+    LOG_VERBOSE(bench) << "value:" << i << " ratio:" << i * 0.5;
+    g_sink = i;
+}
+
+// 每个用例重复测量的轮数，取最快的一轮，减少调度和频率变化带来的抖动
+constexpr int kRounds = 5;
+
+template <typename Func>
+double Run(const char* name, int iterations, Func func)
+{
+    double best_ns = 0;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            func(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    printf("%-28s %8.2f ns/op\n", name, best_ns);
+    return best_ns;
+}
+}  // namespace
+
+int main()
+{
+    constexpr int kIterations = 20000000;
+    Nlog::Logging::SetLogSeverity(Nlog::INFO);
+
+    double baseline = Run("baseline", kIterations, LogNothing);
+    double runtime = Run("runtime_disabled", kIterations, LogRuntimeDisabledVerbose);
+    double stripped = Run("compile_time_stripped", kIterations, LogStrippedVerbose);
+    printf("disabled statement cost: runtime %.2f ns, compile time %.2f ns\n", runtime - baseline,
+           stripped - baseline);
+    return 0;
+}
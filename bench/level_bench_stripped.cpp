@@ -0,0 +1,14 @@
+// 以INFO为编译期等级阈值编译，LOG_VERBOSE和LOG_DEBUG不会生成任何代码
+#define NLOG_ACTIVE_LEVEL NLOG_LEVEL_INFO
+#include "../src/Nlog.h"
+
+namespace
+{
+volatile int g_sink = 0;
+}  // namespace
+
+__attribute__((noinline)) void LogStrippedVerbose(int i)
+{
+    LOG_VERBOSE(bench) << "value:" << i << " ratio:" << i * 0.5;
+    g_sink = i;
+}
@@ -0,0 +1,419 @@
+// 综合性能基准：被关闭的日志语句、头部格式化、容器格式化、各日志输出后端在1~N个线程下的吞吐和延迟分位数。
+// 每项结果以一行JSON输出到标准输出（JSON Lines），便于脚本对比不同版本；同时在标准错误输出可读的汇总。
+// 用法：nlog_bench [--threads=N] [--messages=N] [--filter=子串]
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/Nlog.h"
+#include "../src/details/HeaderPattern.h"
+#include "../src/loggers/ConsoleLogger.h"
+#include "../src/loggers/JsonFileLogger.h"
+#include "../src/loggers/RotateFileLogger.h"
+#include "../src/loggers/StdoutLogger.h"
+
+// 定义在level_bench_stripped.cpp，该文件以NLOG_ACTIVE_LEVEL=NLOG_LEVEL_INFO编译，其中的LOG_VERBOSE被编译期移除
+void LogStrippedVerbose(int i);
+
+namespace
+{
+// 防止编译器把循环整体优化掉
+volatile size_t g_sink = 0;
+
+// 结果输出，启动时复制标准输出，测试StdoutLogger时标准输出会被重定向到/dev/null
+FILE* g_results = stdout;
+// 只运行名字包含该子串的测试项
+std::string g_filter;
+
+struct Options
+{
+    int max_threads = 0;
+    int messages = 200000;
+};
+
+bool Selected(const std::string& name) { return g_filter.empty() || name.find(g_filter) != std::string::npos; }
+
+// 单线程ns/op类的结果
+void EmitTiming(const char* group, const std::string& name, double ns_per_op)
+{
+    fprintf(g_results, "{\"group\":\"%s\",\"case\":\"%s\",\"ns_per_op\":%.2f}\n", group, name.c_str(), ns_per_op);
+    fflush(g_results);
+    fprintf(stderr, "%-12s %-36s %10.2f ns/op\n", group, name.c_str(), ns_per_op);
+}
+
+// 需要扣除空循环开销的结果：分别输出原始的ns/op和基准，差值小于0（测量抖动）时按0输出
+void EmitTiming(const char* group, const std::string& name, double ns_per_op, double baseline_ns)
+{
+    double over_baseline_ns = std::max(ns_per_op - baseline_ns, 0.0);
+    fprintf(g_results,
+            "{\"group\":\"%s\",\"case\":\"%s\",\"ns_per_op\":%.2f,\"baseline_ns\":%.2f,"
+            "\"over_baseline_ns\":%.2f}\n",
+            group, name.c_str(), ns_per_op, baseline_ns, over_baseline_ns);
+    fflush(g_results);
+    fprintf(stderr, "%-12s %-36s %10.2f ns/op (baseline %.2f, +%.2f)\n", group, name.c_str(), ns_per_op, baseline_ns,
+            over_baseline_ns);
+}
+
+// 吞吐和延迟分位数类的结果
+struct ThroughputResult
+{
+    double ops_per_sec;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+};
+
+void EmitThroughput(const std::string& name, const char* mode, int threads, const ThroughputResult& r)
+{
+    fprintf(g_results,
+            "{\"group\":\"sink\",\"case\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"ops_per_sec\":%.0f,"
+            "\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"p999_ns\":%.0f,\"max_ns\":%.0f}\n",
+            name.c_str(), mode, threads, r.ops_per_sec, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns);
+    fflush(g_results);
+    fprintf(stderr, "%-12s %-20s %-5s threads=%-3d %12.0f msg/s  p50=%-7.0f p99=%-7.0f p99.9=%-8.0f max=%.0f ns\n",
+            "sink", name.c_str(), mode, threads, r.ops_per_sec, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns);
+}
+
+template <typename Func>
+double MeasureNsPerOp(int iterations, Func func)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        func(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+// ---------------- 被关闭的日志语句 ----------------
+
+__attribute__((noinline)) void LogNothing(int i) { g_sink = i; }
+
+__attribute__((noinline)) void LogRuntimeDisabledVerbose(int i)
+{
+    LOG_VERBOSE(bench) << "value:" << i << " ratio:" << i * 0.5;
+    g_sink = i;
+}
+
+__attribute__((noinline)) void LogRuntimeDisabledKv(int i)
+{
+    LOG_VERBOSE(bench).kv("value", i).kv("ratio", i * 0.5) << "disabled";
+    g_sink = i;
+}
+
+void BenchDisabled()
+{
+    constexpr int kIterations = 50000000;
+    Nlog::Logging::SetLogSeverity(Nlog::INFO);
+    double baseline = MeasureNsPerOp(kIterations, LogNothing);
+    if (Selected("disabled/runtime"))
+    {
+        EmitTiming("disabled", "runtime", MeasureNsPerOp(kIterations, LogRuntimeDisabledVerbose), baseline);
+    }
+    if (Selected("disabled/runtime_kv"))
+    {
+        EmitTiming("disabled", "runtime_kv", MeasureNsPerOp(kIterations, LogRuntimeDisabledKv), baseline);
+    }
+    if (Selected("disabled/compile_time"))
+    {
+        EmitTiming("disabled", "compile_time", MeasureNsPerOp(kIterations, LogStrippedVerbose), baseline);
+    }
+}
+
+// ---------------- 头部格式化 ----------------
+
+void BenchHeader()
+{
+    static const struct
+    {
+        const char* name;
+        const char* pattern;
+    } kPatterns[] = {
+        {"default", "[%Y-%M-%D %h:%m:%s.%i][%V][%T][%F:%L][%U]"},
+        {"datetime", "[%Y-%M-%D %h:%m:%s.%i]"},
+        {"time_level", "[%h:%m:%s][%v]"},
+        {"source", "[%F:%L][%U]"},
+        {"level_only", "[%V]"},
+    };
+    constexpr int kIterations = 5000000;
+
+    static const char kText[] = "header bench\n";
+    const Nlog::LogSite& site = *NLOG_LOG_SITE(INFO, bench);
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    char buf[Nlog::HeaderPattern::kMaxHeaderSize];
+    for (const auto& p : kPatterns)
+    {
+        std::string name = std::string("header/") + p.name;
+        if (!Selected(name)) continue;
+        Nlog::HeaderPattern pattern(p.pattern);
+        // 每次推进1ms，让时间字段的缓存按真实的日志流量命中和失效
+        EmitTiming("header", p.name, MeasureNsPerOp(kIterations, [&](int i) {
+                       tv.tv_usec = (i % 1000) * 1000;
+                       Nlog::LogMessage log_message(site, tv, 12345, kText, sizeof(kText) - 1);
+                       g_sink = g_sink + pattern.Format(log_message, buf, sizeof(buf));
+                   }));
+    }
+}
+
+// ---------------- 日志文本和容器格式化 ----------------
+
+// 只格式化不输出
+void DiscardLog(const Nlog::LogMessage& log_message) { g_sink = g_sink + log_message.GetLogTextLength(); }
+
+#define BENCH_LOG_MESSAGE() Nlog::LogMessage(*NLOG_LOG_SITE(INFO, bench), &DiscardLog)
+
+void BenchFormat()
+{
+    constexpr int kIterations = 2000000;
+    std::vector<int> vector_int{1, 2, 3, 4, 5, 6, 7, 8};
+    std::vector<std::string> vector_string{"alpha", "beta", "gamma", "delta"};
+    std::map<std::string, int> map_string_int{{"one", 1}, {"two", 2}, {"three", 3}, {"four", 4}};
+    std::deque<double> deque_double{0.5, 1.25, 2.125, 3.0625};
+    // 大队列只输出前几个元素，格式化的开销与队列长度无关
+    std::queue<int> queue_large;
+    for (int i = 0; i < 1000000; ++i) queue_large.push(i);
+
+    auto run = [](const char* name, std::function<void(int)> func) {
+        if (Selected(std::string("format/") + name)) EmitTiming("format", name, MeasureNsPerOp(kIterations, func));
+    };
+    run("empty", [](int) { BENCH_LOG_MESSAGE() << ""; });
+    run("primitives", [](int i) {
+        BENCH_LOG_MESSAGE() << "int:" << i << " long:" << i * 1000003L << " double:" << i * 0.5
+                            << " bool:" << (i % 2 == 0) << " str:" << "const char*";
+    });
+    run("kv", [](int i) {
+        BENCH_LOG_MESSAGE().kv("conn", i).kv("bytes", i * 1000003UL).kv("ratio", i * 0.5).kv("peer", "10.0.0.1:80")
+            << "closed";
+    });
+    run("vector_int", [&](int) { BENCH_LOG_MESSAGE() << vector_int; });
+    run("vector_string", [&](int) { BENCH_LOG_MESSAGE() << vector_string; });
+    run("map_string_int", [&](int) { BENCH_LOG_MESSAGE() << map_string_int; });
+    run("deque_double", [&](int) { BENCH_LOG_MESSAGE() << deque_double; });
+    run("pair", [](int i) { BENCH_LOG_MESSAGE() << std::make_pair(i, "second"); });
+    run("tuple", [](int i) { BENCH_LOG_MESSAGE() << std::make_tuple(i, "second", i * 0.5); });
+    run("queue_1m", [&](int) { BENCH_LOG_MESSAGE() << queue_large; });
+}
+
+// ---------------- 日志输出后端 ----------------
+
+// 不输出任何内容的后端，只测量日志前端（格式化、分发、异步队列）的开销
+class NullLogger : public Nlog::Logger
+{
+  public:
+    NullLogger() : Logger("null") {}
+    void Write(const Nlog::LogMessage& log_message) override { g_sink = g_sink + log_message.GetLogTextLength(); }
+    void Flush() override {}
+};
+
+// threads个线程共打印messages条日志，记录每条日志调用的耗时
+ThroughputResult RunThreads(int threads, int messages)
+{
+    int per_thread = messages / threads;
+    std::vector<std::vector<uint32_t>> latencies(threads, std::vector<uint32_t>(per_thread));
+    std::atomic<int> ready(0);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            std::vector<uint32_t>& samples = latencies[t];
+            ready.fetch_add(1);
+            while (!start.load(std::memory_order_acquire))
+            {
+            }
+            for (int i = 0; i < per_thread; ++i)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                LOG_INFO(bench) << "thread:" << t << " seq:" << i << " value:" << i * 0.5 << " payload";
+                auto end = std::chrono::steady_clock::now();
+                samples[i] = static_cast<uint32_t>(
+                    std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(),
+                                      UINT32_MAX));
+            }
+        });
+    }
+    while (ready.load() < threads)
+    {
+        std::this_thread::yield();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    // 吞吐包括把缓冲区中的日志真正写出的时间
+    Nlog::Logging::FlushAllLoggers();
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> all;
+    all.reserve(static_cast<size_t>(per_thread) * threads);
+    for (const auto& samples : latencies)
+    {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+        return static_cast<double>(all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]);
+    };
+
+    ThroughputResult result;
+    result.ops_per_sec = all.size() / std::chrono::duration<double>(end - begin).count();
+    result.p50_ns = percentile(0.50);
+    result.p99_ns = percentile(0.99);
+    result.p999_ns = percentile(0.999);
+    result.max_ns = all.back();
+    return result;
+}
+
+std::vector<int> ThreadCounts(int max_threads)
+{
+    std::vector<int> counts;
+    for (int n = 1; n < max_threads; n *= 2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+void BenchSinks(const Options& options, const std::string& dir_name)
+{
+    struct SinkCase
+    {
+        const char* name;
+        std::function<Nlog::LoggerPtr()> create;
+    };
+    const SinkCase kSinks[] = {
+        {"null", []() { return std::make_shared<NullLogger>(); }},
+        {"stdout_devnull", []() { return std::make_shared<Nlog::StdoutLogger>(); }},
+        {"console_devnull", []() { return Nlog::ConsoleLogger::Create(); }},
+        {"rotate_file", [&dir_name]() { return Nlog::RotateFileLogger::Create(dir_name + "/rotate"); }},
+        {"json_file", [&dir_name]() { return Nlog::JsonFileLogger::Create(dir_name + "/json/bench.json"); }},
+    };
+
+    Nlog::Logging::SetLogSeverity(Nlog::INFO);
+    for (const auto& sink : kSinks)
+    {
+        for (int async = 0; async < 2; ++async)
+        {
+            const char* mode = async ? "async" : "sync";
+            std::string name = std::string("sink/") + sink.name + "/" + mode;
+            if (!Selected(name)) continue;
+
+            // StdoutLogger和ConsoleLogger写到/dev/null，排除终端的影响
+            int saved_stdout = -1;
+            if (strstr(sink.name, "_devnull") != nullptr)
+            {
+                fflush(stdout);
+                saved_stdout = dup(STDOUT_FILENO);
+                int dev_null = open("/dev/null", O_WRONLY);
+                dup2(dev_null, STDOUT_FILENO);
+                close(dev_null);
+            }
+
+            Nlog::LoggerPtr logger = sink.create();
+            if (logger == nullptr)
+            {
+                fprintf(stderr, "create logger %s failed\n", sink.name);
+                continue;
+            }
+            Nlog::Logging::AddLogger(logger);
+            for (int threads : ThreadCounts(options.max_threads))
+            {
+                if (async) Nlog::Logging::EnableAsyncMode(8192, false);
+                ThroughputResult result = RunThreads(threads, options.messages);
+                // 停止时等待队列中的日志全部输出
+                if (async) Nlog::Logging::DisableAsyncMode();
+                EmitThroughput(sink.name, mode, threads, result);
+            }
+            Nlog::Logging::RemoveLogger(logger->GetName());
+            // 析构时写出缓冲区中剩余的日志，之后才能恢复标准输出
+            logger.reset();
+
+            if (saved_stdout >= 0)
+            {
+                std::cout.flush();
+                fflush(stdout);
+                dup2(saved_stdout, STDOUT_FILENO);
+                close(saved_stdout);
+            }
+        }
+    }
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--threads=", 10) == 0)
+        {
+            options.max_threads = atoi(arg + 10);
+        }
+        else if (strncmp(arg, "--messages=", 11) == 0)
+        {
+            options.messages = atoi(arg + 11);
+        }
+        else if (strncmp(arg, "--filter=", 9) == 0)
+        {
+            g_filter = arg + 9;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--threads=N] [--messages=N] [--filter=substring]\n", argv[0]);
+            return false;
+        }
+    }
+    if (options.max_threads <= 0)
+    {
+        options.max_threads = std::max(1, std::min(8, static_cast<int>(std::thread::hardware_concurrency())));
+    }
+    if (options.messages < options.max_threads) options.messages = options.max_threads;
+    return true;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) return 1;
+
+    // 结果写到复制出来的标准输出，不受StdoutLogger测试时的重定向影响
+    int results_fd = dup(STDOUT_FILENO);
+    g_results = fdopen(results_fd, "w");
+    if (g_results == nullptr) return 1;
+
+    char dir_name[] = "/tmp/nlog_bench_XXXXXX";
+    if (mkdtemp(dir_name) == nullptr) return 1;
+
+    BenchDisabled();
+    BenchHeader();
+    BenchFormat();
+    BenchSinks(options, dir_name);
+
+    Nlog::Logging::ShutDown();
+    std::string rm_cmd = std::string("rm -rf ") + dir_name;
+    (void)system(rm_cmd.c_str());
+    fclose(g_results);
+    return 0;
+}
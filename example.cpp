@@ -35,6 +35,12 @@ int main()
         LOG_DEBUG(double) << d;
         LOG_DEBUG(char*) << e;
     }
+    {
+        LOG_VERBOSE(-- -) << "结构化字段:";
+        int conn = 42;
+        size_t bytes = 1024;
+        LOG_INFO(net).kv("conn", conn).kv("bytes", bytes).kv("peer", "10.0.0.1:80") << "closed";
+    }
     {
         LOG_VERBOSE(-- -) << "容器类型:";
         std::vector<std::string> a{"str1", "str2"};
@@ -70,6 +76,13 @@ int main()
         j.push(3);
         j.push(4);
         LOG_DEBUG(stack) << j;
+        std::unordered_map<std::string, int> k{{"one", 1}};
+        LOG_DEBUG(unordered_map) << k;
+        std::array<int, 5> l{{1, 2, 3, 4, 5}};
+        LOG_DEBUG(array) << l;
+        LOG_DEBUG(tuple) << std::make_tuple(1, "str", 2.5);
+        // 单次指定最多输出的元素个数和分隔符
+        LOG_DEBUG(LogContainer) << Nlog::LogContainer(l, Nlog::ContainerFormat::kUnlimited, " ");
     }
     {
         LOG_DEBUG(#) << 1.123456789;
@@ -77,6 +90,16 @@ int main()
         LOG_DEBUG(#) << 0x12;
         LOG_DEBUG(#) << 012;
     }
+    {
+        LOG_VERBOSE(-- -) << "限频与采样:";
+        for (int i = 0; i < 10; ++i)
+        {
+            LOG_EVERY_N(INFO, every_n, 3) << "every 3, i:" << i;
+            LOG_FIRST_N(INFO, first_n, 2) << "first 2, i:" << i;
+            LOG_EVERY_T(INFO, every_t, 1) << "every 1s, i:" << i;
+            LOG_SAMPLED(INFO, sampled, 0.5) << "sampled 50%, i:" << i;
+        }
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -1,72 +1,113 @@
 #include "Nlog.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
+#include "details/AsyncLogWorker.h"
+#include "details/BinaryLogWriter.h"
+#include "details/LogDeduplicator.h"
+#include "details/LoggerRegistry.h"
 #include "details/PeriodicWorker.h"
 #include "details/Utils.h"
 
 namespace Nlog {
 // 打印日志等级
-static LogSeverity g_log_severity = DEBUG;
+std::atomic<int> Logging::log_severity_(kDefaultLogSeverity);
+std::atomic<uint32_t> Logging::plug_logger_mask_(0);
 
 // 日志输出后端
-static std::vector<LoggerPtr> g_loggers;
+static LoggerRegistry g_loggers;
 
 // 定时刷新日志
 static std::unique_ptr<PeriodicWorker> periodic_flusher_;
+// 定时打印统计
+static std::unique_ptr<PeriodicWorker> periodic_stats_dumper_;
+// 定时输出不再打印日志的线程留下的重复日志汇总
+static std::unique_ptr<PeriodicWorker> periodic_dedup_sweeper_;
+// 定时汇总的最小间隔，折叠窗口更短时也不会更频繁地遍历所有线程的表
+constexpr std::chrono::milliseconds kMinDedupSweepInterval(10);
 
-void Logging::SetLogSeverity(LogSeverity log_severity) { g_log_severity = log_severity; }
+// 异步日志后台线程，为空表示同步模式
+static std::atomic<AsyncLogWorker*> g_async_worker(nullptr);
+// 持有异步日志后台线程。关闭异步模式后对象只停止不释放，避免并发的业务线程访问已释放的对象
+static std::unique_ptr<AsyncLogWorker> g_async_worker_holder;
+// 重复开启异步模式时被替换下来的后台线程，停止时已经释放了队列，只保留很小的对象
+static std::vector<std::unique_ptr<AsyncLogWorker>> g_retired_async_workers;
+// 保护异步模式的开启和关闭
+static std::mutex g_async_mutex;
 
-LogSeverity Logging::GetLogSeverity() { return g_log_severity; }
+// 二进制日志后台线程，与异步模式一样关闭后只停止不释放
+static std::unique_ptr<BinaryLogWriter> g_binary_writer_holder;
+static std::vector<std::unique_ptr<BinaryLogWriter>> g_retired_binary_writers;
+static std::mutex g_binary_mutex;
 
-bool Logging::IsLogSeverityOn(LogSeverity log_severity) { return log_severity >= GetLogSeverity(); }
-
-bool Logging::AddLogger(const LoggerPtr& logger)
+// 同步输出日志到当前所有的日志输出后端
+static void WriteToAllLoggers(const LogMessage& log_message)
 {
-    if (logger == nullptr) return false;
-
-    for (auto& g_logger : g_loggers)
+    LoggerRegistry::Snapshot loggers(g_loggers);
+    for (auto& logger : loggers)
     {
-        if (g_logger->GetName() == logger->GetName())
-        {
-            return false;
-        }
+        logger->Write(log_message);
     }
+}
 
-    g_loggers.push_back(logger);
-    return true;
+void Logging::SetLogSeverity(LogSeverity log_severity)
+{
+    log_severity_.store(log_severity, std::memory_order_relaxed);
+    LogSite::InvalidateSeverityCache();
+}
+
+void Logging::SetModuleSeverity(const std::string& module_name, LogSeverity log_severity)
+{
+    LogSite::SetModuleSeverity(module_name, log_severity);
 }
 
-bool Logging::RemoveLogger(const std::string& name)
+void Logging::SetFileSeverity(const std::string& pattern, LogSeverity log_severity)
 {
-    for (size_t i = 0; i < g_loggers.size(); i++)
+    LogSite::SetFileSeverity(pattern, log_severity);
+}
+
+void Logging::ClearModuleSeverities() { LogSite::ClearSeverityRules(); }
+
+bool Logging::AddLogger(const LoggerPtr& logger) { return g_loggers.Add(logger); }
+
+bool Logging::RemoveLogger(const std::string& name) { return g_loggers.Remove(name); }
+
+// 输出日志消息，异步模式下交给后台线程
+static void DispatchToLoggers(const LogMessage& log_message)
+{
+    AsyncLogWorker* async_worker = g_async_worker.load(std::memory_order_acquire);
+    if (async_worker != nullptr && async_worker->Push(log_message))
     {
-        if (g_loggers[i]->GetName() == name)
-        {
-            // 交换当前的Logger和最后的Logger
-            g_loggers[i] = g_loggers.back();
-            g_loggers.pop_back();
-            return true;
-        }
+        return;
     }
-    return false;
+    WriteToAllLoggers(log_message);
 }
 
 void Logging::LogToAllLoggers(const LogMessage& log_message)
 {
-    for (auto& logger : g_loggers)
+    // 重复日志在进入异步队列之前折叠，不占用队列
+    if (NLOG_UNLIKELY(LogDeduplicator::IsEnabled()) && LogDeduplicator::Filter(log_message, &DispatchToLoggers))
     {
-        logger->Write(log_message);
+        return;
     }
+    DispatchToLoggers(log_message);
 }
 
 void Logging::FlushAllLoggers()
 {
-    for (auto& logger : g_loggers)
     {
-        logger->Flush();
+        LoggerRegistry::Snapshot loggers(g_loggers);
+        for (auto& logger : loggers)
+        {
+            logger->Flush();
+        }
     }
+    // 顺便释放移除后端时因为有线程正在读而没能释放的旧快照
+    g_loggers.Reclaim();
 }
 
 void Logging::LogToStdout(const LogMessage& log_message)
@@ -86,59 +127,255 @@ void Logging::FlushEvery(std::chrono::seconds interval)
     periodic_flusher_ = make_unique<PeriodicWorker>(&Logging::FlushAllLoggers, interval);
 }
 
-void Logging::ShutDown() { periodic_flusher_.reset(); }
+void Logging::EnableAsyncMode(size_t queue_capacity, bool drop_when_full)
+{
+    std::lock_guard<std::mutex> lock(g_async_mutex);
+    if (g_async_worker_holder)
+    {
+        // 旧的后台线程输出完剩余日志后退出
+        g_async_worker.store(nullptr, std::memory_order_release);
+        g_async_worker_holder->Stop();
+        g_retired_async_workers.push_back(std::move(g_async_worker_holder));
+    }
+    g_async_worker_holder = make_unique<AsyncLogWorker>(&WriteToAllLoggers, queue_capacity, drop_when_full);
+    g_async_worker.store(g_async_worker_holder.get(), std::memory_order_release);
+}
 
-static Logging::PlugLogFunc plug_log_verbose = nullptr;
-static Logging::PlugLogFunc plug_log_info = nullptr;
-static Logging::PlugLogFunc plug_log_debug = nullptr;
-static Logging::PlugLogFunc plug_log_warn = nullptr;
-static Logging::PlugLogFunc plug_log_error = nullptr;
-static Logging::PlugLogFunc plug_log_fatal = nullptr;
+void Logging::DisableAsyncMode()
+{
+    std::lock_guard<std::mutex> lock(g_async_mutex);
+    g_async_worker.store(nullptr, std::memory_order_release);
+    if (g_async_worker_holder)
+    {
+        g_async_worker_holder->Stop();
+    }
+}
 
-void Logging::SetPlugLoggerFuncs(PlugLogFunc log_verbose, PlugLogFunc log_debug, PlugLogFunc log_info,
-                                 PlugLogFunc log_warn, PlugLogFunc log_error, PlugLogFunc log_fatal)
+bool Logging::IsAsyncMode() { return g_async_worker.load(std::memory_order_acquire) != nullptr; }
+
+uint64_t Logging::GetAsyncDroppedCount()
 {
-    plug_log_verbose = log_verbose;
-    plug_log_debug = log_debug;
-    plug_log_info = log_info;
-    plug_log_warn = log_warn;
-    plug_log_error = log_error;
-    plug_log_fatal = log_fatal;
+    std::lock_guard<std::mutex> lock(g_async_mutex);
+    return g_async_worker_holder ? g_async_worker_holder->GetDroppedCount() : 0;
 }
 
-bool Logging::IsPlugLoggerValid(LogSeverity log_severity)
+bool Logging::EnableBinaryMode(const std::string& file_path, size_t thread_buffer_size, bool drop_when_full)
 {
-    if (log_severity == LogSeverity::VERBOSE)
+    std::lock_guard<std::mutex> lock(g_binary_mutex);
+    if (g_binary_writer_holder)
     {
-        return plug_log_verbose != nullptr;
+        // 旧的后台线程写完剩余记录后退出，之后才能打开新文件，否则写到同一个文件时
+        // 新文件的魔数会插在旧的记录中间
+        BinaryLogWriter::SetCurrent(nullptr);
+        g_binary_writer_holder->Stop();
+        g_retired_binary_writers.push_back(std::move(g_binary_writer_holder));
     }
-    else if (log_severity == LogSeverity::DEBUG)
+
+    std::unique_ptr<BinaryLogWriter> writer = BinaryLogWriter::Create(file_path, thread_buffer_size, drop_when_full);
+    if (!writer) return false;
+    g_binary_writer_holder = std::move(writer);
+    BinaryLogWriter::SetCurrent(g_binary_writer_holder.get());
+    return true;
+}
+
+void Logging::DisableBinaryMode()
+{
+    std::lock_guard<std::mutex> lock(g_binary_mutex);
+    BinaryLogWriter::SetCurrent(nullptr);
+    if (g_binary_writer_holder)
     {
-        return plug_log_debug != nullptr;
+        g_binary_writer_holder->Stop();
     }
-    else if (log_severity == LogSeverity::INFO)
+}
+
+bool Logging::IsBinaryMode() { return BinaryLogWriter::GetCurrent() != nullptr; }
+
+uint64_t Logging::GetBinaryDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(g_binary_mutex);
+    return g_binary_writer_holder ? g_binary_writer_holder->GetDroppedCount() : 0;
+}
+
+static void SweepDedup() { LogDeduplicator::EmitExpired(&DispatchToLoggers); }
+
+void Logging::EnableDedup(std::chrono::milliseconds window)
+{
+    periodic_dedup_sweeper_.reset();
+    LogDeduplicator::SetWindow(window);
+    if (window.count() > 0)
     {
-        return plug_log_info != nullptr;
+        periodic_dedup_sweeper_ =
+            make_unique<PeriodicWorker>(&SweepDedup, std::max(window, kMinDedupSweepInterval));
     }
-    else if (log_severity == LogSeverity::WARN)
+}
+
+void Logging::DisableDedup()
+{
+    periodic_dedup_sweeper_.reset();
+    LogDeduplicator::SetWindow(std::chrono::microseconds(0));
+    LogDeduplicator::FlushAll(&DispatchToLoggers);
+}
+
+uint64_t Logging::GetDedupSuppressedCount() { return LogDeduplicator::GetSuppressedCount(); }
+
+void Logging::SetMaxMessageSize(size_t max_size) { LogMessage::SetMaxTextSize(max_size); }
+
+size_t Logging::GetMaxMessageSize() { return LogMessage::GetMaxTextSize(); }
+
+void Logging::SetContainerFormat(size_t max_elements, const char* separator)
+{
+    SetDefaultContainerFormat(max_elements, separator);
+}
+
+LogStats Logging::GetStats()
+{
+    LogStats stats;
+    for (int i = 0; i < kSeverityCount; ++i)
+    {
+        stats.messages[i] = g_pipeline_counters.messages[i].Get();
+    }
+    stats.truncated = g_pipeline_counters.truncated.Get();
+    {
+        std::lock_guard<std::mutex> lock(g_async_mutex);
+        if (g_async_worker_holder)
+        {
+            stats.async_queue_size = g_async_worker_holder->GetQueueSize();
+            stats.async_dropped = g_async_worker_holder->GetDroppedCount();
+        }
+    }
+    stats.binary_dropped = GetBinaryDroppedCount();
+    stats.dedup_suppressed = GetDedupSuppressedCount();
+
+    LoggerRegistry::Snapshot loggers(g_loggers);
+    for (const auto& logger : loggers)
+    {
+        stats.sinks.push_back(logger->GetStats());
+    }
+    return stats;
+}
+
+static void DumpStats() { LOG_INFO(nlog_stats) << Logging::GetStats().ToString(); }
+
+void Logging::DumpStatsEvery(std::chrono::seconds interval)
+{
+    periodic_stats_dumper_.reset();
+    if (interval.count() > 0)
+    {
+        periodic_stats_dumper_ = make_unique<PeriodicWorker>(&DumpStats, interval);
+    }
+}
+
+void Logging::ShutDown()
+{
+    periodic_flusher_.reset();
+    periodic_stats_dumper_.reset();
+    periodic_dedup_sweeper_.reset();
+    // 所有线程还没有输出的汇总在关闭异步模式之前输出
+    LogDeduplicator::FlushAll(&DispatchToLoggers);
+    DisableBinaryMode();
+    DisableAsyncMode();
+    FlushAllLoggers();
+}
+
+// 外部logger方法和上下文，设置后不再修改
+struct PlugLogger
+{
+    PlugLogHandler handler;
+    void* context;
+};
+// 按日志等级索引的外部logger，为空表示没有接管
+static std::atomic<const PlugLogger*> g_plug_loggers[FATAL + 1];
+// 持有设置过的所有外部logger和SetPlugLoggerFuncs传入的方法。替换后不释放，避免正在打印的线程访问已释放的对象
+static std::vector<std::unique_ptr<PlugLogger>> g_plug_logger_holders;
+static std::vector<std::unique_ptr<Logging::PlugLogFunc>> g_plug_log_func_holders;
+static std::mutex g_plug_mutex;
+// 传给外部logger的头部格式，为空时不渲染头部。设置后不再修改，替换后不释放
+static std::atomic<const HeaderPattern*> g_plug_header_pattern(nullptr);
+static std::vector<std::unique_ptr<HeaderPattern>> g_plug_header_pattern_holders;
+
+void Logging::SetPlugLogger(LogSeverity log_severity, PlugLogHandler handler, void* context)
+{
+    std::lock_guard<std::mutex> lock(g_plug_mutex);
+    const PlugLogger* plug_logger = nullptr;
+    if (handler != nullptr)
+    {
+        g_plug_logger_holders.emplace_back(new PlugLogger{handler, context});
+        plug_logger = g_plug_logger_holders.back().get();
+    }
+    g_plug_loggers[log_severity].store(plug_logger, std::memory_order_release);
+    if (plug_logger != nullptr)
     {
-        return plug_log_warn != nullptr;
+        plug_logger_mask_.fetch_or(1u << log_severity, std::memory_order_release);
     }
-    else if (log_severity == LogSeverity::ERROR)
+    else
     {
-        return plug_log_error != nullptr;
+        plug_logger_mask_.fetch_and(~(1u << log_severity), std::memory_order_release);
     }
-    else if (log_severity == LogSeverity::FATAL)
+}
+
+bool Logging::SetPlugLoggerHeaderPattern(const std::string& header_pattern)
+{
+    if (!header_pattern.empty() && !Logger::IsHeaderPatternValid(header_pattern)) return false;
+
+    std::lock_guard<std::mutex> lock(g_plug_mutex);
+    const HeaderPattern* pattern = nullptr;
+    if (!header_pattern.empty())
+    {
+        g_plug_header_pattern_holders.emplace_back(new HeaderPattern(header_pattern));
+        pattern = g_plug_header_pattern_holders.back().get();
+    }
+    g_plug_header_pattern.store(pattern, std::memory_order_release);
+    return true;
+}
+
+// SetPlugLoggerFuncs设置的方法以PlugLogFunc对象为上下文，只传递日志文本
+static void CallPlugLogFunc(void* context, const PlugLogRecord& record)
+{
+    (*static_cast<const Logging::PlugLogFunc*>(context))(record.text);
+}
+
+void Logging::SetPlugLoggerFuncs(PlugLogFunc log_verbose, PlugLogFunc log_debug, PlugLogFunc log_info,
+                                 PlugLogFunc log_warn, PlugLogFunc log_error, PlugLogFunc log_fatal)
+{
+    PlugLogFunc* funcs[] = {&log_verbose, &log_debug, &log_info, &log_warn, &log_error, &log_fatal};
+    for (int severity = VERBOSE; severity <= FATAL; ++severity)
     {
-        return plug_log_fatal != nullptr;
+        PlugLogFunc* func = nullptr;
+        if (*funcs[severity] != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(g_plug_mutex);
+            g_plug_log_func_holders.emplace_back(new PlugLogFunc(std::move(*funcs[severity])));
+            func = g_plug_log_func_holders.back().get();
+        }
+        SetPlugLogger(static_cast<LogSeverity>(severity), func != nullptr ? &CallPlugLogFunc : nullptr, func);
     }
-    return false;
 }
 
-void Logging::LogToPlugVERBOSE(const LogMessage& log_message) { plug_log_verbose(log_message.GetLogText()); }
-void Logging::LogToPlugDEBUG(const LogMessage& log_message) { plug_log_debug(log_message.GetLogText()); }
-void Logging::LogToPlugINFO(const LogMessage& log_message) { plug_log_info(log_message.GetLogText()); }
-void Logging::LogToPlugWARN(const LogMessage& log_message) { plug_log_warn(log_message.GetLogText()); }
-void Logging::LogToPlugERROR(const LogMessage& log_message) { plug_log_error(log_message.GetLogText()); }
-void Logging::LogToPlugFATAL(const LogMessage& log_message) { plug_log_fatal(log_message.GetLogText()); }
+void Logging::LogToPlug(const LogMessage& log_message)
+{
+    LogSeverity log_severity = log_message.GetLogSeverity();
+    const PlugLogger* plug_logger = g_plug_loggers[log_severity].load(std::memory_order_acquire);
+    if (plug_logger == nullptr)
+    {
+        // 构造日志消息之后外部logger被取消，改为输出到内部的日志输出后端
+        LogToAllLoggers(log_message);
+        return;
+    }
+
+    char header[HeaderPattern::kMaxHeaderSize];
+    PlugLogRecord record;
+    record.severity = log_severity;
+    record.site = &log_message.GetSite();
+    record.time = log_message.GetTime();
+    record.thread_id = log_message.GetThreadId();
+    record.header = header;
+    const HeaderPattern* header_pattern = g_plug_header_pattern.load(std::memory_order_acquire);
+    record.header_length = header_pattern != nullptr ? header_pattern->Format(log_message, header, sizeof(header)) : 0;
+    record.text = log_message.GetLogText();
+    record.text_length = log_message.GetLogTextLength();
+    record.message_length = log_message.GetMessageLength();
+    record.fields = log_message.GetFields();
+    record.fields_size = log_message.GetFieldsSize();
+    plug_logger->handler(plug_logger->context, record);
+}
 }  // namespace Nlog
\ No newline at end of file
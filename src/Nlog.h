@@ -1,38 +1,147 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 
+#include "details/BinaryLog.h"
 #include "details/LogMessage.h"
+#include "details/LogRateLimiter.h"
 #include "details/LogSeverity.h"
 #include "loggers/Logger.h"
 
+// 编译期日志等级，与LogSeverity一一对应，用于预处理器比较
+#define NLOG_LEVEL_VERBOSE 0
+#define NLOG_LEVEL_DEBUG 1
+#define NLOG_LEVEL_INFO 2
+#define NLOG_LEVEL_WARN 3
+#define NLOG_LEVEL_ERROR 4
+#define NLOG_LEVEL_FATAL 5
+
+// 编译期日志等级阈值，低于该等级的日志语句在编译期被整体移除，运行时没有任何开销。
+// 通过编译选项指定，例如 -DNLOG_ACTIVE_LEVEL=NLOG_LEVEL_INFO，默认保留所有等级
+#ifndef NLOG_ACTIVE_LEVEL
+#define NLOG_ACTIVE_LEVEL NLOG_LEVEL_VERBOSE
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NLOG_LIKELY(x) __builtin_expect(!!(x), 1)
+#define NLOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define NLOG_LIKELY(x) (x)
+#define NLOG_UNLIKELY(x) (x)
+#endif
+
 // 外部指定打印方法
 #define PLUG_LOG_VALID(log_severity) (Nlog::Logging::IsPlugLoggerValid(Nlog::log_severity))
-#define PLUG_LOG(log_severity)                                                                                         \
-    (Nlog::LogMessage(Nlog::log_severity, __FILE__, __func__, __LINE__, &Nlog::Logging::LogToPlug##log_severity))
+#define PLUG_LOG(log_severity) (Nlog::LogMessage(*NLOG_LOG_SITE(log_severity, ), &Nlog::Logging::LogToPlug))
 
 // 内部打印方法
 #define LOG_IS_ON(log_severity) (Nlog::Logging::IsLogSeverityOn(Nlog::log_severity))
-#define LOG(log_severity)                                                                                              \
-    (Nlog::LogMessage(Nlog::log_severity, __FILE__, __func__, __LINE__, &Nlog::Logging::LogToAllLoggers))
+#define LOG(log_severity) (Nlog::LogMessage(*NLOG_LOG_SITE(log_severity, ), &Nlog::Logging::LogToAllLoggers))
+
+// 调用点的日志等级打开且condition成立时返回调用点，否则返回nullptr。
+// 编译期等级判断是常量表达式，被关闭的等级整条语句都会被编译器消除；运行时读取调用点缓存的有效等级
+// （按模块名、文件名和全局等级解析，配置变化时失效），并提示编译器日志分支是冷路径，
+// 使格式化代码不会打断调用方热路径的指令布局
+#define NLOG_LOG_SITE_IF(log_severity, module, condition)                                                              \
+    (__extension__({                                                                                                   \
+        NLOG_DEFINE_LOG_SITE(nlog_site, log_severity, module);                                                         \
+        (NLOG_LEVEL_##log_severity >= NLOG_ACTIVE_LEVEL && NLOG_UNLIKELY(nlog_site.IsOn()) &&                          \
+         NLOG_UNLIKELY(condition))                                                                                     \
+            ? &nlog_site                                                                                               \
+            : nullptr;                                                                                                 \
+    }))
+
+// 构造日志消息。如果外部指定打印方法，则选择外部方法，否则选择内部打印方法
+#define LOG_MESSAGE(site, log_severity)                                                                                \
+    (Nlog::LogMessage(*(site), PLUG_LOG_VALID(log_severity) ? &Nlog::Logging::LogToPlug : &Nlog::Logging::LogToAllLoggers))
 
-// 如果外部指定打印方法，则选择外部方法，否则选择内部打印方法
-#define LOG_CHOOSE(log_severity)                                                                                       \
-    if (LOG_IS_ON(log_severity)) ((PLUG_LOG_VALID(log_severity)) ? (PLUG_LOG(log_severity)) : (LOG(log_severity)))
+// 整个表达式加括号，使LOG_INFO(module)之后既可以接<<，也可以接.kv(key, value)
+#define LOG_CHOOSE_IF(log_severity, module, condition)                                                                 \
+    if (const Nlog::LogSite* nlog_enabled_site = NLOG_LOG_SITE_IF(log_severity, module, condition))                   \
+    (LOG_MESSAGE(nlog_enabled_site, log_severity) << "<" #module ">")
 
-#define LOG_VERBOSE(module) LOG_CHOOSE(VERBOSE) << "<" #module ">"
-#define LOG_DEBUG(module) LOG_CHOOSE(DEBUG) << "<" #module ">"
-#define LOG_INFO(module) LOG_CHOOSE(INFO) << "<" #module ">"
-#define LOG_WARN(module) LOG_CHOOSE(WARN) << "<" #module ">"
-#define LOG_ERROR(module) LOG_CHOOSE(ERROR) << "<" #module ">"
-#define LOG_FATAL(module) LOG_CHOOSE(FATAL) << "<" #module ">"
+#define LOG_CHOOSE(log_severity, module) LOG_CHOOSE_IF(log_severity, module, true)
+
+#define LOG_VERBOSE(module) LOG_CHOOSE(VERBOSE, module)
+#define LOG_DEBUG(module) LOG_CHOOSE(DEBUG, module)
+#define LOG_INFO(module) LOG_CHOOSE(INFO, module)
+#define LOG_WARN(module) LOG_CHOOSE(WARN, module)
+#define LOG_ERROR(module) LOG_CHOOSE(ERROR, module)
+#define LOG_FATAL(module) LOG_CHOOSE(FATAL, module)
 
 #define LOG_V(value) #value ":" << value
 
+// 限频和采样日志，按调用点计数，在等级判断之后、构造LogMessage之前判断，不需要打印时没有格式化开销。
+// 例如 LOG_EVERY_N(ERROR, net, 1000) << "recv fail, fd:" << fd;
+// 调用点状态放在立即调用的lambda中，每条语句一个静态对象（常量初始化，没有线程安全初始化的开销）
+#define LOG_SITE_SHOULD_LOG(site_type, arg)                                                                            \
+    ([&]() -> bool {                                                                                                   \
+        static Nlog::site_type nlog_rate_site;                                                                         \
+        return nlog_rate_site.ShouldLog(arg);                                                                          \
+    }())
+
+// 每n次打印一次，第1次一定打印
+#define LOG_EVERY_N(log_severity, module, n)                                                                           \
+    LOG_CHOOSE_IF(log_severity, module, LOG_SITE_SHOULD_LOG(LogEveryNSite, (n)))
+// 只打印前n次
+#define LOG_FIRST_N(log_severity, module, n)                                                                           \
+    LOG_CHOOSE_IF(log_severity, module, LOG_SITE_SHOULD_LOG(LogFirstNSite, (n)))
+// 每interval秒最多打印一次，interval可以是小数
+#define LOG_EVERY_T(log_severity, module, interval)                                                                    \
+    LOG_CHOOSE_IF(log_severity, module, LOG_SITE_SHOULD_LOG(LogEveryTSite, (interval)))
+// 按概率probability（0到1）采样打印
+#define LOG_SAMPLED(log_severity, module, probability)                                                                 \
+    LOG_CHOOSE_IF(log_severity, module, Nlog::ShouldLogSampled(probability))
+
+// 二进制日志：format为printf风格的字符串字面量，参数只记录原始字节，由nlog_decode离线格式化。
+// 二进制日志模式没有开启时按文本日志输出。例如 LOG_BINARY(INFO, net, "fd:%d bytes:%zu", fd, bytes);
+#define LOG_BINARY(log_severity, module, format, ...)                                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (NLOG_LEVEL_##log_severity >= NLOG_ACTIVE_LEVEL)                                                            \
+        {                                                                                                              \
+            static Nlog::BinaryLogSite nlog_binary_site(Nlog::log_severity, __FILE__, sizeof(__FILE__) - 1, __func__,  \
+                                                        sizeof(__func__) - 1, __LINE__, #module, format);              \
+            if (NLOG_UNLIKELY(nlog_binary_site.site.IsOn())) Nlog::LogBinary(nlog_binary_site, ##__VA_ARGS__);         \
+        }                                                                                                              \
+    } while (0)
+
 namespace Nlog {
+// 传给外部logger的一条日志，所有指针只在回调期间有效，需要保留时由外部logger自己拷贝
+struct PlugLogRecord
+{
+    LogSeverity severity;
+    // 调用点：文件名、函数名、行号和模块名
+    const LogSite* site;
+    // 打印日志的时间和线程号
+    struct timeval time;
+    long thread_id;
+    // 按SetPlugLoggerHeaderPattern设置的格式渲染的头部，没有设置时长度为0
+    const char* header;
+    size_t header_length;
+    // 日志文本，以"<module>"开头、'\n'结尾，text[text_length]为'\0'
+    const char* text;
+    size_t text_length;
+    // 文本中渲染结构化字段之前的部分的长度
+    size_t message_length;
+    // 编码后的结构化字段，可以用LogFieldReader按类型读取
+    const char* fields;
+    size_t fields_size;
+};
+
+/**
+ * 外部logger方法
+ * @param context 设置时传入的用户上下文
+ * @param record 日志
+ */
+typedef void (*PlugLogHandler)(void* context, const PlugLogRecord& record);
+
 /**
- * Logging是日志管理类，非线程安全。
+ * Logging是日志管理类。日志输出后端可以在运行时从任意线程增加和移除，输出日志时读取的是无锁的后端列表快照。
  */
 class Logging
 {
@@ -42,25 +151,43 @@ class Logging
      * @param log_severity 日志等级
      */
     static void SetLogSeverity(LogSeverity log_severity);
+    /**
+     * 设置模块的日志等级，优先于文件名规则和全局等级，例如 SetModuleSeverity("net", VERBOSE) 只打开net模块的VERBOSE日志。
+     * 每个调用点缓存解析后的有效等级，修改后各调用点在下次判断时重新解析一次
+     * @param module_name 模块名，即LOG_INFO(module)中的module
+     * @param log_severity 日志等级
+     */
+    static void SetModuleSeverity(const std::string& module_name, LogSeverity log_severity);
+    /**
+     * 设置文件名匹配的日志等级，优先于全局等级，多条规则都匹配时后设置的优先
+     * @param pattern glob模式，如"net_*.cpp"，包含'/'时匹配完整路径（__FILE__，可能是绝对路径，模式一般以通配符开头）
+     * @param log_severity 日志等级
+     */
+    static void SetFileSeverity(const std::string& pattern, LogSeverity log_severity);
+    /**
+     * 清除所有模块和文件名的日志等级，只使用全局日志等级
+     */
+    static void ClearModuleSeverities();
     /**
      * 获取全局日志打印级别
      * @return 日志等级
      */
-    static LogSeverity GetLogSeverity();
+    static LogSeverity GetLogSeverity() { return static_cast<LogSeverity>(log_severity_.load(std::memory_order_relaxed)); }
     /**
-     * 判断特定的日志等级是否打开
+     * 判断特定的日志等级在全局日志等级下是否打开，不考虑模块和文件名的日志等级
      * @param log_severity 日志等级
      * @return true表示打开，false表示关闭
      */
-    static bool IsLogSeverityOn(LogSeverity log_severity);
+    static bool IsLogSeverityOn(LogSeverity log_severity) { return log_severity >= GetLogSeverity(); }
     /**
-     * 增加日志输出后端
+     * 增加日志输出后端，线程安全，可以在其他线程正在打印日志时调用
      * @param logger
      * @return true表示添加成功，false表示添加失败
      */
     static bool AddLogger(const LoggerPtr& logger);
     /**
-     * 通过名字移除日志输出后端。移除成功返回true，否则返回false
+     * 通过名字移除日志输出后端，线程安全。移除成功返回true，否则返回false。
+     * 正在使用该后端的线程输出完当前日志后，后端才会被释放
      * @param name 日志输出后端名称
      * @return true表示移除成功，false移除失败
      */
@@ -92,14 +219,136 @@ class Logging
     static void FlushEvery(std::chrono::seconds interval);
 
     /**
-     * 关闭时调用
+     * 开启异步日志模式。开启后LogMessage输出时只把日志记录拷贝进预分配的无锁环形队列，
+     * 由后台线程统一写到日志输出后端，业务线程不再承担日志头部格式化和文件写入的开销。
+     * 重复调用会先停止之前的后台线程（输出完队列中的日志）再按新的参数开启。
+     * @param queue_capacity 队列容量（条数），向上取整为2的幂，每条约占1.6KB内存（文本和结构化字段），
+     *                       超过1KB的日志文本另外在堆上拷贝一份
+     * @param drop_when_full 队列满时是否丢弃日志，false表示业务线程等待队列有空位
+     */
+    static void EnableAsyncMode(size_t queue_capacity = 1024, bool drop_when_full = false);
+
+    /**
+     * 关闭异步日志模式，关闭前会输出队列中剩余的日志
+     */
+    static void DisableAsyncMode();
+
+    /**
+     * 是否处于异步日志模式
+     * @return true表示异步模式
+     */
+    static bool IsAsyncMode();
+
+    /**
+     * 获取异步模式下因队列满被丢弃的日志条数
+     * @return 丢弃的日志条数
+     */
+    static uint64_t GetAsyncDroppedCount();
+
+    /**
+     * 开启二进制日志模式。开启后LOG_BINARY只把调用点ID和参数的原始字节拷贝到线程私有的缓冲区，
+     * 由后台线程写入二进制文件，使用nlog_decode还原为文本日志。其他日志语句不受影响。
+     * 重复调用会先停止之前的后台线程（写完缓冲区中的记录）再按新的参数开启。
+     * @param file_path 二进制日志文件路径，已存在时追加
+     * @param thread_buffer_size 每个线程的缓冲区大小（字节）
+     * @param drop_when_full 缓冲区满时是否丢弃日志，false表示业务线程等待缓冲区有空位
+     * @return 打开文件失败时返回false，此时之前的二进制日志模式已经关闭
+     */
+    static bool EnableBinaryMode(const std::string& file_path, size_t thread_buffer_size = 1 << 20,
+                                 bool drop_when_full = false);
+
+    /**
+     * 关闭二进制日志模式，关闭前会写完缓冲区中的记录。之后LOG_BINARY按文本日志输出
+     */
+    static void DisableBinaryMode();
+
+    /**
+     * 是否处于二进制日志模式
+     * @return true表示二进制日志模式
+     */
+    static bool IsBinaryMode();
+
+    /**
+     * 获取二进制日志模式下因缓冲区满被丢弃的日志条数
+     * @return 丢弃的日志条数
+     */
+    static uint64_t GetBinaryDroppedCount();
+
+    /**
+     * 开启重复日志折叠。同一调用点、文本相同的日志在窗口时间内只输出第一条，之后的被丢弃，
+     * 窗口结束后输出一条"last message repeated N times"的汇总。每个线程独立判断，判断时只和定时汇总竞争本线程的表锁，
+     * 之后不再打印日志的线程的汇总由后台线程每个窗口时长（至少10ms）检查一次并输出。
+     * 重复调用只修改窗口时长
+     * @param window 窗口时长
+     */
+    static void EnableDedup(std::chrono::milliseconds window = std::chrono::milliseconds(1000));
+
+    /**
+     * 关闭重复日志折叠，输出所有线程还没有输出的汇总
+     */
+    static void DisableDedup();
+
+    /**
+     * 获取被折叠的日志条数（只包括已经输出汇总的）
+     * @return 被折叠的日志条数
+     */
+    static uint64_t GetDedupSuppressedCount();
+
+    /**
+     * 设置单条日志文本的最大长度。1KB以内的日志在线程复用的缓冲区中格式化，更长的日志按需换到更大的缓冲区，
+     * 超过最大长度的部分被截断，文本末尾标记"...[truncated N bytes]"，并计入GetStats()的truncated
+     * @param max_size 字节数，默认64KB，限制在256B ~ 1MB之间
+     */
+    static void SetMaxMessageSize(size_t max_size);
+    static size_t GetMaxMessageSize();
+
+    /**
+     * 设置容器默认的输出格式，单次输出可以用LogContainer(container, max_elements, separator)指定
+     * @param max_elements 最多输出的元素个数，默认3个，ContainerFormat::kUnlimited表示不限制
+     * @param separator 元素间的分隔符，默认","，生命周期需要覆盖之后所有的日志，一般为字符串常量
+     */
+    static void SetContainerFormat(size_t max_elements, const char* separator = ",");
+
+    /**
+     * 获取日志流水线的统计：各等级的日志条数、被截断的条数、异步队列长度和丢弃条数，
+     * 以及每个日志输出后端的条数、字节数、切分次数、锁等待和写文件/Flush的延迟分布。
+     * 计数器按线程分片，统计本身不会引入竞争，可以在运行中的进程里随时调用
+     * @return 统计快照
+     */
+    static LogStats GetStats();
+
+    /**
+     * 定时以INFO等级打印一行统计（模块名为nlog_stats），内容为GetStats().ToString()
+     * @param interval 间隔时长（s），为0时停止打印
+     */
+    static void DumpStatsEvery(std::chrono::seconds interval);
+
+    /**
+     * 关闭时调用，会输出异步队列中剩余的日志并刷新所有日志输出后端
      */
     static void ShutDown();
 
+    /**
+     * 设置指定等级的外部logger方法，接管该等级的日志输出。各等级的方法和上下文保存在按等级索引的表中，
+     * 输出时只有一次查表和一次函数指针调用，文本、头部和调用点信息都不拷贝。
+     * 可以在运行时替换，正在打印的线程可能仍会调用一次旧的方法，旧的上下文需要保持有效
+     * @param log_severity 日志等级
+     * @param handler 外部logger方法，为nullptr时取消接管
+     * @param context 原样传给handler的用户上下文
+     */
+    static void SetPlugLogger(LogSeverity log_severity, PlugLogHandler handler, void* context = nullptr);
+
+    /**
+     * 设置传给外部logger的头部格式，可以在其他线程正在打印日志时调用
+     * @param header_pattern 头部格式（见Logger::IsHeaderPatternValid），为空时不渲染头部（默认）
+     * @return 格式不合法时返回false
+     */
+    static bool SetPlugLoggerHeaderPattern(const std::string& header_pattern);
+
     typedef std::function<void(const char*)> PlugLogFunc;
 
     /**
-     * 设置外部logger方法，接管日志输出
+     * 设置外部logger方法，接管日志输出。只传递日志文本，需要长度、头部和调用点信息时使用SetPlugLogger
      * @param log_verbose verbose
      * @param log_debug debug
      * @param log_info info
@@ -115,17 +364,21 @@ class Logging
      * @param log_severity 日志等级
      * @return true 有外部接管方法
      */
-    static bool IsPlugLoggerValid(LogSeverity log_severity);
+    static bool IsPlugLoggerValid(LogSeverity log_severity)
+    {
+        return (plug_logger_mask_.load(std::memory_order_relaxed) & (1u << log_severity)) != 0;
+    }
 
     /**
-     * 调用外部logger方法
+     * 调用日志等级对应的外部logger方法
      * @param log_message log消息
      */
-    static void LogToPlugVERBOSE(const LogMessage& log_message);
-    static void LogToPlugDEBUG(const LogMessage& log_message);
-    static void LogToPlugINFO(const LogMessage& log_message);
-    static void LogToPlugWARN(const LogMessage& log_message);
-    static void LogToPlugERROR(const LogMessage& log_message);
-    static void LogToPlugFATAL(const LogMessage& log_message);
+    static void LogToPlug(const LogMessage& log_message);
+
+  private:
+    // 全局日志打印等级
+    static std::atomic<int> log_severity_;
+    // 有外部接管方法的日志等级，第n位对应LogSeverity值为n的等级
+    static std::atomic<uint32_t> plug_logger_mask_;
 };
 }  // namespace Nlog
\ No newline at end of file
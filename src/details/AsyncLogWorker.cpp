@@ -0,0 +1,151 @@
+#include "AsyncLogWorker.h"
+
+#include <string.h>
+
+#include <chrono>
+
+namespace Nlog
+{
+// 后台线程空闲时的最长等待时间，用来兜底极少数情况下丢失的唤醒
+constexpr int kIdleWaitMs = 10;
+
+// 当前线程是哪个对象的后台线程
+static thread_local const AsyncLogWorker* t_current_worker = nullptr;
+
+AsyncLogWorker::AsyncLogWorker(SinkFunc sink_func, size_t queue_capacity, bool drop_when_full)
+    : sink_func_(sink_func),
+      drop_when_full_(drop_when_full),
+      ring_buffer_(queue_capacity),
+      running_(true),
+      pushing_(0),
+      sleeping_(false),
+      dropped_count_(0)
+{
+    worker_thread_ = std::thread(&AsyncLogWorker::Run, this);
+}
+
+AsyncLogWorker::~AsyncLogWorker() { Stop(); }
+
+bool AsyncLogWorker::Push(const LogMessage& log_message)
+{
+    // 后端（或者后端调用的切分回调）在后台线程中打印日志时同步输出，否则队列满时后台线程会等待自己
+    if (t_current_worker == this) return false;
+
+    // 先登记再检查运行状态：Stop()设置停止标志后会等待已经登记的线程推送完，没有登记上的线程一定能看到停止标志
+    pushing_.fetch_add(1, std::memory_order_seq_cst);
+    bool pushed = running_.load(std::memory_order_seq_cst) && PushRecord(log_message);
+    pushing_.fetch_sub(1, std::memory_order_release);
+    return pushed;
+}
+
+bool AsyncLogWorker::PushRecord(const LogMessage& log_message)
+{
+    size_t text_length = log_message.GetLogTextLength();
+    char* large_text = nullptr;
+    if (text_length >= sizeof(AsyncLogRecord::text))
+    {
+        large_text = new char[text_length + 1];
+        memcpy(large_text, log_message.GetLogText(), text_length + 1);
+    }
+    auto writer = [&log_message, text_length, large_text](AsyncLogRecord& record) {
+        record.site = &log_message.GetSite();
+        record.tv = log_message.GetTime();
+        record.thread_id = log_message.GetThreadId();
+        record.text_length = text_length;
+        record.large_text = large_text;
+        // 连同结尾的'\0'一起拷贝
+        if (large_text == nullptr) memcpy(record.text, log_message.GetLogText(), text_length + 1);
+        record.fields_size = log_message.GetFieldsSize();
+        record.message_length = log_message.GetMessageLength();
+        if (record.fields_size > 0) memcpy(record.fields, log_message.GetFields(), record.fields_size);
+    };
+
+    while (!ring_buffer_.TryPush(writer))
+    {
+        if (drop_when_full_)
+        {
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            delete[] large_text;
+            return true;
+        }
+        if (!running_.load(std::memory_order_relaxed))
+        {
+            delete[] large_text;
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    // 只有把sleeping_改为false的一个线程唤醒后台线程，其他线程不再争抢mtx_
+    if (sleeping_.load(std::memory_order_seq_cst) && sleeping_.exchange(false, std::memory_order_seq_cst))
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        cv_.notify_one();
+    }
+    return true;
+}
+
+void AsyncLogWorker::Stop()
+{
+    if (!worker_thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        running_.store(false, std::memory_order_seq_cst);
+    }
+    cv_.notify_one();
+    worker_thread_.join();
+
+    // 已经通过运行状态检查的线程可能在后台线程最后一次输出之后才推送完，等其结束后在当前线程输出
+    while (pushing_.load(std::memory_order_acquire) != 0)
+    {
+        std::this_thread::yield();
+    }
+    Drain();
+    // 停止后的对象不释放（并发的业务线程可能还持有指针，但只会检查运行状态），只释放占内存的队列
+    ring_buffer_.ReleaseCells();
+}
+
+size_t AsyncLogWorker::Drain()
+{
+    auto reader = [this](const AsyncLogRecord& record) {
+        const char* text = record.large_text != nullptr ? record.large_text : record.text;
+        {
+            LogMessage log_message(*record.site, record.tv, record.thread_id, text, record.text_length, record.fields,
+                                   record.fields_size, record.message_length);
+            sink_func_(log_message);
+        }
+        delete[] record.large_text;
+    };
+
+    size_t count = 0;
+    while (ring_buffer_.TryPop(reader))
+    {
+        ++count;
+    }
+    return count;
+}
+
+void AsyncLogWorker::Run()
+{
+    t_current_worker = this;
+    for (;;)
+    {
+        if (Drain() > 0) continue;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!running_.load())
+        {
+            lock.unlock();
+            // 退出前输出剩余的日志
+            Drain();
+            return;
+        }
+        sleeping_.store(true, std::memory_order_seq_cst);
+        if (ring_buffer_.Size() == 0)
+        {
+            cv_.wait_for(lock, std::chrono::milliseconds(kIdleWaitMs));
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+}  // namespace Nlog
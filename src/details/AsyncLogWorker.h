@@ -0,0 +1,94 @@
+#pragma once
+
+#include <sys/time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "LogMessage.h"
+#include "MpscRingBuffer.h"
+
+namespace Nlog
+{
+// 异步队列中保存的一条日志记录，文本已经在业务线程格式化完成
+struct AsyncLogRecord
+{
+    // 调用点是静态对象，只保存指针
+    const LogSite* site;
+    struct timeval tv;
+    long thread_id;
+    size_t text_length;
+    // 不超过行内缓冲区大小的文本直接拷贝到text，更长的文本拷贝到堆上，由后台线程输出后释放
+    char* large_text;
+    char text[LogStream::kInlineSize + LogStream::kReservedSize];
+    // 结构化字段，只拷贝实际使用的部分
+    size_t fields_size;
+    size_t message_length;
+    char fields[LogFieldEncoder::kMaxFieldsSize];
+};
+
+// 异步日志后台线程：业务线程只把日志记录拷贝进无锁环形队列，由后台线程统一写到日志输出后端
+class AsyncLogWorker
+{
+  public:
+    typedef void (*SinkFunc)(const LogMessage&);
+
+    /**
+     * @param sink_func 后台线程输出日志的方法
+     * @param queue_capacity 队列容量（条数）
+     * @param drop_when_full 队列满时是否丢弃日志，false表示业务线程等待队列有空位
+     */
+    AsyncLogWorker(SinkFunc sink_func, size_t queue_capacity, bool drop_when_full);
+    AsyncLogWorker(const AsyncLogWorker&) = delete;
+    AsyncLogWorker& operator=(const AsyncLogWorker&) = delete;
+    ~AsyncLogWorker();
+
+    /**
+     * 拷贝日志消息到队列
+     * @param log_message 日志消息
+     * @return 后台线程已经停止或者在后台线程中调用时返回false，调用方需要自己同步输出；队列满丢弃日志时返回true
+     */
+    bool Push(const LogMessage& log_message);
+
+    /**
+     * 停止后台线程，停止前会把队列中剩余的日志全部输出，包括停止过程中其他线程正在推送的日志。停止后释放队列的内存
+     */
+    void Stop();
+
+    /**
+     * 获取因队列满被丢弃的日志条数
+     */
+    uint64_t GetDroppedCount() const { return dropped_count_.load(std::memory_order_relaxed); }
+
+    /**
+     * 获取队列中等待输出的日志条数
+     */
+    size_t GetQueueSize() const { return ring_buffer_.Size(); }
+
+  private:
+    // 拷贝日志消息到队列，调用方已经登记并确认后台线程在运行
+    bool PushRecord(const LogMessage& log_message);
+
+    void Run();
+
+    // 输出队列中所有日志，返回输出的条数
+    size_t Drain();
+
+  private:
+    const SinkFunc sink_func_;
+    const bool drop_when_full_;
+    MpscRingBuffer<AsyncLogRecord> ring_buffer_;
+    std::atomic<bool> running_;
+    // 正在推送日志的线程数，Stop()等其归零后再输出一次队列，避免停止过程中推送的日志丢失
+    std::atomic<int> pushing_;
+    // 后台线程是否在等待新日志，业务线程只在其为true时才需要唤醒
+    std::atomic<bool> sleeping_;
+    std::atomic<uint64_t> dropped_count_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread worker_thread_;
+};
+}  // namespace Nlog
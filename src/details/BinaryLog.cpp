@@ -0,0 +1,452 @@
+#include "BinaryLog.h"
+
+#include <stdio.h>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Nlog.h"
+#include "BinaryLogWriter.h"
+
+namespace Nlog
+{
+// 已注册的调用点，下标+1即为调用点ID
+static std::mutex g_sites_mutex;
+static std::vector<const BinaryLogSite*> g_sites;
+
+uint32_t RegisterBinaryLogSite(BinaryLogSite& site, const char* arg_types)
+{
+    std::lock_guard<std::mutex> lock(g_sites_mutex);
+    uint32_t site_id = site.id.load(std::memory_order_relaxed);
+    if (site_id != 0) return site_id;
+
+    site.arg_types = arg_types;
+    g_sites.push_back(&site);
+    site_id = static_cast<uint32_t>(g_sites.size());
+    site.id.store(site_id, std::memory_order_release);
+    return site_id;
+}
+
+size_t GetBinaryLogSites(size_t from, std::vector<const BinaryLogSite*>& sites)
+{
+    std::lock_guard<std::mutex> lock(g_sites_mutex);
+    for (size_t i = from; i < g_sites.size(); ++i)
+    {
+        sites.push_back(g_sites[i]);
+    }
+    return g_sites.size();
+}
+
+BinaryStagingBuffer::BinaryStagingBuffer(size_t capacity, long thread_id)
+    : storage_(new char[capacity]),
+      capacity_(capacity),
+      thread_id_(thread_id),
+      retired_(false),
+      producer_pos_(0),
+      cached_consumer_pos_(0),
+      end_of_recorded_(capacity),
+      consumer_pos_(0)
+{
+}
+
+BinaryStagingBuffer::~BinaryStagingBuffer() { delete[] storage_; }
+
+const char* BinaryStagingBuffer::Peek(size_t& length)
+{
+    size_t consumer_pos = consumer_pos_.load(std::memory_order_relaxed);
+    size_t producer_pos = producer_pos_.load(std::memory_order_acquire);
+    if (producer_pos >= consumer_pos)
+    {
+        length = producer_pos - consumer_pos;
+        return storage_ + consumer_pos;
+    }
+
+    // 生产者已经回绕，先读完回绕前的数据
+    if (consumer_pos < end_of_recorded_)
+    {
+        length = end_of_recorded_ - consumer_pos;
+        return storage_ + consumer_pos;
+    }
+    consumer_pos_.store(0, std::memory_order_release);
+    length = producer_pos;
+    return storage_;
+}
+
+// 线程持有的缓冲区，线程退出时交给后台线程回收
+class ThreadBinaryBuffer
+{
+  public:
+    ~ThreadBinaryBuffer()
+    {
+        if (buffer_) buffer_->Retire();
+    }
+
+    BinaryStagingBuffer* Get(BinaryLogWriter* writer)
+    {
+        // 二进制日志模式重新开启后，旧的缓冲区交给旧的后台线程回收
+        if (writer != writer_)
+        {
+            if (buffer_) buffer_->Retire();
+            buffer_ = writer->CreateThreadBuffer();
+            writer_ = writer;
+        }
+        return buffer_.get();
+    }
+
+  private:
+    BinaryLogWriter* writer_ = nullptr;
+    std::shared_ptr<BinaryStagingBuffer> buffer_;
+};
+
+BinaryStagingBuffer* GetThreadBinaryBuffer()
+{
+    BinaryLogWriter* writer = BinaryLogWriter::GetCurrent();
+    if (writer == nullptr) return nullptr;
+
+    static thread_local ThreadBinaryBuffer thread_buffer;
+    return thread_buffer.Get(writer);
+}
+
+char* ReserveBinaryRecordSlow(BinaryStagingBuffer* buffer, size_t length)
+{
+    BinaryLogWriter* writer = BinaryLogWriter::GetCurrent();
+    if (writer == nullptr) return nullptr;
+
+    // 超过缓冲区一半的记录无法保证能放下
+    if (length >= buffer->GetCapacity() / 2)
+    {
+        writer->AddDroppedCount();
+        return nullptr;
+    }
+
+    for (;;)
+    {
+        if (writer->IsDropWhenFull() || !writer->IsRunning())
+        {
+            writer->AddDroppedCount();
+            return nullptr;
+        }
+        std::this_thread::yield();
+        char* record = buffer->Reserve(length);
+        if (record != nullptr) return record;
+    }
+}
+
+void LogBinaryAsText(const BinaryLogSite& site, const BinaryArgValue* args, size_t arg_count)
+{
+    LogMessage::LogFunc log_func =
+        Logging::IsPlugLoggerValid(site.site.severity) ? &Logging::LogToPlug : &Logging::LogToAllLoggers;
+    LogMessage log_message(site.site, log_func);
+    LogStream& stream = log_message.GetStream();
+    stream << "<" << site.site.module << ">";
+    FormatBinaryLog(stream, site.format, args, arg_count);
+}
+
+// 一个printf转换说明
+struct ConversionSpec
+{
+    char flags[8];
+    size_t flags_length;
+    int width;
+    int precision;
+    char conversion;
+};
+
+// 按格式串中的转换说明输出整数，参数类型不一致时先转换
+static void FormatSignedArg(LogStream& stream, const char* spec, int64_t value)
+{
+    char buf[320];
+    int n = snprintf(buf, sizeof(buf), spec, static_cast<long long>(value));
+    if (n > 0) stream.Append(buf, static_cast<size_t>(n) < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+static void FormatUnsignedArg(LogStream& stream, const char* spec, uint64_t value)
+{
+    char buf[320];
+    int n = snprintf(buf, sizeof(buf), spec, static_cast<unsigned long long>(value));
+    if (n > 0) stream.Append(buf, static_cast<size_t>(n) < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+static void FormatDoubleArg(LogStream& stream, const char* spec, double value)
+{
+    char buf[320];
+    int n = snprintf(buf, sizeof(buf), spec, value);
+    if (n > 0) stream.Append(buf, static_cast<size_t>(n) < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+static void FormatStringArg(LogStream& stream, const ConversionSpec& spec, const char* value, size_t length)
+{
+    if (spec.precision >= 0 && static_cast<size_t>(spec.precision) < length) length = spec.precision;
+    size_t padding = spec.width > 0 && static_cast<size_t>(spec.width) > length ? spec.width - length : 0;
+    bool left_align = memchr(spec.flags, '-', spec.flags_length) != nullptr;
+    if (!left_align)
+    {
+        for (size_t i = 0; i < padding; ++i) stream.Append(' ');
+    }
+    stream.Append(value, length);
+    if (left_align)
+    {
+        for (size_t i = 0; i < padding; ++i) stream.Append(' ');
+    }
+}
+
+// 生成snprintf使用的格式串，长度修饰符换成与参数实际类型一致的
+static void BuildSpec(const ConversionSpec& spec, const char* length_modifier, char conversion, char* out, size_t size)
+{
+    char width[16] = "";
+    char precision[16] = "";
+    if (spec.width > 0) snprintf(width, sizeof(width), "%d", spec.width);
+    if (spec.precision >= 0) snprintf(precision, sizeof(precision), ".%d", spec.precision);
+    snprintf(out, size, "%%%.*s%s%s%s%c", static_cast<int>(spec.flags_length), spec.flags, width, precision,
+             length_modifier, conversion);
+}
+
+// 参数在整数、浮点数之间的转换
+static int64_t ToSigned(const BinaryArgValue& arg)
+{
+    return arg.type == 'd' ? static_cast<int64_t>(arg.d) : arg.i;
+}
+
+static uint64_t ToUnsigned(const BinaryArgValue& arg)
+{
+    return arg.type == 'd' ? static_cast<uint64_t>(arg.d) : arg.u;
+}
+
+static double ToDouble(const BinaryArgValue& arg)
+{
+    switch (arg.type)
+    {
+        case 'd':
+            return arg.d;
+        case 'u':
+        case 'p':
+            return static_cast<double>(arg.u);
+        default:
+            return static_cast<double>(arg.i);
+    }
+}
+
+// 按参数自身的类型输出，用于%s对应的参数不是字符串的情况
+static void FormatArgByType(LogStream& stream, const ConversionSpec& spec, const BinaryArgValue& arg)
+{
+    char spec_buf[64];
+    switch (arg.type)
+    {
+        case 's':
+            FormatStringArg(stream, spec, arg.s, arg.length);
+            break;
+        case 'i':
+            BuildSpec(spec, "ll", 'd', spec_buf, sizeof(spec_buf));
+            FormatSignedArg(stream, spec_buf, arg.i);
+            break;
+        case 'u':
+            BuildSpec(spec, "ll", 'u', spec_buf, sizeof(spec_buf));
+            FormatUnsignedArg(stream, spec_buf, arg.u);
+            break;
+        case 'd':
+            BuildSpec(spec, "", 'f', spec_buf, sizeof(spec_buf));
+            FormatDoubleArg(stream, spec_buf, arg.d);
+            break;
+        case 'b':
+            BuildSpec(spec, "ll", 'd', spec_buf, sizeof(spec_buf));
+            FormatSignedArg(stream, spec_buf, arg.i != 0);
+            break;
+        case 'c':
+        {
+            char c = static_cast<char>(arg.i);
+            FormatStringArg(stream, spec, &c, 1);
+            break;
+        }
+        case 'p':
+            BuildSpec(spec, "ll", 'x', spec_buf, sizeof(spec_buf));
+            stream.Append("0x", 2);
+            FormatUnsignedArg(stream, spec_buf, arg.u);
+            break;
+    }
+}
+
+void FormatBinaryLog(LogStream& stream, const char* format, const BinaryArgValue* args, size_t arg_count)
+{
+    // 宽度和精度的上限，保证单个参数的输出不超过临时缓冲区
+    constexpr int kMaxWidth = 256;
+    size_t next_arg = 0;
+    const char* p = format;
+    while (*p != '\0')
+    {
+        const char* percent = strchr(p, '%');
+        if (percent == nullptr)
+        {
+            stream.Append(p, strlen(p));
+            break;
+        }
+        stream.Append(p, percent - p);
+
+        const char* spec_begin = percent;
+        p = percent + 1;
+        if (*p == '%')
+        {
+            stream.Append('%');
+            ++p;
+            continue;
+        }
+
+        ConversionSpec spec;
+        spec.flags_length = 0;
+        spec.width = 0;
+        spec.precision = -1;
+        while (*p != '\0' && strchr("-+ #0", *p) != nullptr)
+        {
+            if (spec.flags_length < sizeof(spec.flags)) spec.flags[spec.flags_length++] = *p;
+            ++p;
+        }
+        if (*p == '*')
+        {
+            if (next_arg < arg_count) spec.width = static_cast<int>(ToSigned(args[next_arg++]));
+            if (spec.width < 0)
+            {
+                // 负的宽度表示左对齐
+                if (spec.flags_length < sizeof(spec.flags)) spec.flags[spec.flags_length++] = '-';
+                spec.width = -spec.width;
+            }
+            ++p;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9') spec.width = spec.width * 10 + (*p++ - '0');
+        }
+        if (*p == '.')
+        {
+            ++p;
+            spec.precision = 0;
+            if (*p == '*')
+            {
+                if (next_arg < arg_count) spec.precision = static_cast<int>(ToSigned(args[next_arg++]));
+                if (spec.precision < 0) spec.precision = -1;
+                ++p;
+            }
+            else
+            {
+                while (*p >= '0' && *p <= '9') spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+        if (spec.width > kMaxWidth) spec.width = kMaxWidth;
+        if (spec.precision > kMaxWidth) spec.precision = kMaxWidth;
+        // 长度修饰符按参数的实际类型决定
+        while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) ++p;
+
+        spec.conversion = *p;
+        if (spec.conversion == '\0' || strchr("diuoxXeEfFgGaAcsp", spec.conversion) == nullptr ||
+            next_arg >= arg_count)
+        {
+            // 无法识别的转换说明或者参数不足时原样输出
+            if (*p != '\0') ++p;
+            stream.Append(spec_begin, p - spec_begin);
+            continue;
+        }
+        ++p;
+
+        const BinaryArgValue& arg = args[next_arg++];
+        char spec_buf[64];
+        switch (spec.conversion)
+        {
+            case 'd':
+            case 'i':
+                BuildSpec(spec, "ll", spec.conversion, spec_buf, sizeof(spec_buf));
+                FormatSignedArg(stream, spec_buf, ToSigned(arg));
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                BuildSpec(spec, "ll", spec.conversion, spec_buf, sizeof(spec_buf));
+                FormatUnsignedArg(stream, spec_buf, ToUnsigned(arg));
+                break;
+            case 'c':
+            {
+                char c = arg.type == 's' ? (arg.length > 0 ? arg.s[0] : '\0') : static_cast<char>(ToSigned(arg));
+                spec.precision = -1;
+                FormatStringArg(stream, spec, &c, 1);
+                break;
+            }
+            case 'p':
+                BuildSpec(spec, "", 'p', spec_buf, sizeof(spec_buf));
+                {
+                    char buf[320];
+                    int n = snprintf(buf, sizeof(buf), spec_buf, reinterpret_cast<void*>(ToUnsigned(arg)));
+                    if (n > 0) stream.Append(buf, static_cast<size_t>(n) < sizeof(buf) ? n : sizeof(buf) - 1);
+                }
+                break;
+            case 's':
+                FormatArgByType(stream, spec, arg);
+                break;
+            default:
+                if (arg.type == 's')
+                {
+                    FormatStringArg(stream, spec, arg.s, arg.length);
+                    break;
+                }
+                BuildSpec(spec, "", spec.conversion, spec_buf, sizeof(spec_buf));
+                FormatDoubleArg(stream, spec_buf, ToDouble(arg));
+                break;
+        }
+    }
+}
+
+// 解码varint，数据不完整时返回nullptr
+static const char* DecodeVarint(const char* p, const char* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return p;
+    }
+    return nullptr;
+}
+
+bool DecodeBinaryArgs(const char* arg_types, const char* data, size_t length, BinaryArgValue* args)
+{
+    const char* end = data + length;
+    for (size_t i = 0; arg_types[i] != '\0'; ++i)
+    {
+        BinaryArgValue& arg = args[i];
+        arg.type = arg_types[i];
+        arg.length = 0;
+        uint64_t value = 0;
+        switch (arg.type)
+        {
+            case 'i':
+                if ((data = DecodeVarint(data, end, value)) == nullptr) return false;
+                arg.i = ZigZagDecode(value);
+                break;
+            case 'u':
+            case 'p':
+                if ((data = DecodeVarint(data, end, arg.u)) == nullptr) return false;
+                break;
+            case 'd':
+                if (end - data < static_cast<ptrdiff_t>(sizeof(double))) return false;
+                memcpy(&arg.d, data, sizeof(double));
+                data += sizeof(double);
+                break;
+            case 'b':
+            case 'c':
+                if (end - data < 1) return false;
+                arg.i = static_cast<char>(*data++);
+                break;
+            case 's':
+                if ((data = DecodeVarint(data, end, value)) == nullptr) return false;
+                if (static_cast<uint64_t>(end - data) < value) return false;
+                arg.length = static_cast<uint32_t>(value);
+                arg.s = data;
+                data += arg.length;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+}  // namespace Nlog
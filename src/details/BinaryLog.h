@@ -0,0 +1,473 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "LogSeverity.h"
+#include "LogSite.h"
+#include "LogStream.h"
+
+namespace Nlog
+{
+// 二进制日志模式：业务线程只记录调用点ID和参数的原始字节，不做任何文本格式化，
+// 由后台线程把记录写入二进制文件，离线使用nlog_decode还原为文本日志。
+//
+// 文件格式（本机字节序）：
+//   文件头: kBinaryLogMagic，每次打开文件都会写入，之后的调用点ID重新编号
+//   调用点: 'S' u32 id, u32 severity, i32 line, 再依次是file/func/module/format/arg_types，每个字符串为u32长度+内容
+//   数据块: 'B' i64 thread_id, u32 length, 之后是length字节的连续日志记录
+//   日志记录: BinaryRecordHeader + 参数，参数按调用点arg_types中的类型依次编码：
+//            整数为varint（有符号数先zigzag），浮点数为8字节double，字符串为varint长度+内容
+constexpr char kBinaryLogMagic[] = "NLOGBIN1";
+constexpr size_t kBinaryLogMagicSize = sizeof(kBinaryLogMagic) - 1;
+constexpr char kBinarySiteEntry = 'S';
+constexpr char kBinaryBlockEntry = 'B';
+
+// 单个字符串参数最多记录的字节数
+constexpr uint32_t kMaxBinaryStringLength = 4096;
+
+// 日志调用点，每条LOG_BINARY语句对应一个静态对象
+struct BinaryLogSite
+{
+    constexpr BinaryLogSite(LogSeverity log_severity, const char* log_file, size_t file_length, const char* log_func,
+                            size_t func_length, int log_line, const char* log_module, const char* log_format)
+        : site(log_severity, log_file, file_length, log_func, func_length, log_line, log_module),
+          format(log_format),
+          arg_types(""),
+          id(0)
+    {
+    }
+
+    // 等级、文件名、函数名、行数和模块名，按文本日志输出时直接使用
+    LogSite site;
+    // printf风格的格式串，长度修饰符（l、ll、z等）会被忽略，按参数的实际类型输出
+    const char* const format;
+    // 参数类型签名，第一次打印时注册
+    const char* arg_types;
+    // 调用点ID，0表示还没有注册
+    std::atomic<uint32_t> id;
+};
+
+// 日志记录头部
+struct BinaryRecordHeader
+{
+    uint32_t site_id;
+    // 整条记录的长度，包含头部
+    uint32_t length;
+    // 打印日志的时间（微秒）
+    int64_t timestamp_us;
+};
+
+// 整数的varint编码，每个字节7位，最高位表示后面还有字节
+inline size_t GetVarintSize(uint64_t value) { return value < 0x80 ? 1 : (64 - __builtin_clzll(value) + 6) / 7; }
+
+inline char* EncodeVarint(char* p, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<char>(value);
+    return p;
+}
+
+// zigzag编码，使绝对值小的负数也只占很少的字节
+inline uint64_t ZigZagEncode(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+inline int64_t ZigZagDecode(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+// 解码后的参数
+struct BinaryArgValue
+{
+    char type;
+    uint32_t length;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char* s;
+    };
+};
+
+// 参数类型的编码方式，不支持的类型在编译期报错
+template <typename T, typename Enable = void>
+struct BinaryArg;
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value &&
+                                            !std::is_same<T, char>::value>::type>
+{
+    static constexpr char kType = 'i';
+    static size_t Size(T value) { return GetVarintSize(ZigZagEncode(value)); }
+    static char* Encode(char* p, T value) { return EncodeVarint(p, ZigZagEncode(value)); }
+    static BinaryArgValue ToValue(T value)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = 0;
+        v.i = value;
+        return v;
+    }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                            !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+{
+    static constexpr char kType = 'u';
+    static size_t Size(T value) { return GetVarintSize(value); }
+    static char* Encode(char* p, T value) { return EncodeVarint(p, value); }
+    static BinaryArgValue ToValue(T value)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = 0;
+        v.u = value;
+        return v;
+    }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    static constexpr char kType = 'd';
+    static size_t Size(T) { return sizeof(double); }
+    static char* Encode(char* p, T value)
+    {
+        double v = static_cast<double>(value);
+        memcpy(p, &v, sizeof(v));
+        return p + sizeof(v);
+    }
+    static BinaryArgValue ToValue(T value)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = 0;
+        v.d = static_cast<double>(value);
+        return v;
+    }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_same<T, bool>::value || std::is_same<T, char>::value>::type>
+{
+    static constexpr char kType = std::is_same<T, bool>::value ? 'b' : 'c';
+    static size_t Size(T) { return 1; }
+    static char* Encode(char* p, T value)
+    {
+        *p = static_cast<char>(value);
+        return p + 1;
+    }
+    static BinaryArgValue ToValue(T value)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = 0;
+        v.i = value;
+        return v;
+    }
+};
+
+// 字符串：varint长度 + 内容，空指针按"(null)"记录
+struct BinaryStringArg
+{
+    static constexpr char kType = 's';
+    static uint32_t Length(const char* value, size_t length)
+    {
+        return value == nullptr ? 6 : static_cast<uint32_t>(length < kMaxBinaryStringLength ? length : kMaxBinaryStringLength);
+    }
+    static size_t Size(uint32_t length) { return GetVarintSize(length) + length; }
+    static char* Encode(char* p, const char* value, uint32_t length)
+    {
+        p = EncodeVarint(p, length);
+        memcpy(p, value == nullptr ? "(null)" : value, length);
+        return p + length;
+    }
+    static BinaryArgValue ToValue(const char* value, uint32_t length)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = length;
+        v.s = value == nullptr ? "(null)" : value;
+        return v;
+    }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value>::type>
+{
+    static constexpr char kType = BinaryStringArg::kType;
+    static size_t Size(const char* value)
+    {
+        return BinaryStringArg::Size(BinaryStringArg::Length(value, value == nullptr ? 0 : strlen(value)));
+    }
+    static char* Encode(char* p, const char* value)
+    {
+        return BinaryStringArg::Encode(p, value, BinaryStringArg::Length(value, value == nullptr ? 0 : strlen(value)));
+    }
+    static BinaryArgValue ToValue(const char* value)
+    {
+        return BinaryStringArg::ToValue(value, BinaryStringArg::Length(value, value == nullptr ? 0 : strlen(value)));
+    }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_same<T, std::string>::value>::type>
+{
+    static constexpr char kType = BinaryStringArg::kType;
+    static size_t Size(const std::string& value)
+    {
+        return BinaryStringArg::Size(BinaryStringArg::Length(value.data(), value.size()));
+    }
+    static char* Encode(char* p, const std::string& value)
+    {
+        return BinaryStringArg::Encode(p, value.data(), BinaryStringArg::Length(value.data(), value.size()));
+    }
+    static BinaryArgValue ToValue(const std::string& value)
+    {
+        return BinaryStringArg::ToValue(value.data(), BinaryStringArg::Length(value.data(), value.size()));
+    }
+};
+
+// 其他指针按地址记录
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, const char*>::value &&
+                                            !std::is_same<T, char*>::value>::type>
+{
+    static constexpr char kType = 'p';
+    static size_t Size(T value) { return GetVarintSize(reinterpret_cast<uintptr_t>(value)); }
+    static char* Encode(char* p, T value) { return EncodeVarint(p, reinterpret_cast<uintptr_t>(value)); }
+    static BinaryArgValue ToValue(T value)
+    {
+        BinaryArgValue v;
+        v.type = kType;
+        v.length = 0;
+        v.u = reinterpret_cast<uintptr_t>(value);
+        return v;
+    }
+};
+
+template <typename T>
+using BinaryArgOf = BinaryArg<typename std::decay<T>::type>;
+
+// 参数类型签名，每种参数组合一个静态字符串
+template <typename... Args>
+const char* GetBinaryArgTypes()
+{
+    static const char kArgTypes[] = {BinaryArgOf<Args>::kType..., '\0'};
+    return kArgTypes;
+}
+
+inline size_t GetBinaryArgsSize() { return 0; }
+
+template <typename T, typename... Rest>
+inline size_t GetBinaryArgsSize(const T& value, const Rest&... rest)
+{
+    return BinaryArgOf<T>::Size(value) + GetBinaryArgsSize(rest...);
+}
+
+inline char* EncodeBinaryArgs(char* p) { return p; }
+
+template <typename T, typename... Rest>
+inline char* EncodeBinaryArgs(char* p, const T& value, const Rest&... rest)
+{
+    return EncodeBinaryArgs(BinaryArgOf<T>::Encode(p, value), rest...);
+}
+
+// 业务线程和后台线程之间的单生产者单消费者字节环形缓冲区，每个业务线程一个。
+// 记录总是连续存放，尾部放不下时从头开始，并记下有效数据的结尾
+class BinaryStagingBuffer
+{
+  public:
+    BinaryStagingBuffer(size_t capacity, long thread_id);
+    ~BinaryStagingBuffer();
+
+    // noncopyable
+    BinaryStagingBuffer(const BinaryStagingBuffer&) = delete;
+    BinaryStagingBuffer& operator=(const BinaryStagingBuffer&) = delete;
+
+    /**
+     * 预留一段连续空间（生产者调用）
+     * @param length 需要的字节数
+     * @return 空间起始地址，空间不足时返回nullptr
+     */
+    inline char* Reserve(size_t length)
+    {
+        size_t producer_pos = producer_pos_.load(std::memory_order_relaxed);
+        // 先用缓存的消费位置判断，消费者只会前进，旧值算出的空闲空间一定是真实可用的
+        char* space = TryReserve(producer_pos, cached_consumer_pos_, length);
+        if (space != nullptr) return space;
+        cached_consumer_pos_ = consumer_pos_.load(std::memory_order_acquire);
+        return TryReserve(producer_pos, cached_consumer_pos_, length);
+    }
+
+    /**
+     * 提交Reserve得到的空间（生产者调用）
+     * @param length 实际写入的字节数
+     */
+    inline void Commit(size_t length)
+    {
+        producer_pos_.store(producer_pos_.load(std::memory_order_relaxed) + length, std::memory_order_release);
+    }
+
+    /**
+     * 获取可读取的连续数据（消费者调用）
+     * @param length 可读取的字节数
+     * @return 数据起始地址
+     */
+    const char* Peek(size_t& length);
+
+    /**
+     * 释放已经读取的数据（消费者调用）
+     * @param length 字节数
+     */
+    void Consume(size_t length) { consumer_pos_.store(consumer_pos_.load(std::memory_order_relaxed) + length, std::memory_order_release); }
+
+    size_t GetCapacity() const { return capacity_; }
+    long GetThreadId() const { return thread_id_; }
+
+    // 线程退出后标记，后台线程读完剩余数据后释放
+    void Retire() { retired_.store(true, std::memory_order_release); }
+    bool IsRetired() const { return retired_.load(std::memory_order_acquire); }
+
+  private:
+    inline char* TryReserve(size_t producer_pos, size_t consumer_pos, size_t length)
+    {
+        if (producer_pos >= consumer_pos)
+        {
+            // 可用空间为[producer_pos, capacity)和[0, consumer_pos - 1)
+            if (capacity_ - producer_pos >= length) return storage_ + producer_pos;
+            if (consumer_pos <= length) return nullptr;
+            // 尾部放不下，回绕到缓冲区开头。生产者永远不会追上消费者，两者相等表示缓冲区为空
+            end_of_recorded_ = producer_pos;
+            producer_pos_.store(0, std::memory_order_release);
+            return storage_;
+        }
+        // 可用空间为[producer_pos, consumer_pos - 1)
+        return consumer_pos - producer_pos > length ? storage_ + producer_pos : nullptr;
+    }
+
+    enum
+    {
+        kCacheLineSize = 64
+    };
+
+    char* const storage_;
+    const size_t capacity_;
+    const long thread_id_;
+    std::atomic<bool> retired_;
+
+    // 生产者独占
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> producer_pos_;
+    // 生产者看到的消费位置，减少对consumer_pos_的读取
+    size_t cached_consumer_pos_;
+    // 回绕前有效数据的结尾，在producer_pos_回绕到0之前写入
+    size_t end_of_recorded_;
+
+    // 消费者独占
+    char pad1_[kCacheLineSize];
+    std::atomic<size_t> consumer_pos_;
+    char pad2_[kCacheLineSize];
+};
+
+/**
+ * 注册调用点，分配调用点ID
+ * @param site 调用点
+ * @param arg_types 参数类型签名
+ * @return 调用点ID
+ */
+uint32_t RegisterBinaryLogSite(BinaryLogSite& site, const char* arg_types);
+
+/**
+ * 获取已注册的调用点
+ * @param from 从第几个调用点开始获取
+ * @param sites 输出调用点，ID为下标+1
+ * @return 已注册的调用点总数
+ */
+size_t GetBinaryLogSites(size_t from, std::vector<const BinaryLogSite*>& sites);
+
+/**
+ * 获取当前线程的二进制日志缓冲区
+ * @return 二进制日志模式没有开启时返回nullptr
+ */
+BinaryStagingBuffer* GetThreadBinaryBuffer();
+
+/**
+ * 缓冲区满时等待空位或者丢弃日志
+ * @param buffer 当前线程的缓冲区
+ * @param length 需要的字节数
+ * @return 空间起始地址，日志被丢弃时返回nullptr
+ */
+char* ReserveBinaryRecordSlow(BinaryStagingBuffer* buffer, size_t length);
+
+/**
+ * 二进制日志模式没有开启时按文本日志输出
+ * @param site 调用点
+ * @param args 参数
+ * @param arg_count 参数个数
+ */
+void LogBinaryAsText(const BinaryLogSite& site, const BinaryArgValue* args, size_t arg_count);
+
+/**
+ * 按printf风格的格式串输出参数
+ * @param stream 输出流
+ * @param format 格式串
+ * @param args 参数
+ * @param arg_count 参数个数
+ */
+void FormatBinaryLog(LogStream& stream, const char* format, const BinaryArgValue* args, size_t arg_count);
+
+/**
+ * 按类型签名解码一条记录中的参数，字符串参数指向data内部
+ * @param arg_types 参数类型签名
+ * @param data 参数数据
+ * @param length 参数数据长度
+ * @param args 输出参数，大小至少为strlen(arg_types)
+ * @return 解码成功返回true，数据不完整返回false
+ */
+bool DecodeBinaryArgs(const char* arg_types, const char* data, size_t length, BinaryArgValue* args);
+
+/**
+ * 记录一条二进制日志：只拷贝参数的原始字节，不做格式化
+ * @param site 调用点
+ * @param args 参数
+ */
+template <typename... Args>
+void LogBinary(BinaryLogSite& site, const Args&... args)
+{
+    uint32_t site_id = site.id.load(std::memory_order_acquire);
+    if (__builtin_expect(site_id == 0, 0)) site_id = RegisterBinaryLogSite(site, GetBinaryArgTypes<Args...>());
+
+    BinaryStagingBuffer* buffer = GetThreadBinaryBuffer();
+    if (__builtin_expect(buffer == nullptr, 0))
+    {
+        BinaryArgValue values[sizeof...(Args) + 1] = {BinaryArgOf<Args>::ToValue(args)...};
+        LogBinaryAsText(site, values, sizeof...(Args));
+        return;
+    }
+
+    size_t length = sizeof(BinaryRecordHeader) + GetBinaryArgsSize(args...);
+    char* record = buffer->Reserve(length);
+    if (__builtin_expect(record == nullptr, 0))
+    {
+        record = ReserveBinaryRecordSlow(buffer, length);
+        if (record == nullptr) return;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    BinaryRecordHeader header = {site_id, static_cast<uint32_t>(length),
+                                 static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec};
+    memcpy(record, &header, sizeof(header));
+    EncodeBinaryArgs(record + sizeof(header), args...);
+    buffer->Commit(length);
+}
+}  // namespace Nlog
@@ -0,0 +1,167 @@
+#include "BinaryLogWriter.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+
+namespace Nlog
+{
+// 后台线程空闲时的轮询间隔，业务线程写入时不唤醒后台线程
+constexpr int kIdlePollMs = 1;
+// 文件写缓冲区大小
+constexpr size_t kFileBufferSize = 1 << 20;
+
+std::atomic<BinaryLogWriter*> BinaryLogWriter::current_(nullptr);
+
+std::unique_ptr<BinaryLogWriter> BinaryLogWriter::Create(const std::string& file_path, size_t thread_buffer_size,
+                                                         bool drop_when_full)
+{
+    FILE* file = fopen(file_path.c_str(), "ab");
+    if (file == nullptr) return nullptr;
+    return std::unique_ptr<BinaryLogWriter>(new BinaryLogWriter(file, thread_buffer_size, drop_when_full));
+}
+
+BinaryLogWriter::BinaryLogWriter(FILE* file, size_t thread_buffer_size, bool drop_when_full)
+    : file_(file),
+      file_buffer_(new char[kFileBufferSize]),
+      thread_buffer_size_(thread_buffer_size),
+      drop_when_full_(drop_when_full),
+      running_(true),
+      dropped_count_(0),
+      written_sites_(0)
+{
+    setvbuf(file_, file_buffer_.get(), _IOFBF, kFileBufferSize);
+    fwrite(kBinaryLogMagic, 1, kBinaryLogMagicSize, file_);
+    worker_thread_ = std::thread(&BinaryLogWriter::Run, this);
+}
+
+BinaryLogWriter::~BinaryLogWriter()
+{
+    Stop();
+    fclose(file_);
+}
+
+std::shared_ptr<BinaryStagingBuffer> BinaryLogWriter::CreateThreadBuffer()
+{
+    std::shared_ptr<BinaryStagingBuffer> buffer =
+        std::make_shared<BinaryStagingBuffer>(thread_buffer_size_, static_cast<long>(syscall(__NR_gettid)));
+    std::lock_guard<std::mutex> lock(mtx_);
+    buffers_.push_back(buffer);
+    return buffer;
+}
+
+void BinaryLogWriter::Stop()
+{
+    if (!worker_thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        running_.store(false);
+    }
+    cv_.notify_one();
+    worker_thread_.join();
+}
+
+void BinaryLogWriter::Run()
+{
+    for (;;)
+    {
+        // 先读取运行状态再输出，保证停止前提交的记录都会被写出
+        bool running = running_.load(std::memory_order_acquire);
+        if (Drain() > 0) continue;
+
+        fflush(file_);
+        if (!running) break;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::milliseconds(kIdlePollMs),
+                     [this] { return !running_.load(std::memory_order_relaxed); });
+    }
+}
+
+size_t BinaryLogWriter::Drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        drain_buffers_ = buffers_;
+    }
+
+    size_t total = 0;
+    bool has_retired = false;
+    for (auto& buffer : drain_buffers_)
+    {
+        // 先确认线程已经退出再读取，读完为空的缓冲区之后不会再有数据
+        bool retired = buffer->IsRetired();
+        size_t length = 0;
+        const char* data = buffer->Peek(length);
+        if (length == 0)
+        {
+            has_retired = has_retired || retired;
+            continue;
+        }
+
+        // 缓冲区中的记录引用的调用点都在写入记录之前注册，读取缓冲区之后再写出新注册的调用点，
+        // 保证本块中的调用点已经写在块之前
+        WriteNewSites();
+        total += length;
+
+        int64_t thread_id = buffer->GetThreadId();
+        uint32_t block_length = static_cast<uint32_t>(length);
+        fputc(kBinaryBlockEntry, file_);
+        fwrite(&thread_id, sizeof(thread_id), 1, file_);
+        fwrite(&block_length, sizeof(block_length), 1, file_);
+        fwrite(data, 1, length, file_);
+        buffer->Consume(length);
+    }
+
+    if (has_retired)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (size_t i = 0; i < buffers_.size();)
+        {
+            size_t length = 0;
+            if (buffers_[i]->IsRetired() && (buffers_[i]->Peek(length), length == 0))
+            {
+                buffers_[i] = buffers_.back();
+                buffers_.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+    drain_buffers_.clear();
+    return total;
+}
+
+void BinaryLogWriter::WriteNewSites()
+{
+    new_sites_.clear();
+    size_t from = written_sites_;
+    written_sites_ = GetBinaryLogSites(from, new_sites_);
+    for (size_t i = 0; i < new_sites_.size(); ++i)
+    {
+        const BinaryLogSite* site = new_sites_[i];
+        uint32_t site_id = static_cast<uint32_t>(from + i + 1);
+        uint32_t severity = site->site.severity;
+        int32_t line = site->site.line;
+        fputc(kBinarySiteEntry, file_);
+        fwrite(&site_id, sizeof(site_id), 1, file_);
+        fwrite(&severity, sizeof(severity), 1, file_);
+        fwrite(&line, sizeof(line), 1, file_);
+        WriteString(site->site.file);
+        WriteString(site->site.func);
+        WriteString(site->site.module);
+        WriteString(site->format);
+        WriteString(site->arg_types);
+    }
+}
+
+void BinaryLogWriter::WriteString(const char* str)
+{
+    uint32_t length = static_cast<uint32_t>(strlen(str));
+    fwrite(&length, sizeof(length), 1, file_);
+    fwrite(str, 1, length, file_);
+}
+}  // namespace Nlog
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BinaryLog.h"
+
+namespace Nlog
+{
+// 二进制日志后台线程：轮询所有业务线程的缓冲区，把记录原样写到二进制文件，
+// 写数据前先补写新注册的调用点，保证解码时每条记录的调用点都已经出现过
+class BinaryLogWriter
+{
+  public:
+    /**
+     * 打开二进制日志文件并启动后台线程
+     * @param file_path 二进制日志文件路径，已存在时追加
+     * @param thread_buffer_size 每个业务线程的缓冲区大小（字节）
+     * @param drop_when_full 缓冲区满时是否丢弃日志，false表示业务线程等待缓冲区有空位
+     * @return 打开文件失败时返回nullptr
+     */
+    static std::unique_ptr<BinaryLogWriter> Create(const std::string& file_path, size_t thread_buffer_size,
+                                                   bool drop_when_full);
+
+    /**
+     * 设置/获取业务线程当前使用的后台线程，为空表示二进制日志模式没有开启
+     */
+    static void SetCurrent(BinaryLogWriter* writer) { current_.store(writer, std::memory_order_release); }
+    static BinaryLogWriter* GetCurrent() { return current_.load(std::memory_order_acquire); }
+
+    BinaryLogWriter(FILE* file, size_t thread_buffer_size, bool drop_when_full);
+    BinaryLogWriter(const BinaryLogWriter&) = delete;
+    BinaryLogWriter& operator=(const BinaryLogWriter&) = delete;
+    ~BinaryLogWriter();
+
+    /**
+     * 为调用线程创建缓冲区
+     */
+    std::shared_ptr<BinaryStagingBuffer> CreateThreadBuffer();
+
+    /**
+     * 停止后台线程，停止前会写完所有缓冲区中的记录
+     */
+    void Stop();
+
+    bool IsRunning() const { return running_.load(std::memory_order_relaxed); }
+    bool IsDropWhenFull() const { return drop_when_full_; }
+
+    void AddDroppedCount() { dropped_count_.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t GetDroppedCount() const { return dropped_count_.load(std::memory_order_relaxed); }
+
+  private:
+    void Run();
+
+    // 写出所有缓冲区中的记录，返回写出的字节数
+    size_t Drain();
+
+    // 补写新注册的调用点
+    void WriteNewSites();
+
+    void WriteString(const char* str);
+
+  private:
+    static std::atomic<BinaryLogWriter*> current_;
+
+    FILE* const file_;
+    std::unique_ptr<char[]> file_buffer_;
+    const size_t thread_buffer_size_;
+    const bool drop_when_full_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> dropped_count_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    // 所有业务线程的缓冲区，mtx_保护
+    std::vector<std::shared_ptr<BinaryStagingBuffer>> buffers_;
+    // 后台线程使用的缓冲区列表副本
+    std::vector<std::shared_ptr<BinaryStagingBuffer>> drain_buffers_;
+    // 已经写到文件的调用点个数
+    size_t written_sites_;
+    std::vector<const BinaryLogSite*> new_sites_;
+    std::thread worker_thread_;
+};
+}  // namespace Nlog
@@ -4,7 +4,7 @@ namespace Nlog {
 
 static const char* level_names[Level::N_LEVELS] LEVEL_NAMES;
 static const char* short_level_names[Level::N_LEVELS] SHORT_LEVEL_NAMES;
-statoc const char* color_tags[Level::N_LEVELS] COLOR_TAGS;
+static const char* color_tags[Level::N_LEVELS] COLOR_TAGS;
 
 const char* ToNameStr(Level level) { return level_names[level]; }
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <type_traits>
+#include <utility>
+
 namespace Nlog {
 // 日志级别
 enum Level
@@ -0,0 +1,180 @@
+#include "HeaderPattern.h"
+
+#include <string.h>
+
+#include "LogMessage.h"
+#include "NumberFormatter.h"
+#include "TimeCache.h"
+
+namespace Nlog
+{
+// 最常用的完整时间格式，编译时合并成一个操作，直接拷贝缓存的时间文本
+constexpr char kDateTimePattern[] = "%Y-%M-%D %h:%m:%s";
+constexpr size_t kDateTimePatternLength = sizeof(kDateTimePattern) - 1;
+constexpr char kDateTimeMsPattern[] = "%Y-%M-%D %h:%m:%s.%i";
+constexpr size_t kDateTimeMsPatternLength = sizeof(kDateTimeMsPattern) - 1;
+
+void HeaderPattern::Compile(const std::string& pattern)
+{
+    ops_.clear();
+    literals_.clear();
+    has_time_field_ = false;
+
+    size_t sz = pattern.size();
+    for (size_t i = 0; i < sz; ++i)
+    {
+        if (pattern[i] != '%')
+        {
+            // 相邻的字面量字符合并成一个片段
+            if (!ops_.empty() && ops_.back().type == kLiteral)
+            {
+                ++ops_.back().length;
+            }
+            else
+            {
+                ops_.push_back(Op{kLiteral, static_cast<uint32_t>(literals_.size()), 1});
+            }
+            literals_.push_back(pattern[i]);
+            continue;
+        }
+
+        if (pattern.compare(i, kDateTimeMsPatternLength, kDateTimeMsPattern) == 0)
+        {
+            has_time_field_ = true;
+            ops_.push_back(Op{kDateTimeMs, 0, 0});
+            i += kDateTimeMsPatternLength - 1;
+            continue;
+        }
+        if (pattern.compare(i, kDateTimePatternLength, kDateTimePattern) == 0)
+        {
+            has_time_field_ = true;
+            ops_.push_back(Op{kDateTime, 0, 0});
+            i += kDateTimePatternLength - 1;
+            continue;
+        }
+
+        if (++i >= sz) break;
+
+        OpType type;
+        switch (pattern[i])
+        {
+            case 'Y': type = kYear; break;
+            case 'M': type = kMonth; break;
+            case 'D': type = kDay; break;
+            case 'h': type = kHour; break;
+            case 'm': type = kMinute; break;
+            case 's': type = kSecond; break;
+            case 'i': type = kMillisecond; break;
+            case 'V': type = kSeverityName; break;
+            case 'v': type = kSeverityAbbName; break;
+            case 'T': type = kThreadId; break;
+            case 'F': type = kFileName; break;
+            case 'L': type = kLine; break;
+            case 'U': type = kFunc; break;
+            default: continue;
+        }
+        if (type >= kYear && type <= kSecond) has_time_field_ = true;
+        ops_.push_back(Op{type, 0, 0});
+    }
+}
+
+// 带边界检查的输出
+class HeaderWriter
+{
+  public:
+    HeaderWriter(char* buf, size_t size) : cur_(buf), begin_(buf), end_(buf + size) {}
+
+    void Append(const char* data, size_t length)
+    {
+        size_t avail = end_ - cur_;
+        if (length > avail) length = avail;
+        memcpy(cur_, data, length);
+        cur_ += length;
+    }
+
+    void Append(char c)
+    {
+        if (cur_ < end_) *cur_++ = c;
+    }
+
+    size_t Length() const { return cur_ - begin_; }
+
+  private:
+    char* cur_;
+    char* const begin_;
+    char* const end_;
+};
+
+size_t HeaderPattern::Format(const LogMessage& log_message, char* buf, size_t size) const
+{
+    // 文件名、函数名及其长度在调用点中编译期算好
+    const LogSite& site = log_message.GetSite();
+    // 年月日时分秒取自线程级缓存的时间文本
+    const char* local_time = has_time_field_ ? TimeCache::FormatLocalTime(log_message.GetTime()) : nullptr;
+
+    HeaderWriter writer(buf, size);
+    char digits[NumberFormatter::kMaxUnsignedDigits + 1];
+    for (const Op& op : ops_)
+    {
+        switch (op.type)
+        {
+            case kLiteral:
+                writer.Append(literals_.data() + op.offset, op.length);
+                break;
+            case kDateTimeMs:
+                writer.Append(local_time, TimeCache::kDateTimeMsLength);
+                break;
+            case kDateTime:
+                writer.Append(local_time, TimeCache::kDateTimeLength);
+                break;
+            case kYear:
+                writer.Append(local_time + TimeCache::kYearOffset, 4);
+                break;
+            case kMonth:
+                writer.Append(local_time + TimeCache::kMonthOffset, 2);
+                break;
+            case kDay:
+                writer.Append(local_time + TimeCache::kDayOffset, 2);
+                break;
+            case kHour:
+                writer.Append(local_time + TimeCache::kHourOffset, 2);
+                break;
+            case kMinute:
+                writer.Append(local_time + TimeCache::kMinuteOffset, 2);
+                break;
+            case kSecond:
+                writer.Append(local_time + TimeCache::kSecondOffset, 2);
+                break;
+            case kMillisecond:
+                NumberFormatter::WritePadded3(static_cast<unsigned>(log_message.GetTime().tv_usec / 1000), digits);
+                writer.Append(digits, 3);
+                break;
+            case kSeverityName:
+            {
+                // 右对齐，宽度为5
+                const char* name = GetLogSeverityName(log_message.GetLogSeverity());
+                size_t length = strlen(name);
+                for (size_t i = length; i < 5; ++i) writer.Append(' ');
+                writer.Append(name, length);
+                break;
+            }
+            case kSeverityAbbName:
+                writer.Append(GetLogSeverityAbbName(log_message.GetLogSeverity()));
+                break;
+            case kThreadId:
+                writer.Append(digits, NumberFormatter::FormatSigned(log_message.GetThreadId(), digits));
+                break;
+            case kFileName:
+                writer.Append(site.file_name, site.file_name_length);
+                break;
+            case kLine:
+                writer.Append(digits, NumberFormatter::FormatSigned(site.line, digits));
+                break;
+            case kFunc:
+                writer.Append(site.func, site.func_length);
+                break;
+        }
+    }
+    return writer.Length();
+}
+}  // namespace Nlog
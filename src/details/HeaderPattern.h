@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Nlog
+{
+class LogMessage;
+
+// 预编译的日志头部格式
+// 设置格式时把格式串解析成一组格式化操作（字面量片段 + 字段输出），输出日志时按顺序执行，
+// 直接写到调用方提供的缓冲区，不再逐字符解释格式串，也不使用iostream和堆内存
+class HeaderPattern
+{
+  public:
+    enum
+    {
+        // 日志头部的建议缓冲区大小，超出的部分会被截断
+        kMaxHeaderSize = 1024
+    };
+
+    HeaderPattern() : has_time_field_(false) {}
+
+    explicit HeaderPattern(const std::string& pattern) { Compile(pattern); }
+
+    /**
+     * 编译头部格式串，格式串的合法性由调用方保证（见Logger::IsHeaderPatternValid）
+     * @param pattern 头部格式串
+     */
+    void Compile(const std::string& pattern);
+
+    /**
+     * 按编译好的格式输出日志头部
+     * @param log_message 日志消息
+     * @param buf 输出缓冲区
+     * @param size 缓冲区大小，空间不足时截断
+     * @return 输出的字符数（不包含'\0'，也不会写入'\0'）
+     */
+    size_t Format(const LogMessage& log_message, char* buf, size_t size) const;
+
+  private:
+    enum OpType : uint8_t
+    {
+        kLiteral,           // 字面量片段
+        kYear,              // %Y 年
+        kMonth,             // %M 月
+        kDay,               // %D 日
+        kHour,              // %h 小时
+        kMinute,            // %m 分钟
+        kSecond,            // %s 秒
+        kMillisecond,       // %i 毫秒
+        kSeverityName,      // %V 日志等级全称
+        kSeverityAbbName,   // %v 日志等级缩写
+        kThreadId,          // %T 线程号
+        kFileName,          // %F 文件名
+        kLine,              // %L 行号
+        kFunc,              // %U 调用函数名
+        kDateTime,          // %Y-%M-%D %h:%m:%s 合并后的完整时间
+        kDateTimeMs,        // %Y-%M-%D %h:%m:%s.%i 合并后的完整时间
+    };
+
+    struct Op
+    {
+        OpType type;
+        // 字面量片段在literals_中的位置
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // 格式化操作序列
+    std::vector<Op> ops_;
+    // 所有字面量片段
+    std::string literals_;
+    // 是否包含年月日时分秒字段，不包含时不需要计算本地时间
+    bool has_time_field_;
+};
+}  // namespace Nlog
@@ -0,0 +1,173 @@
+#include "IoUring.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Nlog
+{
+static int IoUringSetup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int IoUringRegister(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+// 提交队列和完成队列的头尾指针与内核共享，需要acquire/release语义
+static unsigned LoadAcquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void StoreRelease(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+IoUring::IoUring()
+    : ring_fd_(-1),
+      features_(0),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_array_(nullptr),
+      sqe_tail_(0),
+      to_submit_(0),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(0),
+      cqes_(nullptr)
+{
+}
+
+IoUring::~IoUring()
+{
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+}
+
+bool IoUring::Init(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = IoUringSetup(entries, &params);
+    if (ring_fd_ < 0) return false;
+    features_ = params.features;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // 新内核中提交队列和完成队列在同一块内存中，只需要映射一次
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) return false;
+    if (single_mmap)
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else
+    {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) return false;
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq_ring = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_entries);
+    sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+    sqe_tail_ = *sq_tail_;
+
+    char* cq_ring = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::RegisterBuffers(const struct iovec* iovecs, unsigned count)
+{
+    return IoUringRegister(ring_fd_, IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+}
+
+bool IoUring::IsOpSupported(unsigned opcode)
+{
+    // 查询结果的ops数组长度为操作码的个数，按操作码的最大值分配
+    constexpr unsigned kMaxOps = 256;
+    union
+    {
+        struct io_uring_probe probe;
+        char data[sizeof(struct io_uring_probe) + kMaxOps * sizeof(struct io_uring_probe_op)];
+    } buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    if (IoUringRegister(ring_fd_, IORING_REGISTER_PROBE, &buffer.probe, kMaxOps) < 0) return false;
+    return opcode <= buffer.probe.last_op && (buffer.probe.ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+struct io_uring_sqe* IoUring::GetSqe()
+{
+    if (sqe_tail_ - LoadAcquire(sq_head_) >= sq_entries_) return nullptr;
+
+    unsigned index = sqe_tail_ & sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+}
+
+int IoUring::Submit(unsigned wait_count)
+{
+    to_submit_ += sqe_tail_ - *sq_tail_;
+    StoreRelease(sq_tail_, sqe_tail_);
+
+    unsigned flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do
+    {
+        ret = IoUringEnter(ring_fd_, to_submit_, wait_count, flags);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) return -errno;
+
+    // 内核可能只消费了一部分提交项（如完成队列快满时），剩下的下次再提交
+    to_submit_ -= std::min(static_cast<unsigned>(ret), to_submit_);
+    return ret;
+}
+
+struct io_uring_cqe* IoUring::PeekCqe()
+{
+    unsigned head = *cq_head_;
+    if (head == LoadAcquire(cq_tail_)) return nullptr;
+    return &cqes_[head & cq_mask_];
+}
+
+void IoUring::SeenCqe() { StoreRelease(cq_head_, *cq_head_ + 1); }
+}  // namespace Nlog
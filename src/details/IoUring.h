@@ -0,0 +1,98 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+
+namespace Nlog
+{
+// io_uring的最小封装，直接使用系统调用，不依赖liburing。
+// 只支持单线程使用：提交和收割都在同一个线程中进行
+class IoUring
+{
+  public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * 创建io_uring实例并映射提交队列和完成队列
+     * @param entries 提交队列长度
+     * @return 内核不支持或者被禁用时返回false
+     */
+    bool Init(unsigned entries);
+
+    /**
+     * 注册固定缓冲区，注册后可以用IORING_OP_WRITE_FIXED写，内核不需要每次映射用户内存
+     * @param iovecs 缓冲区数组
+     * @param count 缓冲区个数
+     * @return 是否注册成功，失败时（如超过RLIMIT_MEMLOCK）仍然可以用普通的写操作
+     */
+    bool RegisterBuffers(const struct iovec* iovecs, unsigned count);
+
+    /**
+     * 查询内核是否支持某个操作，查询需要5.6以上的内核
+     * @param opcode 操作，如IORING_OP_WRITE
+     * @return 不支持该操作或者不支持查询时返回false
+     */
+    bool IsOpSupported(unsigned opcode);
+
+    /**
+     * @return 内核支持的特性（IORING_FEAT_*），可以据此判断内核版本
+     */
+    unsigned GetFeatures() const { return features_; }
+
+    /**
+     * 获取一个空闲的提交项，调用Submit后才会提交给内核
+     * @return 提交队列满时返回nullptr
+     */
+    struct io_uring_sqe* GetSqe();
+
+    /**
+     * 提交所有未提交的提交项，并等待至少wait_count个完成项
+     * @param wait_count 需要等待的完成项个数，0表示不等待
+     * @return 成功时返回提交的个数，失败时返回-errno
+     */
+    int Submit(unsigned wait_count);
+
+    /**
+     * 获取一个完成项，处理完后需要调用SeenCqe
+     * @return 没有完成项时返回nullptr
+     */
+    struct io_uring_cqe* PeekCqe();
+
+    /**
+     * 标记PeekCqe返回的完成项已经处理
+     */
+    void SeenCqe();
+
+  private:
+    int ring_fd_;
+    unsigned features_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* sq_array_;
+    // 本地的提交队列尾部，Submit时发布给内核
+    unsigned sqe_tail_;
+    // 已经发布但还没有被内核消费的提交项个数
+    unsigned to_submit_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+};
+}  // namespace Nlog
@@ -0,0 +1,24 @@
+#include "IterableContainer.h"
+
+#include <atomic>
+
+namespace Nlog
+{
+constexpr size_t ContainerFormat::kUnlimited;
+
+// 默认格式在输出每个容器时读取，分别用原子变量保存
+static std::atomic<size_t> g_container_max_elements(3);
+static std::atomic<const char*> g_container_separator(",");
+
+void SetDefaultContainerFormat(size_t max_elements, const char* separator)
+{
+    g_container_max_elements.store(max_elements, std::memory_order_relaxed);
+    g_container_separator.store(separator != nullptr ? separator : ",", std::memory_order_relaxed);
+}
+
+ContainerFormat GetDefaultContainerFormat()
+{
+    return ContainerFormat{g_container_max_elements.load(std::memory_order_relaxed),
+                           g_container_separator.load(std::memory_order_relaxed)};
+}
+}  // namespace Nlog
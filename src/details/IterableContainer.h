@@ -1,87 +1,73 @@
 #pragma once
 // todo:全部include进来会不会导致程序变大
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <list>
+#include <map>
 #include <queue>
-#include <deque>
 #include <set>
-#include <map>
-#include <unordered_set>
-#include <unordered_map>
 #include <stack>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace Nlog
 {
-template <typename T, typename Container>
-class IterableContainer
+// 容器的输出格式：最多输出的元素个数和元素间的分隔符，超出的元素输出为"..."
+struct ContainerFormat
 {
-  public:
-    typedef typename Container::iterator iterator;
-    typedef typename Container::const_iterator const_iterator;
+    // 不限制元素个数
+    static constexpr size_t kUnlimited = SIZE_MAX;
 
-    IterableContainer() {}
-
-    virtual ~IterableContainer() {}
+    size_t max_elements;
+    // 生命周期需要覆盖之后所有的日志，一般为字符串常量
+    const char* separator;
+};
 
-    iterator begin() { return GetContainer().begin(); }
-    iterator end() { return GetContainer().end(); }
+/**
+ * 设置容器默认的输出格式，默认最多输出3个元素，分隔符为","
+ * @param max_elements 最多输出的元素个数，ContainerFormat::kUnlimited表示不限制
+ * @param separator 分隔符，生命周期需要覆盖之后所有的日志，一般为字符串常量
+ */
+void SetDefaultContainerFormat(size_t max_elements, const char* separator);
 
-  private:
-    virtual Container& GetContainer() = 0;
-};
+/**
+ * 获取容器默认的输出格式
+ */
+ContainerFormat GetDefaultContainerFormat();
 
-template <typename T, typename Container = std::deque<T>>
-class IterableQueue : public IterableContainer<T, Container>, public std::queue<T, Container>
+// 按指定格式输出一个容器，由LogContainer()构造：LOG_INFO(m) << Nlog::LogContainer(v, 10, " ")
+template <typename Container>
+struct ContainerFormatter
 {
-  public:
-    IterableQueue(std::queue<T, Container> q)
-    {
-        std::size_t cnt = 0;
-        // todo 3 + 1，多push进去一个，这样能生成省略号
-        while(cnt++ < 3 + 1 && !q.empty())
-        {
-            this->push(q.front());
-            q.pop();
-        }
-    }
-
-  private:
-    inline Container& GetContainer() { return this->c; }
+    const Container& container;
+    ContainerFormat format;
 };
 
-template <typename T, typename Container = std::vector<T>, typename Compare = std::less<typename Container::value_type>>
-class IterablePriorityQueue : public IterableContainer<T, Container>, public std::priority_queue<T, Container, Compare>
+/**
+ * 按指定格式输出容器，只在本次输出中生效，嵌套的容器仍按默认格式输出
+ * @param container 容器，支持LogMessage能输出的所有容器和容器适配器
+ * @param max_elements 最多输出的元素个数，ContainerFormat::kUnlimited表示不限制
+ * @param separator 分隔符，为nullptr时使用默认的分隔符
+ */
+template <typename Container>
+inline ContainerFormatter<Container> LogContainer(const Container& container, size_t max_elements,
+                                                  const char* separator = nullptr)
 {
-  public:
-    IterablePriorityQueue(std::priority_queue<T, Container, Compare> q)
-    {
-        std::size_t cnt = 0;
-        // todo 3 + 1
-        while(cnt++ < 3 + 1 && !q.empty())
-        {
-            this->push(q.top());
-            q.pop();
-        }
-    }
-  private:
-    inline Container& GetContainer() { return this->c; }
-};
+    return ContainerFormatter<Container>{
+        container, {max_elements, separator != nullptr ? separator : GetDefaultContainerFormat().separator}};
+}
 
-template <typename T, typename Container = std::deque<T>>
-class IterableStack : public IterableContainer<T, Container>, public std::stack<T, Container>
+// 取出容器适配器（queue、stack、priority_queue）内部受保护的底层容器，不拷贝也不修改适配器
+template <typename Adaptor>
+struct AdaptorAccess : Adaptor
 {
-  public:
-    IterableStack(std::stack<T, Container> s)
+    static const typename Adaptor::container_type& GetContainer(const Adaptor& adaptor)
     {
-        std::size_t cnt = 0;
-        // todo 3 + 1
-        while(cnt++ < 3 + 1 && !s.empty())
-        {
-            this->push(s.top());
-            s.pop();
-        }
+        return adaptor.*(&AdaptorAccess::c);
     }
-  private:
-    inline Container& GetContainer() { return this->c; }
 };
-}
\ No newline at end of file
+}  // namespace Nlog
@@ -0,0 +1,183 @@
+#include "JsonWriter.h"
+
+#include <string.h>
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "NumberFormatter.h"
+
+namespace Nlog
+{
+void JsonWriter::BeginObject()
+{
+    Separator();
+    Raw("{", 1);
+    need_comma_ = false;
+}
+
+void JsonWriter::EndObject()
+{
+    Raw("}", 1);
+    need_comma_ = true;
+}
+
+void JsonWriter::Separator()
+{
+    if (need_comma_) Raw(",", 1);
+}
+
+void JsonWriter::Key(const char* key, size_t length)
+{
+    Separator();
+    Raw("\"", 1);
+    AppendEscaped(key, length);
+    Raw("\":", 2);
+    // key之后的值前面不需要','
+    need_comma_ = false;
+}
+
+void JsonWriter::String(const char* value, size_t length)
+{
+    Separator();
+    Raw("\"", 1);
+    AppendEscaped(value, length);
+    Raw("\"", 1);
+    need_comma_ = true;
+}
+
+void JsonWriter::Int(int64_t value)
+{
+    char buf[NumberFormatter::kMaxUnsignedDigits + 1];
+    Separator();
+    Raw(buf, NumberFormatter::FormatSigned(value, buf));
+    need_comma_ = true;
+}
+
+void JsonWriter::Uint(uint64_t value)
+{
+    char buf[NumberFormatter::kMaxUnsignedDigits];
+    Separator();
+    Raw(buf, NumberFormatter::FormatUnsigned(value, buf));
+    need_comma_ = true;
+}
+
+void JsonWriter::Double(double value)
+{
+    if (!std::isfinite(value))
+    {
+        Null();
+        return;
+    }
+    // 能精确还原的最短表示
+    char buf[NumberFormatter::kMaxShortestLength];
+    size_t length = NumberFormatter::FormatShortest(value, buf);
+    Separator();
+    Raw(buf, length);
+    need_comma_ = true;
+}
+
+void JsonWriter::Bool(bool value)
+{
+    Separator();
+    if (value)
+    {
+        Raw("true", 4);
+    }
+    else
+    {
+        Raw("false", 5);
+    }
+    need_comma_ = true;
+}
+
+void JsonWriter::Null()
+{
+    Separator();
+    Raw("null", 4);
+    need_comma_ = true;
+}
+
+void JsonWriter::Raw(const char* data, size_t length)
+{
+    if (truncated_) return;
+    if (length > Available())
+    {
+        truncated_ = true;
+        return;
+    }
+    memcpy(cur_, data, length);
+    cur_ += length;
+}
+
+bool JsonWriter::AppendEscapedChar(unsigned char c)
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+    char escaped[6] = {'\\', 0, '0', '0', 0, 0};
+    size_t length = 2;
+    switch (c)
+    {
+        case '"': escaped[1] = '"'; break;
+        case '\\': escaped[1] = '\\'; break;
+        case '\b': escaped[1] = 'b'; break;
+        case '\f': escaped[1] = 'f'; break;
+        case '\n': escaped[1] = 'n'; break;
+        case '\r': escaped[1] = 'r'; break;
+        case '\t': escaped[1] = 't'; break;
+        default:
+            escaped[1] = 'u';
+            escaped[4] = kHexDigits[c >> 4];
+            escaped[5] = kHexDigits[c & 0xf];
+            length = 6;
+            break;
+    }
+    Raw(escaped, length);
+    return !truncated_;
+}
+
+void JsonWriter::AppendEscaped(const char* value, size_t length)
+{
+    if (truncated_) return;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1f);
+    while (i + 16 <= length && Available() >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + i));
+        // 控制字符：按无符号比较 min(c, 0x1f) == c
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(chunk, control_max), chunk));
+        // 先整块写出，再只保留第一个需要转义的字符之前的部分
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur_), chunk);
+        int mask = _mm_movemask_epi8(special);
+        if (mask == 0)
+        {
+            cur_ += 16;
+            i += 16;
+            continue;
+        }
+        int clean = __builtin_ctz(static_cast<unsigned>(mask));
+        cur_ += clean;
+        i += clean;
+        if (!AppendEscapedChar(static_cast<unsigned char>(value[i]))) return;
+        ++i;
+    }
+#endif
+    // 不足16个字符的尾部或者不支持SSE2时逐个字符处理，连续的普通字符一次拷贝
+    size_t begin = i;
+    for (; i < length; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        Raw(value + begin, i - begin);
+        if (!AppendEscapedChar(c)) return;
+        begin = i + 1;
+    }
+    Raw(value + begin, length - begin);
+}
+}  // namespace Nlog
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+
+namespace Nlog
+{
+// 无内存分配的JSON编码器，直接写到调用方提供的缓冲区。
+// 只支持顺序写对象，不校验调用顺序；字符串按RFC 8259转义，支持SSE2时每次扫描16个字符，
+// 没有需要转义的字符时整块拷贝。缓冲区不足时停止写入并标记截断
+class JsonWriter
+{
+  public:
+    /**
+     * 转义后的字符串的最大长度（每个字符最多转义为\u00XX）
+     * @param length 原始长度
+     */
+    static constexpr size_t MaxEscapedLength(size_t length) { return length * 6; }
+
+    /**
+     * @param buffer 输出缓冲区，由调用方管理
+     * @param capacity 缓冲区大小
+     */
+    JsonWriter(char* buffer, size_t capacity) : buffer_(buffer), cur_(buffer), end_(buffer + capacity) {}
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    void BeginObject();
+    void EndObject();
+
+    /**
+     * 输出对象的key，需要时先输出','
+     * @param key key，不要求以'\0'结尾
+     * @param length key的长度
+     */
+    void Key(const char* key, size_t length);
+
+    void String(const char* value, size_t length);
+    void Int(int64_t value);
+    void Uint(uint64_t value);
+    // NaN和无穷大在JSON中没有对应的表示，输出null
+    void Double(double value);
+    void Bool(bool value);
+    void Null();
+
+    /**
+     * 追加原始文本，不做转义
+     */
+    void Raw(const char* data, size_t length);
+
+    const char* GetData() const { return buffer_; }
+    size_t GetSize() const { return cur_ - buffer_; }
+
+    /**
+     * @return 缓冲区不足导致输出不完整时返回true
+     */
+    bool IsTruncated() const { return truncated_; }
+
+  private:
+    size_t Available() const { return end_ - cur_; }
+
+    // 对象中第二个及之后的成员前输出','
+    void Separator();
+
+    // 输出转义后的字符串内容（不包括两边的引号）
+    void AppendEscaped(const char* value, size_t length);
+
+    // 输出一个需要转义的字符
+    bool AppendEscapedChar(unsigned char c);
+
+  private:
+    char* const buffer_;
+    char* cur_;
+    char* const end_;
+    bool need_comma_ = false;
+    bool truncated_ = false;
+};
+}  // namespace Nlog
@@ -0,0 +1,448 @@
+#include "LogCompressor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/ioprio.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace Nlog
+{
+// LZ4 frame格式，见 https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+constexpr uint32_t kLz4FrameMagic = 0x184D2204;
+// FLG: 版本号01，块之间相互独立，不带校验和
+constexpr uint8_t kLz4FrameFlags = 0x60;
+// BD: 块最大4MB
+constexpr uint8_t kLz4BlockMaxSizeId = 0x70;
+constexpr size_t kLz4BlockSize = 4 * 1024 * 1024;
+// 块大小的最高位为1表示块未压缩
+constexpr uint32_t kLz4UncompressedBlockFlag = 0x80000000U;
+// LZ4 block格式的限制：最短匹配4字节，最后5字节必须是字面量，最后一个匹配至少在结尾前12字节开始
+constexpr size_t kLz4MinMatch = 4;
+constexpr size_t kLz4LastLiterals = 5;
+constexpr size_t kLz4MatchFindLimit = 12;
+constexpr size_t kLz4MaxOffset = 65535;
+constexpr int kLz4HashLog = 16;
+// 后台压缩线程的nice值
+constexpr int kCompressorNice = 19;
+
+static uint32_t ReadU32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// LZ4 frame中的整数都是小端
+static void WriteU32(char* p, uint32_t v)
+{
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+    p[2] = static_cast<char>(v >> 16);
+    p[3] = static_cast<char>(v >> 24);
+}
+
+static void AppendU32(std::string& output, uint32_t v)
+{
+    char bytes[4];
+    WriteU32(bytes, v);
+    output.append(bytes, sizeof(bytes));
+}
+
+static uint32_t RotateLeft(uint32_t v, int bits) { return (v << bits) | (v >> (32 - bits)); }
+
+// XXH32，LZ4 frame头部的校验字节需要用到
+static uint32_t Xxh32(const uint8_t* data, size_t length, uint32_t seed)
+{
+    const uint32_t kPrime1 = 2654435761U;
+    const uint32_t kPrime2 = 2246822519U;
+    const uint32_t kPrime3 = 3266489917U;
+    const uint32_t kPrime4 = 668265263U;
+    const uint32_t kPrime5 = 374761393U;
+
+    const uint8_t* p = data;
+    const uint8_t* end = data + length;
+    uint32_t h;
+    if (length >= 16)
+    {
+        uint32_t v[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+        for (; p + 16 <= end; p += 16)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                v[i] = RotateLeft(v[i] + ReadU32(reinterpret_cast<const char*>(p) + i * 4) * kPrime2, 13) * kPrime1;
+            }
+        }
+        h = RotateLeft(v[0], 1) + RotateLeft(v[1], 7) + RotateLeft(v[2], 12) + RotateLeft(v[3], 18);
+    }
+    else
+    {
+        h = seed + kPrime5;
+    }
+    h += static_cast<uint32_t>(length);
+    for (; p + 4 <= end; p += 4)
+    {
+        h = RotateLeft(h + ReadU32(reinterpret_cast<const char*>(p)) * kPrime3, 17) * kPrime4;
+    }
+    for (; p < end; ++p)
+    {
+        h = RotateLeft(h + *p * kPrime5, 11) * kPrime1;
+    }
+    h ^= h >> 15;
+    h *= kPrime2;
+    h ^= h >> 13;
+    h *= kPrime3;
+    h ^= h >> 16;
+    return h;
+}
+
+// 输出LZ4的变长长度：前面的4位已经是15，剩余部分每字节255，最后一个字节小于255
+static uint8_t* WriteLz4Length(uint8_t* op, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        *op++ = 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+// 输出一个序列：字面量 + 匹配（match_length为0时表示最后的字面量，没有匹配部分）
+static uint8_t* WriteLz4Sequence(uint8_t* op, const uint8_t* literals, size_t literal_length, size_t offset,
+                                 size_t match_length)
+{
+    uint8_t* token = op++;
+    *token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+    if (literal_length >= 15) op = WriteLz4Length(op, literal_length - 15);
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+    if (match_length == 0) return op;
+
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    size_t length = match_length - kLz4MinMatch;
+    *token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+    if (length >= 15) op = WriteLz4Length(op, length - 15);
+    return op;
+}
+
+// 贪心匹配的LZ4块压缩，dst至少要有 length + length / 255 + 16 字节
+static size_t Lz4CompressBlock(const uint8_t* src, size_t length, uint8_t* dst, uint32_t* hash_table)
+{
+    uint8_t* op = dst;
+    size_t anchor = 0;
+    if (length > kLz4MatchFindLimit)
+    {
+        // 哈希表中存放位置+1，0表示空
+        memset(hash_table, 0, sizeof(uint32_t) << kLz4HashLog);
+        size_t match_limit = length - kLz4LastLiterals;
+        size_t ip = 0;
+        while (ip + kLz4MatchFindLimit <= length)
+        {
+            uint32_t sequence = ReadU32(reinterpret_cast<const char*>(src + ip));
+            uint32_t hash = (sequence * 2654435761U) >> (32 - kLz4HashLog);
+            size_t ref = hash_table[hash];
+            hash_table[hash] = static_cast<uint32_t>(ip + 1);
+            if (ref == 0 || ip + 1 - ref > kLz4MaxOffset ||
+                ReadU32(reinterpret_cast<const char*>(src + ref - 1)) != sequence)
+            {
+                // 连续找不到匹配时加大步长，跳过难以压缩的数据
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            --ref;
+
+            size_t match_length = kLz4MinMatch;
+            while (ip + match_length < match_limit && src[ref + match_length] == src[ip + match_length])
+            {
+                ++match_length;
+            }
+            op = WriteLz4Sequence(op, src + anchor, ip - anchor, ip - ref, match_length);
+            ip += match_length;
+            anchor = ip;
+        }
+    }
+    op = WriteLz4Sequence(op, src + anchor, length - anchor, 0, 0);
+    return op - dst;
+}
+
+Lz4LogCodec::Lz4LogCodec() : hash_table_(static_cast<size_t>(1) << kLz4HashLog) {}
+
+size_t Lz4LogCodec::GetBlockSize() const { return kLz4BlockSize; }
+
+bool Lz4LogCodec::Begin(std::string& output)
+{
+    AppendU32(output, kLz4FrameMagic);
+    uint8_t descriptor[2] = {kLz4FrameFlags, kLz4BlockMaxSizeId};
+    output.append(reinterpret_cast<const char*>(descriptor), sizeof(descriptor));
+    output.push_back(static_cast<char>((Xxh32(descriptor, sizeof(descriptor), 0) >> 8) & 0xFF));
+    return true;
+}
+
+bool Lz4LogCodec::CompressBlock(const char* data, size_t length, std::string& output)
+{
+    if (length == 0) return true;
+
+    size_t size_pos = output.size();
+    output.resize(size_pos + sizeof(uint32_t) + length + length / 255 + 16);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(&output[size_pos + sizeof(uint32_t)]);
+    size_t compressed_length =
+        Lz4CompressBlock(reinterpret_cast<const uint8_t*>(data), length, dst, hash_table_.data());
+
+    uint32_t block_size = static_cast<uint32_t>(compressed_length);
+    if (compressed_length >= length)
+    {
+        // 压缩后没有变小时存放原始数据
+        memcpy(dst, data, length);
+        compressed_length = length;
+        block_size = static_cast<uint32_t>(length) | kLz4UncompressedBlockFlag;
+    }
+    WriteU32(&output[size_pos], block_size);
+    output.resize(size_pos + sizeof(uint32_t) + compressed_length);
+    return true;
+}
+
+bool Lz4LogCodec::End(std::string& output)
+{
+    // EndMark
+    AppendU32(output, 0);
+    return true;
+}
+
+// 读满length字节，文件结束时可能更少，失败时返回-1
+static ssize_t ReadFull(int fd, char* data, size_t length)
+{
+    size_t read_length = 0;
+    while (read_length < length)
+    {
+        ssize_t n = read(fd, data + read_length, length - read_length);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        read_length += n;
+    }
+    return read_length;
+}
+
+static bool WriteFull(int fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+LogCompressor::LogCompressor(std::shared_ptr<LogCodec> codec)
+    : codec_(std::move(codec)), busy_(false), stopping_(false)
+{
+}
+
+LogCompressor::~LogCompressor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+std::shared_ptr<LogCompressor> LogCompressor::Create(std::shared_ptr<LogCodec> codec)
+{
+    if (codec == nullptr)
+    {
+        codec = std::make_shared<Lz4LogCodec>();
+    }
+    LogCompressorPtr compressor(new LogCompressor(codec));
+    compressor->thread_ = std::thread(&LogCompressor::Run, compressor.get());
+    return compressor;
+}
+
+void LogCompressor::Submit(const std::string& log_file_name)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_files_.push_back(log_file_name);
+    }
+    cond_.notify_all();
+}
+
+void LogCompressor::SubmitDirectory(const std::string& dir_name)
+{
+    DIR* dir = opendir(dir_name.c_str());
+    if (nullptr == dir)
+    {
+        std::cerr << "INFO: dir not exist, dir:" << dir_name << std::endl;
+        return;
+    }
+
+    std::string tmp_suffix = std::string(".") + codec_->GetSuffix() + ".tmp";
+    std::vector<std::string> log_files;
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr)
+    {
+        int log_index = 0;
+        if (GetTsFromLogFileName(dp->d_name, false, log_index) != 0)
+        {
+            log_files.push_back(dir_name + "/" + dp->d_name);
+        }
+        else if (EndsWith(dp->d_name, tmp_suffix))
+        {
+            // 压缩中断的文件重新压缩，已经压缩完的文件会因为原文件不存在而跳过
+            std::string tmp_name = dp->d_name;
+            int tmp_log_index = 0;
+            std::string log_name = tmp_name.substr(0, tmp_name.size() - tmp_suffix.size());
+            if (GetTsFromLogFileName(log_name, false, tmp_log_index) != 0)
+            {
+                log_files.push_back(dir_name + "/" + log_name);
+            }
+        }
+    }
+    (void)closedir(dir);
+
+    std::sort(log_files.begin(), log_files.end());
+    log_files.erase(std::unique(log_files.begin(), log_files.end()), log_files.end());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::string& log_file : log_files)
+        {
+            if (std::find(pending_files_.begin(), pending_files_.end(), log_file) == pending_files_.end())
+            {
+                pending_files_.push_back(log_file);
+            }
+        }
+    }
+    cond_.notify_all();
+}
+
+RotateCallback LogCompressor::GetRotateCallback()
+{
+    std::weak_ptr<LogCompressor> weak_compressor = shared_from_this();
+    return [weak_compressor](const std::string& log_file_name) {
+        LogCompressorPtr compressor = weak_compressor.lock();
+        if (compressor != nullptr)
+        {
+            compressor->Submit(log_file_name);
+        }
+    };
+}
+
+void LogCompressor::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return stopping_ || (pending_files_.empty() && !busy_); });
+}
+
+void LogCompressor::Run()
+{
+    // 降低CPU和I/O优先级，避免和写日志的线程抢资源，失败时忽略
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    (void)setpriority(PRIO_PROCESS, tid, kCompressorNice);
+    (void)syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        cond_.wait(lock, [this] { return stopping_ || !pending_files_.empty(); });
+        if (stopping_) break;
+
+        std::string log_file_name = pending_files_.front();
+        pending_files_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        if (!CompressFile(log_file_name))
+        {
+            std::cerr << "WARN: compress log file fail, log_file:" << log_file_name << std::endl;
+        }
+
+        lock.lock();
+        busy_ = false;
+        cond_.notify_all();
+    }
+}
+
+bool LogCompressor::CompressFile(const std::string& log_file_name)
+{
+    int in_fd = open(log_file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0)
+    {
+        // 已经被删除或者压缩过
+        return errno == ENOENT;
+    }
+
+    std::string compressed_name = log_file_name + "." + codec_->GetSuffix();
+    std::string tmp_name = compressed_name + ".tmp";
+    int out_fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out_fd < 0)
+    {
+        close(in_fd);
+        return false;
+    }
+
+    std::vector<char> block(codec_->GetBlockSize());
+    std::string output;
+    bool ok = codec_->Begin(output);
+    while (ok)
+    {
+        {
+            // 退出时放弃压缩，原文件保留，下次启动时可以用SubmitDirectory重新压缩
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_)
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        ssize_t length = ReadFull(in_fd, block.data(), block.size());
+        if (length <= 0)
+        {
+            ok = length == 0;
+            break;
+        }
+        ok = codec_->CompressBlock(block.data(), length, output) && WriteFull(out_fd, output);
+        output.clear();
+    }
+    ok = ok && codec_->End(output) && WriteFull(out_fd, output);
+    // 先落盘再改名，保证压缩文件完整后才删除原文件
+    ok = ok && fdatasync(out_fd) == 0;
+
+    // 读过的日志文件不会再用到，不占用页缓存
+    (void)posix_fadvise(in_fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(in_fd);
+    close(out_fd);
+
+    if (ok && rename(tmp_name.c_str(), compressed_name.c_str()) == 0)
+    {
+        // 原文件在压缩过程中被删除（如超过保留策略），压缩结果也不再保留
+        if (unlink(log_file_name.c_str()) != 0 && errno == ENOENT)
+        {
+            unlink(compressed_name.c_str());
+        }
+        return true;
+    }
+    unlink(tmp_name.c_str());
+    return false;
+}
+}  // namespace Nlog
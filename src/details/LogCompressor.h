@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Utils.h"
+
+namespace Nlog
+{
+// 日志文件压缩算法接口，用户可以派生实现其他压缩算法（如gzip、zstd）。
+// 一个压缩文件的输出为 Begin + 若干个CompressBlock + End，同一时间只会压缩一个文件
+class LogCodec
+{
+  public:
+    virtual ~LogCodec() = default;
+
+    /**
+     * @return 压缩文件的后缀（不含点），压缩后的文件名为 原文件名.后缀
+     */
+    virtual const char* GetSuffix() const = 0;
+
+    /**
+     * @return 每次交给CompressBlock的数据大小，最后一块可能更小
+     */
+    virtual size_t GetBlockSize() const = 0;
+
+    /**
+     * 开始压缩一个文件，输出文件头
+     * @param output 追加输出
+     * @return 是否成功
+     */
+    virtual bool Begin(std::string& output) = 0;
+
+    /**
+     * 压缩一块数据
+     * @param data 数据
+     * @param length 数据长度，不超过GetBlockSize()
+     * @param output 追加输出
+     * @return 是否成功
+     */
+    virtual bool CompressBlock(const char* data, size_t length, std::string& output) = 0;
+
+    /**
+     * 结束压缩，输出文件尾
+     * @param output 追加输出
+     * @return 是否成功
+     */
+    virtual bool End(std::string& output) = 0;
+};
+
+// 内置的LZ4压缩，输出标准的LZ4 frame格式，可以用lz4 -d解压
+class Lz4LogCodec : public LogCodec
+{
+  public:
+    Lz4LogCodec();
+
+    const char* GetSuffix() const override { return "lz4"; }
+    size_t GetBlockSize() const override;
+    bool Begin(std::string& output) override;
+    bool CompressBlock(const char* data, size_t length, std::string& output) override;
+    bool End(std::string& output) override;
+
+  private:
+    // 匹配查找的哈希表，记录每个哈希值最近出现的位置
+    std::vector<uint32_t> hash_table_;
+};
+
+// 在低优先级的后台线程中压缩写完的日志文件，压缩完成后删除原文件。
+// 压缩时先写到 原文件名.后缀.tmp，写完并落盘后再改名，中途退出不会留下不完整的压缩文件
+class LogCompressor : public std::enable_shared_from_this<LogCompressor>
+{
+  public:
+    ~LogCompressor();
+
+    /**
+     * @param codec 压缩算法，为nullptr时使用内置的LZ4
+     */
+    static std::shared_ptr<LogCompressor> Create(std::shared_ptr<LogCodec> codec = nullptr);
+
+    /**
+     * 把文件加入压缩队列，不等待压缩完成
+     * @param log_file_name 文件名
+     */
+    void Submit(const std::string& log_file_name);
+
+    /**
+     * 把目录中还没有压缩的.log文件（如上次运行退出时还在队列中的文件）加入压缩队列，
+     * 中断遗留的临时文件在重新压缩时覆盖
+     * @param dir_name 日志文件目录
+     */
+    void SubmitDirectory(const std::string& dir_name);
+
+    /**
+     * 获取交给日志输出后端的切分回调，写完的日志文件会自动加入压缩队列
+     * @return 回调只持有弱引用，压缩器析构后不再压缩
+     */
+    RotateCallback GetRotateCallback();
+
+    /**
+     * 等待队列中的文件都压缩完成
+     */
+    void WaitIdle();
+
+  private:
+    explicit LogCompressor(std::shared_ptr<LogCodec> codec);
+
+    void Run();
+
+    /**
+     * 压缩一个文件
+     * @return 是否压缩成功，失败时保留原文件
+     */
+    bool CompressFile(const std::string& log_file_name);
+
+  private:
+    std::shared_ptr<LogCodec> codec_;
+    // mutex_ 保护队列和状态
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // 等待压缩的文件
+    std::deque<std::string> pending_files_;
+    // 是否正在压缩文件
+    bool busy_;
+    // 析构时通知后台线程放弃剩余的文件并退出
+    bool stopping_;
+    std::thread thread_;
+};
+
+typedef std::shared_ptr<LogCompressor> LogCompressorPtr;
+}  // namespace Nlog
@@ -0,0 +1,386 @@
+#include "LogDeduplicator.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Nlog
+{
+constexpr size_t LogDeduplicator::kSlotCount;
+constexpr size_t LogDeduplicator::kSnippetSize;
+std::atomic<int64_t> LogDeduplicator::window_us_(0);
+std::atomic<uint64_t> LogDeduplicator::suppressed_count_(0);
+std::atomic<bool> LogDeduplicator::has_orphaned_(false);
+
+constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+constexpr uint64_t kHashMultiplier = 0x9E3779B97F4A7C15ULL;
+
+static inline int64_t ToMicroseconds(const struct timeval& tv)
+{
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// 调用点和日志文本的哈希，每次处理8字节
+static uint64_t HashLogMessage(const LogMessage& log_message)
+{
+    uint64_t hash = reinterpret_cast<uintptr_t>(&log_message.GetSite()) * kHashMultiplier;
+    const char* text = log_message.GetLogText();
+    size_t length = log_message.GetLogTextLength();
+    for (; length >= sizeof(uint64_t); text += sizeof(uint64_t), length -= sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, text, sizeof(word));
+        hash = (hash ^ word) * kHashMultiplier;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, text, length);
+    hash = (hash ^ tail ^ log_message.GetLogTextLength()) * kHashMultiplier;
+    return hash ^ (hash >> 32);
+}
+
+// 表项，记录一条日志最近一次输出的窗口和之后被折叠的次数
+struct DedupSlot
+{
+    // 为nullptr表示空表项
+    const LogSite* site = nullptr;
+    uint64_t hash = 0;
+    // 窗口开始时间（us），即最近一次输出的时间
+    int64_t window_start = 0;
+    // 最近一次被折叠的时间
+    struct timeval last_tv = {0, 0};
+    uint32_t suppressed = 0;
+    size_t snippet_length = 0;
+    bool truncated = false;
+    char snippet[LogDeduplicator::kSnippetSize];
+};
+
+// 格式化好的汇总，由其他线程输出（定时汇总、关闭折叠或者线程已经退出）
+struct PendingSummary
+{
+    const LogSite* site;
+    struct timeval tv;
+    long thread_id;
+    uint32_t suppressed;
+    std::string text;
+};
+
+// 已经退出的线程留下的汇总
+static std::mutex g_orphaned_mutex;
+static std::vector<PendingSummary> g_orphaned_summaries;
+
+class ThreadDedupTable;
+// 所有线程的折叠表，定时汇总时遍历
+static std::mutex g_tables_mutex;
+static std::vector<ThreadDedupTable*> g_tables;
+
+// 本线程的折叠表。没有析构函数，线程退出过程中（其他thread_local析构时）仍然可以访问
+struct ThreadDedupState
+{
+    // 线程第一次经过折叠判断时分配，线程退出时释放
+    ThreadDedupTable* table;
+    // 已经开始释放，之后的日志不再折叠
+    bool torn_down;
+    // 正在折叠判断（输出汇总时后端又打印日志），嵌套的日志不再折叠
+    bool filtering;
+};
+
+static thread_local ThreadDedupState t_dedup_state;
+
+// 格式化汇总文本
+static size_t FormatSummary(const DedupSlot& slot, char* text, size_t size)
+{
+    int length = snprintf(text, size, "last message repeated %u times: %.*s%s\n", slot.suppressed,
+                          static_cast<int>(slot.snippet_length), slot.snippet, slot.truncated ? "..." : "");
+    if (length <= 0) return 0;
+    return std::min(static_cast<size_t>(length), size - 1);
+}
+
+// 线程私有的折叠表。所属线程判断时加表锁，只和定时汇总的线程竞争
+class ThreadDedupTable
+{
+  public:
+    explicit ThreadDedupTable(long thread_id) : thread_id_(thread_id) {}
+
+    bool Filter(const LogMessage& log_message, LogDeduplicator::SinkFunc sink_func, int64_t window)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sink_func_ = sink_func;
+        int64_t now = ToMicroseconds(log_message.GetTime());
+        if (now >= next_deadline_.load(std::memory_order_relaxed))
+        {
+            EmitExpired(now, window);
+        }
+
+        uint64_t hash = HashLogMessage(log_message);
+        DedupSlot& slot = slots_[hash & (LogDeduplicator::kSlotCount - 1)];
+        if (slot.site != nullptr && slot.hash == hash && now - slot.window_start < window)
+        {
+            ++slot.suppressed;
+            slot.last_tv = log_message.GetTime();
+            UpdateDeadline(slot.window_start + window);
+            return true;
+        }
+
+        // 窗口已经结束或者表项被其他日志占用，先输出旧日志的汇总
+        Emit(slot);
+        Reset(slot, log_message, hash, now);
+        return false;
+    }
+
+    /**
+     * 其他线程取走窗口已经结束的汇总，所属线程正在判断时不等待
+     * @param now 当前时间（us），为kNoDeadline时取走所有汇总
+     * @return 所属线程正在判断时返回false
+     */
+    bool TryCollectExpired(int64_t now, int64_t window, std::vector<PendingSummary>& summaries)
+    {
+        // 没有窗口结束的汇总时不加锁
+        if (now < next_deadline_.load(std::memory_order_relaxed)) return true;
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (!lock.owns_lock()) return false;
+        CollectExpired(now, window, summaries);
+        return true;
+    }
+
+    /**
+     * 线程退出时取走所有汇总，调用方需要先把表从g_tables中移除
+     */
+    void CollectAll(std::vector<PendingSummary>& summaries)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CollectExpired(kNoDeadline, 0, summaries);
+    }
+
+  private:
+    void UpdateDeadline(int64_t deadline)
+    {
+        if (deadline < next_deadline_.load(std::memory_order_relaxed))
+        {
+            next_deadline_.store(deadline, std::memory_order_relaxed);
+        }
+    }
+
+    void EmitExpired(int64_t now, int64_t window)
+    {
+        int64_t next_deadline = kNoDeadline;
+        for (DedupSlot& slot : slots_)
+        {
+            if (slot.suppressed == 0) continue;
+            if (now - slot.window_start >= window)
+            {
+                Emit(slot);
+            }
+            else if (slot.window_start + window < next_deadline)
+            {
+                next_deadline = slot.window_start + window;
+            }
+        }
+        next_deadline_.store(next_deadline, std::memory_order_relaxed);
+    }
+
+    void CollectExpired(int64_t now, int64_t window, std::vector<PendingSummary>& summaries)
+    {
+        int64_t next_deadline = kNoDeadline;
+        for (DedupSlot& slot : slots_)
+        {
+            if (slot.suppressed == 0) continue;
+            if (now - slot.window_start >= window)
+            {
+                char text[LogDeduplicator::kSnippetSize + 64];
+                size_t text_length = FormatSummary(slot, text, sizeof(text));
+                summaries.push_back(PendingSummary{slot.site, slot.last_tv, thread_id_, slot.suppressed,
+                                                   std::string(text, text_length)});
+                slot.suppressed = 0;
+            }
+            else if (slot.window_start + window < next_deadline)
+            {
+                next_deadline = slot.window_start + window;
+            }
+        }
+        next_deadline_.store(next_deadline, std::memory_order_relaxed);
+    }
+
+    void Emit(DedupSlot& slot)
+    {
+        if (slot.suppressed == 0 || sink_func_ == nullptr) return;
+
+        char text[LogDeduplicator::kSnippetSize + 64];
+        size_t text_length = FormatSummary(slot, text, sizeof(text));
+        if (text_length > 0)
+        {
+            LogMessage summary(*slot.site, slot.last_tv, thread_id_, text, text_length);
+            sink_func_(summary);
+        }
+        LogDeduplicator::suppressed_count_.fetch_add(slot.suppressed, std::memory_order_relaxed);
+        slot.suppressed = 0;
+    }
+
+    static void Reset(DedupSlot& slot, const LogMessage& log_message, uint64_t hash, int64_t now)
+    {
+        slot.site = &log_message.GetSite();
+        slot.hash = hash;
+        slot.window_start = now;
+        slot.suppressed = 0;
+
+        // 汇总中不带原日志的换行
+        size_t length = log_message.GetLogTextLength();
+        if (length > 0 && log_message.GetLogText()[length - 1] == '\n') --length;
+        slot.truncated = length > sizeof(slot.snippet);
+        slot.snippet_length = slot.truncated ? sizeof(slot.snippet) : length;
+        memcpy(slot.snippet, log_message.GetLogText(), slot.snippet_length);
+    }
+
+  private:
+    // 所属线程判断时和其他线程取走汇总时加锁
+    std::mutex mutex_;
+    DedupSlot slots_[LogDeduplicator::kSlotCount];
+    // 最早结束的有折叠日志的窗口，到达前不需要遍历表，其他线程据此跳过没有汇总的表
+    std::atomic<int64_t> next_deadline_{kNoDeadline};
+    LogDeduplicator::SinkFunc sink_func_ = nullptr;
+    const long thread_id_;
+};
+
+// 线程退出时释放折叠表，剩余的汇总交给全局列表。其他thread_local（如日志缓冲区、注册表的hazard槽位）
+// 可能已经析构，不能在这里输出到后端，由之后打印日志的线程、定时汇总或者关闭时输出
+class ThreadDedupTableReleaser
+{
+  public:
+    ~ThreadDedupTableReleaser()
+    {
+        t_dedup_state.torn_down = true;
+        ThreadDedupTable* table = t_dedup_state.table;
+        t_dedup_state.table = nullptr;
+        if (table == nullptr) return;
+        {
+            std::lock_guard<std::mutex> lock(g_tables_mutex);
+            g_tables.erase(std::find(g_tables.begin(), g_tables.end(), table));
+        }
+        std::vector<PendingSummary> summaries;
+        table->CollectAll(summaries);
+        delete table;
+        if (summaries.empty()) return;
+
+        std::lock_guard<std::mutex> lock(g_orphaned_mutex);
+        for (PendingSummary& summary : summaries)
+        {
+            g_orphaned_summaries.push_back(std::move(summary));
+        }
+        LogDeduplicator::has_orphaned_.store(true, std::memory_order_release);
+    }
+};
+
+/**
+ * @return 线程退出过程中释放折叠表之后返回nullptr
+ */
+static ThreadDedupTable* GetThreadDedupTable(long thread_id)
+{
+    if (t_dedup_state.table == nullptr && !t_dedup_state.torn_down)
+    {
+        ThreadDedupTable* table = new ThreadDedupTable(thread_id);
+        {
+            std::lock_guard<std::mutex> lock(g_tables_mutex);
+            g_tables.push_back(table);
+        }
+        t_dedup_state.table = table;
+        static thread_local ThreadDedupTableReleaser releaser;
+        (void)releaser;
+    }
+    return t_dedup_state.table;
+}
+
+/**
+ * 输出其他线程的汇总
+ * @return 汇总中被折叠的日志条数
+ */
+static uint64_t EmitSummaries(const std::vector<PendingSummary>& summaries, LogDeduplicator::SinkFunc sink_func)
+{
+    uint64_t suppressed = 0;
+    for (const PendingSummary& summary : summaries)
+    {
+        LogMessage message(*summary.site, summary.tv, summary.thread_id, summary.text.c_str(), summary.text.size());
+        sink_func(message);
+        suppressed += summary.suppressed;
+    }
+    return suppressed;
+}
+
+void LogDeduplicator::SetWindow(std::chrono::microseconds window)
+{
+    window_us_.store(window.count() > 0 ? window.count() : 0, std::memory_order_relaxed);
+}
+
+bool LogDeduplicator::Filter(const LogMessage& log_message, SinkFunc sink_func)
+{
+    int64_t window = window_us_.load(std::memory_order_relaxed);
+    if (window <= 0) return false;
+    ThreadDedupState& state = t_dedup_state;
+    if (state.filtering) return false;
+    if (has_orphaned_.load(std::memory_order_relaxed))
+    {
+        FlushOrphaned(sink_func);
+    }
+    ThreadDedupTable* table = GetThreadDedupTable(log_message.GetThreadId());
+    if (table == nullptr) return false;
+
+    state.filtering = true;
+    bool suppressed = table->Filter(log_message, sink_func, window);
+    state.filtering = false;
+    return suppressed;
+}
+
+bool LogDeduplicator::SweepTables(int64_t now, int64_t window, SinkFunc sink_func)
+{
+    std::vector<PendingSummary> summaries;
+    bool swept_all = true;
+    {
+        std::lock_guard<std::mutex> lock(g_tables_mutex);
+        for (ThreadDedupTable* table : g_tables)
+        {
+            // 调用线程正在输出自己的汇总时（如后端的回调中关闭折叠）跳过自己的表
+            if (table == t_dedup_state.table && t_dedup_state.filtering) continue;
+            swept_all = table->TryCollectExpired(now, window, summaries) && swept_all;
+        }
+    }
+    suppressed_count_.fetch_add(EmitSummaries(summaries, sink_func), std::memory_order_relaxed);
+    return swept_all;
+}
+
+void LogDeduplicator::EmitExpired(SinkFunc sink_func)
+{
+    int64_t window = window_us_.load(std::memory_order_relaxed);
+    if (window <= 0) return;
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    SweepTables(ToMicroseconds(tv), window, sink_func);
+}
+
+void LogDeduplicator::FlushAll(SinkFunc sink_func)
+{
+    // 正在判断的线程很快会释放表锁，等待时不持有g_tables_mutex，避免和正在创建折叠表的线程互相等待
+    while (!SweepTables(kNoDeadline, 0, sink_func))
+    {
+        std::this_thread::yield();
+    }
+    FlushOrphaned(sink_func);
+}
+
+void LogDeduplicator::FlushOrphaned(SinkFunc sink_func)
+{
+    std::vector<PendingSummary> summaries;
+    {
+        std::lock_guard<std::mutex> lock(g_orphaned_mutex);
+        if (!has_orphaned_.load(std::memory_order_relaxed)) return;
+        summaries.swap(g_orphaned_summaries);
+        has_orphaned_.store(false, std::memory_order_relaxed);
+    }
+    suppressed_count_.fetch_add(EmitSummaries(summaries, sink_func), std::memory_order_relaxed);
+}
+}  // namespace Nlog
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "LogMessage.h"
+
+namespace Nlog
+{
+// 重复日志折叠：同一调用点、文本相同的日志在窗口时间内只输出第一条，其余的丢弃，
+// 窗口结束后输出一条"last message repeated N times"的汇总。
+// 每个线程有自己固定大小的直接映射表，判断时只加本线程的表锁（只和定时汇总竞争），内存占用有上限。
+// 汇总在该线程之后打印任意日志时（窗口已经结束）、表项被其他日志替换时输出，
+// 线程之后不再打印日志时由EmitExpired()定时输出。
+// 线程退出时剩余的汇总交给全局列表，由之后任意线程打印日志、定时汇总或者关闭时输出
+class LogDeduplicator
+{
+  public:
+    // 每个线程的表项个数，为2的幂
+    static constexpr size_t kSlotCount = 64;
+    // 汇总中保留的原日志文本长度
+    static constexpr size_t kSnippetSize = 128;
+
+    typedef void (*SinkFunc)(const LogMessage&);
+
+    /**
+     * 设置折叠窗口
+     * @param window 窗口时长，为0时关闭
+     */
+    static void SetWindow(std::chrono::microseconds window);
+
+    /**
+     * @return 是否开启了重复日志折叠
+     */
+    static bool IsEnabled() { return window_us_.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * 判断日志是否是窗口内的重复日志，需要输出汇总时先通过sink_func输出
+     * @param log_message 日志消息
+     * @param sink_func 输出日志的方法，也用它输出已经退出的线程留下的汇总
+     * @return true表示日志被折叠，不需要输出
+     */
+    static bool Filter(const LogMessage& log_message, SinkFunc sink_func);
+
+    /**
+     * 输出所有线程窗口已经结束的汇总，由后台线程定时调用。所属线程正在判断的表跳过，下次再输出
+     * @param sink_func 输出日志的方法
+     */
+    static void EmitExpired(SinkFunc sink_func);
+
+    /**
+     * 输出所有线程还没有输出的汇总（不管窗口是否结束），一般在关闭折叠或者关闭前调用
+     * @param sink_func 输出日志的方法
+     */
+    static void FlushAll(SinkFunc sink_func);
+
+    /**
+     * 输出已经退出的线程留下的汇总，一般在关闭前调用
+     * @param sink_func 输出日志的方法
+     */
+    static void FlushOrphaned(SinkFunc sink_func);
+
+    /**
+     * @return 已经输出汇总的被折叠的日志条数
+     */
+    static uint64_t GetSuppressedCount() { return suppressed_count_.load(std::memory_order_relaxed); }
+
+  private:
+    friend class ThreadDedupTable;
+    friend class ThreadDedupTableReleaser;
+
+    /**
+     * 取走所有线程窗口已经结束的汇总并输出
+     * @param now 当前时间（us），为最大值时输出所有汇总
+     * @return 有线程正在判断而没有取走时返回false
+     */
+    static bool SweepTables(int64_t now, int64_t window, SinkFunc sink_func);
+
+    // 折叠窗口（us），为0表示关闭
+    static std::atomic<int64_t> window_us_;
+    // 被折叠的日志条数，输出汇总时累加，不在每条日志上写共享变量
+    static std::atomic<uint64_t> suppressed_count_;
+    // 全局列表中是否有已经退出的线程留下的汇总
+    static std::atomic<bool> has_orphaned_;
+};
+}  // namespace Nlog
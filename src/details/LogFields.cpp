@@ -0,0 +1,148 @@
+#include "LogFields.h"
+
+#include <ios>
+
+namespace Nlog
+{
+bool LogFieldEncoder::AddKey(LogFieldType type, const char* key, size_t value_size)
+{
+    size_t key_length = strlen(key);
+    if (key_length > kMaxKeyLength) key_length = kMaxKeyLength;
+    if (size_ + 2 + key_length + value_size > kMaxFieldsSize) return false;
+
+    buffer_[size_++] = static_cast<char>(type);
+    buffer_[size_++] = static_cast<char>(key_length);
+    memcpy(buffer_ + size_, key, key_length);
+    size_ += key_length;
+    return true;
+}
+
+void LogFieldEncoder::AddString(const char* key, const char* value, size_t length)
+{
+    constexpr size_t kLengthSize = sizeof(uint16_t);
+    size_t key_length = strlen(key);
+    if (key_length > kMaxKeyLength) key_length = kMaxKeyLength;
+    size_t used = size_ + 2 + key_length + kLengthSize;
+    if (used > kMaxFieldsSize) return;
+    // 剩余空间不足时截断字符串值
+    if (length > kMaxFieldsSize - used) length = kMaxFieldsSize - used;
+
+    AddKey(LogFieldType::kString, key, kLengthSize + length);
+    uint16_t string_length = static_cast<uint16_t>(length);
+    memcpy(buffer_ + size_, &string_length, kLengthSize);
+    memcpy(buffer_ + size_ + kLengthSize, value, length);
+    size_ += kLengthSize + length;
+}
+
+bool LogFieldReader::Next(LogField& field)
+{
+    if (end_ - cur_ < 2) return false;
+    field.type = static_cast<LogFieldType>(cur_[0]);
+    field.key_length = static_cast<unsigned char>(cur_[1]);
+    field.key = cur_ + 2;
+    const char* value = field.key + field.key_length;
+    if (value > end_) return false;
+
+    size_t value_size = 0;
+    switch (field.type)
+    {
+        case LogFieldType::kInt:
+        case LogFieldType::kUint:
+        case LogFieldType::kDouble:
+            value_size = sizeof(uint64_t);
+            if (end_ - value < static_cast<ptrdiff_t>(value_size)) return false;
+            // 三种类型都是8字节，拷贝到union的任意成员即可
+            memcpy(&field.uint_value, value, value_size);
+            break;
+        case LogFieldType::kBool:
+            value_size = 1;
+            if (end_ - value < 1) return false;
+            field.bool_value = *value != 0;
+            break;
+        case LogFieldType::kString:
+        {
+            uint16_t string_length;
+            if (end_ - value < static_cast<ptrdiff_t>(sizeof(string_length))) return false;
+            memcpy(&string_length, value, sizeof(string_length));
+            value_size = sizeof(string_length) + string_length;
+            if (end_ - value < static_cast<ptrdiff_t>(value_size)) return false;
+            field.string_value = value + sizeof(string_length);
+            field.string_length = string_length;
+            break;
+        }
+        default:
+            return false;
+    }
+    cur_ = value + value_size;
+    return true;
+}
+
+// 判断字符串值在key=value文本中是否需要加引号
+static bool NeedQuote(const char* value, size_t length)
+{
+    if (length == 0) return true;
+    for (size_t i = 0; i < length; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c <= ' ' || c == '"' || c == '=' || c == '\\') return true;
+    }
+    return false;
+}
+
+static void RenderQuoted(const char* value, size_t length, LogStream& stream)
+{
+    stream.Append('"');
+    size_t begin = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        char escape;
+        switch (value[i])
+        {
+            case '"': escape = '"'; break;
+            case '\\': escape = '\\'; break;
+            case '\n': escape = 'n'; break;
+            case '\r': escape = 'r'; break;
+            case '\t': escape = 't'; break;
+            default: continue;
+        }
+        stream.Append(value + begin, i - begin);
+        stream.Append('\\');
+        stream.Append(escape);
+        begin = i + 1;
+    }
+    stream.Append(value + begin, length - begin);
+    stream.Append('"');
+}
+
+void RenderLogFields(const char* data, size_t size, LogStream& stream)
+{
+    // 字段的格式不受日志文本中设置的进制、浮点格式影响
+    stream << std::dec << std::noshowpos << std::defaultfloat;
+
+    LogFieldReader reader(data, size);
+    LogField field;
+    while (reader.Next(field))
+    {
+        stream.Append(' ');
+        stream.Append(field.key, field.key_length);
+        stream.Append('=');
+        switch (field.type)
+        {
+            case LogFieldType::kInt: stream << static_cast<long long>(field.int_value); break;
+            case LogFieldType::kUint: stream << static_cast<unsigned long long>(field.uint_value); break;
+            case LogFieldType::kDouble: stream << field.double_value; break;
+            case LogFieldType::kBool: stream << (field.bool_value ? "true" : "false"); break;
+            case LogFieldType::kString:
+                if (NeedQuote(field.string_value, field.string_length))
+                {
+                    RenderQuoted(field.string_value, field.string_length, stream);
+                }
+                else
+                {
+                    stream.Append(field.string_value, field.string_length);
+                }
+                break;
+        }
+    }
+}
+}  // namespace Nlog
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cstddef>
+
+#include "LogStream.h"
+
+namespace Nlog
+{
+// 结构化字段的值类型
+enum class LogFieldType : uint8_t
+{
+    kInt,
+    kUint,
+    kDouble,
+    kBool,
+    kString,
+};
+
+// 解码出的一个结构化字段，key和字符串值指向编码缓冲区，不以'\0'结尾
+struct LogField
+{
+    LogFieldType type;
+    const char* key;
+    size_t key_length;
+    union
+    {
+        int64_t int_value;
+        uint64_t uint_value;
+        double double_value;
+        bool bool_value;
+    };
+    const char* string_value;
+    size_t string_length;
+};
+
+// 结构化字段的紧凑编码，保存在LogMessage的线程级缓冲区中，异步模式下整段拷贝进队列。
+// 每个字段编码为：类型(1字节) + key长度(1字节) + key + 值，
+// 数值类型的值为8字节（bool为1字节），字符串的值为长度(2字节) + 内容
+class LogFieldEncoder
+{
+  public:
+    enum
+    {
+        // 单条日志所有字段编码后的最大长度，超出的字段被丢弃
+        kMaxFieldsSize = 512,
+        // key的最大长度，超出时截断
+        kMaxKeyLength = 255,
+    };
+
+    /**
+     * @param buffer 编码缓冲区，由调用方管理，大小至少为kMaxFieldsSize
+     */
+    explicit LogFieldEncoder(char* buffer) : buffer_(buffer), size_(0) {}
+
+    LogFieldEncoder(const LogFieldEncoder&) = delete;
+    LogFieldEncoder& operator=(const LogFieldEncoder&) = delete;
+
+    void AddInt(const char* key, int64_t value) { AddFixed(LogFieldType::kInt, key, &value, sizeof(value)); }
+    void AddUint(const char* key, uint64_t value) { AddFixed(LogFieldType::kUint, key, &value, sizeof(value)); }
+    void AddDouble(const char* key, double value) { AddFixed(LogFieldType::kDouble, key, &value, sizeof(value)); }
+    void AddBool(const char* key, bool value)
+    {
+        char byte = value ? 1 : 0;
+        AddFixed(LogFieldType::kBool, key, &byte, 1);
+    }
+    /**
+     * 添加字符串字段，放不下时截断字符串，连key都放不下时丢弃
+     */
+    void AddString(const char* key, const char* value, size_t length);
+
+    const char* GetData() const { return buffer_; }
+    size_t GetSize() const { return size_; }
+
+  private:
+    /**
+     * 写入类型和key
+     * @param value_size 值需要的空间
+     * @return 放不下时返回false
+     */
+    bool AddKey(LogFieldType type, const char* key, size_t value_size);
+
+    void AddFixed(LogFieldType type, const char* key, const void* value, size_t value_size)
+    {
+        if (!AddKey(type, key, value_size)) return;
+        memcpy(buffer_ + size_, value, value_size);
+        size_ += value_size;
+    }
+
+  private:
+    char* const buffer_;
+    size_t size_;
+};
+
+// 顺序解码LogFieldEncoder编码的字段
+class LogFieldReader
+{
+  public:
+    LogFieldReader(const char* data, size_t size) : cur_(data), end_(data + size) {}
+
+    /**
+     * 解码下一个字段
+     * @param field 输出的字段
+     * @return 没有更多字段（或者编码不完整）时返回false
+     */
+    bool Next(LogField& field);
+
+  private:
+    const char* cur_;
+    const char* end_;
+};
+
+/**
+ * 把字段按" key=value"的文本格式追加到日志流，字符串值包含空格、引号、'='或者控制字符时加引号并转义
+ * @param data 编码后的字段
+ * @param size 编码长度
+ * @param stream 日志流
+ */
+void RenderLogFields(const char* data, size_t size, LogStream& stream);
+}  // namespace Nlog
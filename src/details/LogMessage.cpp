@@ -4,178 +4,324 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <ctime>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
-#include <string.h>
+
+#include "HeaderPattern.h"
+#include "LogStats.h"
 
 namespace Nlog
 {
-LogStreamBuf::LogStreamBuf()
+// 单条日志文本的最大长度，超过的部分被截断
+static std::atomic<size_t> g_max_text_size(LogStream::kDefaultMaxSize);
+
+// 每个线程复用的日志文本缓冲区。支持有限层数的嵌套（例如在operator<<中又打印日志），
+// 层数超出时才在堆上分配。
+// 日志文本先写到行内缓冲区，写满后换到按大小分级的扩容缓冲区，较小的几级每个线程各缓存一个
+class ThreadLogBuffers
 {
-    // kBufferSize 至少要大于等于2, 保证有足够的空间预留给后续添加'\n'和'\0'
-    static_assert(kBufferSize > 0, "kBufferSize must be large than 2");
-    setp(buffer, buffer + kBufferSize);
+  public:
+    enum
+    {
+        kMaxBuffers = 4,
+        kFieldsOffset = LogStream::kInlineSize + LogStream::kReservedSize,
+        // 日志文本之后是结构化字段的编码区域
+        kRecordSize = kFieldsOffset + LogFieldEncoder::kMaxFieldsSize,
+        // 扩容缓冲区的级数，容量从4KB开始每级乘4，最后一级为kMaxSizeLimit
+        kSpillClasses = 5,
+        // 线程缓存的扩容缓冲区级数（4KB、16KB、64KB），更大的每次在堆上分配，避免线程长期占用大块内存
+        kPooledSpillClasses = 3
+    };
+
+    ThreadLogBuffers() = default;
+    ~ThreadLogBuffers()
+    {
+        for (char* buffer : spill_buffers_)
+        {
+            delete[] buffer;
+        }
+    }
+
+    ThreadLogBuffers(const ThreadLogBuffers&) = delete;
+    ThreadLogBuffers& operator=(const ThreadLogBuffers&) = delete;
 
+    /**
+     * 获取扩容缓冲区的容量（不包括预留空间）
+     * @param size_class 0 ~ kSpillClasses - 1
+     */
+    static size_t GetSpillCapacity(unsigned size_class) { return size_t(4096) << (2 * size_class); }
+
+    char* Acquire()
+    {
+        for (unsigned i = 0; i < kMaxBuffers; ++i)
+        {
+            if (!(in_use_ & (1u << i)))
+            {
+                in_use_ |= 1u << i;
+                return buffers_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool Release(char* buffer)
+    {
+        if (buffer < buffers_[0] || buffer >= buffers_[0] + sizeof(buffers_)) return false;
+        in_use_ &= ~(1u << ((buffer - buffers_[0]) / kRecordSize));
+        return true;
+    }
+
+    /**
+     * 获取线程缓存的扩容缓冲区
+     * @param size_class 扩容缓冲区的级别
+     * @return 该级不缓存或者缓存的缓冲区正在使用时返回nullptr
+     */
+    char* AcquireSpill(unsigned size_class)
+    {
+        if (size_class >= kPooledSpillClasses || (spill_in_use_ & (1u << size_class))) return nullptr;
+        if (spill_buffers_[size_class] == nullptr)
+        {
+            // 第一次用到这一级时分配，之后一直复用
+            spill_buffers_[size_class] = new char[GetSpillCapacity(size_class) + LogStream::kReservedSize];
+        }
+        spill_in_use_ |= 1u << size_class;
+        return spill_buffers_[size_class];
+    }
+
+    bool ReleaseSpill(char* buffer, unsigned size_class)
+    {
+        if (size_class >= kPooledSpillClasses || buffer != spill_buffers_[size_class]) return false;
+        spill_in_use_ &= ~(1u << size_class);
+        return true;
+    }
+
+    // 没有正在使用的缓冲区
+    bool IsIdle() const { return in_use_ == 0 && spill_in_use_ == 0; }
+
+  private:
+    unsigned in_use_ = 0;
+    char buffers_[kMaxBuffers][kRecordSize];
+    unsigned spill_in_use_ = 0;
+    char* spill_buffers_[kPooledSpillClasses] = {};
+};
+
+// 本线程的缓冲区。没有析构函数，线程退出过程中（其他thread_local析构时）仍然可以访问
+struct ThreadLogBuffersState
+{
+    // 线程第一次打印日志时分配，之后一直复用，线程退出时释放
+    ThreadLogBuffers* buffers;
+    // 已经开始释放，之后打印的日志每次在堆上分配缓冲区
+    bool torn_down;
+};
+
+static thread_local ThreadLogBuffersState t_log_buffers;
+
+// 线程退出时释放缓冲区。还有缓冲区在使用时不释放，由使用方归还到堆上（不会发生，只是保证安全）
+class ThreadLogBuffersReleaser
+{
+  public:
+    ~ThreadLogBuffersReleaser()
+    {
+        t_log_buffers.torn_down = true;
+        if (t_log_buffers.buffers != nullptr && t_log_buffers.buffers->IsIdle())
+        {
+            delete t_log_buffers.buffers;
+            t_log_buffers.buffers = nullptr;
+        }
+    }
+};
+
+/**
+ * @return 线程退出过程中释放缓冲区之后返回nullptr
+ */
+static ThreadLogBuffers* GetThreadLogBuffers()
+{
+    if (t_log_buffers.buffers == nullptr && !t_log_buffers.torn_down)
+    {
+        t_log_buffers.buffers = new ThreadLogBuffers;
+        static thread_local ThreadLogBuffersReleaser releaser;
+        (void)releaser;
+    }
+    return t_log_buffers.buffers;
+}
+
+static char* AcquireLogBuffer()
+{
+    ThreadLogBuffers* buffers = GetThreadLogBuffers();
+    char* buffer = buffers != nullptr ? buffers->Acquire() : nullptr;
+    if (buffer == nullptr)
+    {
+        buffer = new char[ThreadLogBuffers::kRecordSize];
+    }
     buffer[0] = '\0';
+    return buffer;
 }
 
-// 实现std::streambuf的overflow接口，当数据写入并且缓冲区已满时会被调用
-LogStreamBuf::int_type LogStreamBuf::overflow(int_type ch)
+static void ReleaseLogBuffer(char* buffer)
 {
-    // 丢弃溢出的字符
-    return ch;
+    if (buffer == nullptr) return;
+    ThreadLogBuffers* buffers = t_log_buffers.buffers;
+    if (buffers == nullptr || !buffers->Release(buffer))
+    {
+        delete[] buffer;
+    }
 }
 
-// 获取缓冲区
-const char* LogStreamBuf::GetBuffer() const { return buffer; }
+static char* AcquireSpillBuffer(unsigned size_class)
+{
+    ThreadLogBuffers* buffers = GetThreadLogBuffers();
+    char* buffer = buffers != nullptr ? buffers->AcquireSpill(size_class) : nullptr;
+    if (buffer == nullptr)
+    {
+        buffer = new char[ThreadLogBuffers::GetSpillCapacity(size_class) + LogStream::kReservedSize];
+    }
+    return buffer;
+}
 
-// 获取buffer的已用空间大小
-size_t LogStreamBuf::GetCount() const { return pptr() - pbase(); }
+static void ReleaseSpillBuffer(char* buffer, unsigned size_class)
+{
+    if (buffer == nullptr) return;
+    ThreadLogBuffers* buffers = t_log_buffers.buffers;
+    if (buffers == nullptr || !buffers->ReleaseSpill(buffer, size_class))
+    {
+        delete[] buffer;
+    }
+}
 
-// 获取buffer的最后一个字符
-// 如果buffer为空，返回EOF;否则返回最后一个字符
-char LogStreamBuf::GetBackChar() const
+// 行内缓冲区的容量，最大长度设得更小时以最大长度为准
+static inline size_t GetInlineCapacity()
 {
-    if (GetCount() == 0) return EOF;
-    return *(pptr() - 1);
+    size_t max_size = g_max_text_size.load(std::memory_order_relaxed);
+    return max_size < LogStream::kInlineSize ? max_size : LogStream::kInlineSize;
 }
 
-LogMessage::LogMessage(LogSeverity msg_severity, const char* const file, const char* const func, int line,
-                       const LogFunc& log_func)
-    : msg_severity_(msg_severity),
-      file_(file),
-      func_(func),
-      line_(line),
+static inline long GetCurrentThreadId()
+{
+    // 使用tls确保每个线程只会执行一次syscall获取线程ID
+    static thread_local long thread_id = syscall(__NR_gettid);
+    return thread_id;
+}
+
+LogMessage::LogMessage(const LogSite& site, LogFunc log_func)
+    : site_(&site),
+      thread_id_(GetCurrentThreadId()),
       log_func_(log_func),
       flushed_(false),
-      stream_buf_(),
-      stream_(&stream_buf_),
-      nums_to_log_(0)
+      buffer_(AcquireLogBuffer()),
+      spill_buffer_(nullptr),
+      spill_class_(0),
+      stream_(buffer_, GetInlineCapacity(), &LogMessage::GrowBuffer, this),
+      nums_to_log_(0),
+      text_(buffer_),
+      field_encoder_(buffer_ + ThreadLogBuffers::kFieldsOffset),
+      fields_(nullptr),
+      fields_size_(0),
+      message_length_(0)
 {
     if (gettimeofday(&tv_, nullptr) != 0)
     {
         time(&tv_.tv_sec);
         tv_.tv_usec = 0;
     }
-    // todo
-    stream_ << std::fixed;
 }
 
-LogMessage::~LogMessage() { Flush(); }
+LogMessage::LogMessage(const LogSite& site, const struct timeval& tv, long thread_id, const char* text,
+                       size_t text_length, const char* fields, size_t fields_size, size_t message_length)
+    : site_(&site),
+      tv_(tv),
+      thread_id_(thread_id),
+      log_func_(nullptr),
+      flushed_(true),
+      buffer_(nullptr),
+      spill_buffer_(nullptr),
+      spill_class_(0),
+      stream_(nullptr, 0),
+      nums_to_log_(text_length),
+      text_(text),
+      field_encoder_(nullptr),
+      fields_(fields),
+      fields_size_(fields_size),
+      message_length_(message_length)
+{
+    if (fields_size_ == 0)
+    {
+        message_length_ = text_length > 0 && text[text_length - 1] == '\n' ? text_length - 1 : text_length;
+    }
+}
 
-static inline const char* GetFileName(const char* path)
+LogMessage::~LogMessage()
 {
-    const char* file = strrchr(path, '/');
-    if (file) return file + 1;
-    return path;
+    Flush();
+    ReleaseSpillBuffer(spill_buffer_, spill_class_);
+    ReleaseLogBuffer(buffer_);
 }
 
-inline long GetThreadId()
+void LogMessage::SetMaxTextSize(size_t max_size)
 {
-    // 使用tls确保每个线程只会执行一次syscall获取线程ID
-    static thread_local long thread_id = syscall(__NR_gettid);
-    return thread_id;
+    if (max_size < kMinTextSize) max_size = kMinTextSize;
+    if (max_size > LogStream::kMaxSizeLimit) max_size = LogStream::kMaxSizeLimit;
+    g_max_text_size.store(max_size, std::memory_order_relaxed);
 }
 
-std::string LogMessage::GetLogHeader(const std::string& pattern) const
+size_t LogMessage::GetMaxTextSize()
+{
+    return g_max_text_size.load(std::memory_order_relaxed);
+}
+
+char* LogMessage::GrowBuffer(void* context, const char* buffer, size_t count, size_t required, size_t& capacity)
 {
-    size_t sz = pattern.size();
-    if (sz == 0)
+    LogMessage* self = static_cast<LogMessage*>(context);
+    size_t max_size = g_max_text_size.load(std::memory_order_relaxed);
+    if (capacity >= max_size) return nullptr;
+    if (required > max_size) required = max_size;
+
+    unsigned size_class = 0;
+    while (size_class + 1 < ThreadLogBuffers::kSpillClasses &&
+           ThreadLogBuffers::GetSpillCapacity(size_class) < required)
     {
-        return std::string();
+        ++size_class;
     }
+    char* new_buffer = AcquireSpillBuffer(size_class);
+    memcpy(new_buffer, buffer, count);
+    ReleaseSpillBuffer(self->spill_buffer_, self->spill_class_);
+    self->spill_buffer_ = new_buffer;
+    self->spill_class_ = size_class;
 
-    thread_local struct tm result = {};
-    (void)localtime_r(&tv_.tv_sec, &result);
+    size_t new_capacity = ThreadLogBuffers::GetSpillCapacity(size_class);
+    capacity = new_capacity < max_size ? new_capacity : max_size;
+    return new_buffer;
+}
 
-    std::stringstream ss;
-    for (size_t i = 0; i < sz; ++i)
+std::string LogMessage::GetLogHeader(const std::string& pattern) const
+{
+    if (pattern.empty())
     {
-        if (pattern[i] == '%')
-        {
-            ++i;
-            if (i < sz)
-            {
-                const char& c = pattern[i];
-                if (c == 'Y')
-                {
-                    ss << std::setw(4) << 1900 + result.tm_year;
-                }
-                else if (c == 'M')
-                {
-                    ss << std::setw(2) << std::setfill('0') << 1 + result.tm_mon;
-                }
-                else if (c == 'D')
-                {
-                    ss << std::setw(2) << std::setfill('0') << result.tm_mday;
-                }
-                else if (c == 'h')
-                {
-                    ss << std::setw(2) << std::setfill('0') << result.tm_hour;
-                }
-                else if (c == 'm')
-                {
-                    ss << std::setw(2) << std::setfill('0') << result.tm_min;
-                }
-                else if (c == 's')
-                {
-                    ss << std::setw(2) << std::setfill('0') << result.tm_sec;
-                }
-                else if (c == 'i')
-                {
-                    ss << std::setw(3) << std::setfill('0') << tv_.tv_usec / 1000;
-                }
-                else if (c == 'V')
-                {
-                    ss << std::setw(5) << std::setfill(' ') << GetLogSeverityName(msg_severity_);
-                }
-                else if (c == 'v')
-                {
-                    ss << GetLogSeverityAbbName(msg_severity_);
-                }
-                else if (c == 'T')
-                {
-                    ss << GetThreadId();
-                }
-                else if (c == 'F')
-                {
-                    ss << GetFileName(file_);
-                }
-                else if (c == 'L')
-                {
-                    ss << line_;
-                }
-                else if (c == 'U')
-                {
-                    ss << func_;
-                }
-            }
-        }
-        else
-        {
-            ss << pattern[i];
-        }
+        return std::string();
     }
 
-    return ss.str();
+    char header[HeaderPattern::kMaxHeaderSize];
+    size_t header_length = HeaderPattern(pattern).Format(*this, header, sizeof(header));
+    return std::string(header, header_length);
 }
 
 void LogMessage::Flush()
 {
     if (flushed_) return;
 
-    nums_to_log_ = stream_buf_.GetCount();
-    if (nums_to_log_ == 0) return;
-
-    if (stream_buf_.GetBackChar() != '\n')
+    message_length_ = stream_.GetCount();
+    if (field_encoder_.GetSize() > 0)
     {
-        // 已经保证stream_buf_至少还有两个字符的可用空间
-        stream_buf_.buffer[nums_to_log_++] = '\n';
+        fields_ = field_encoder_.GetData();
+        fields_size_ = field_encoder_.GetSize();
+        RenderLogFields(fields_, fields_size_, stream_);
     }
-    // 确保buffer是一个C风格的字符串，对于某些输出流来说会比较方便使用
-    stream_buf_.buffer[nums_to_log_] = '\0';
+    if (stream_.GetTruncatedBytes() > 0) g_pipeline_counters.truncated.Add();
+    nums_to_log_ = stream_.Finish();
+    // 扩容后文本不在buffer_中
+    text_ = stream_.GetBuffer();
+    if (nums_to_log_ == 0) return;
+
+    g_pipeline_counters.messages[site_->severity].Add();
 
     log_func_(*this);
 
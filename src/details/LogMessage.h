@@ -1,69 +1,47 @@
 #pragma once
 
-#include <functional>
-#include <ostream>
+#include <sys/time.h>
+
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "IterableContainer.h"
+#include "LogFields.h"
 #include "LogSeverity.h"
+#include "LogSite.h"
+#include "LogStream.h"
 
 namespace Nlog
 {
-// 日志流缓冲区
-class LogStreamBuf : public std::streambuf
+// 日志消息
+class LogMessage
 {
   public:
-    enum
-    {
-        kBufferSize = 4096
-    };
-    friend class LogMessage;
-
-    LogStreamBuf();
-    ~LogStreamBuf() override = default;
-
-    // noncopyable
-    LogStreamBuf(const LogStreamBuf&) = delete;
-    LogStreamBuf& operator=(const LogStreamBuf&) = delete;
-
-  protected:
-    // 实现std::streambuf的overflow接口，当数据写入并且缓冲区已满时会被调用
-    int_type overflow(int_type ch) override;
-
-  public:
-    /**
-     * 获取缓存区
-     * @return 缓冲区起始地址
-     */
-    const char* GetBuffer() const;
+    // 日志输出方法，使用普通函数指针，避免std::function的拷贝和可能的堆内存分配
+    typedef void (*LogFunc)(const LogMessage&);
 
     /**
-     * 获取buffer的已用空间大小
-     * @return buffer的已用空间大小
+     * @param site 调用点，生命周期需要覆盖本对象，一般为NLOG_LOG_SITE定义的静态对象
+     * @param log_func 日志输出方法
      */
-    size_t GetCount() const;
-
+    LogMessage(const LogSite& site, LogFunc log_func);
     /**
-     * 获取缓冲区最后一个字符
-     * @return 如果缓冲区非空，返回最后一个字符;否则返回EOF
+     * 用已经格式化好的日志文本构造日志消息（异步模式下后台线程回放日志使用），析构时不会再次输出
+     * @param text 以'\0'结尾的日志文本，生命周期需要覆盖本对象
+     * @param text_length 日志文本长度
+     * @param fields 编码后的结构化字段，生命周期需要覆盖本对象
+     * @param fields_size 字段编码长度
+     * @param message_length 文本中渲染字段之前的部分的长度，没有字段时忽略
      */
-    char GetBackChar() const;
-
-  private:
-    // 固定大小缓冲区（预留2个字符）
-    char buffer[kBufferSize + 2 + 1];
-};
-
-// 日志消息
-class LogMessage
-{
-  public:
-    typedef std::function<void(const LogMessage&)> LogFunc;
-
-    LogMessage(LogSeverity msg_severity, const char* file, const char* func, int line, const LogFunc& log_func);
+    LogMessage(const LogSite& site, const struct timeval& tv, long thread_id, const char* text, size_t text_length,
+               const char* fields = nullptr, size_t fields_size = 0, size_t message_length = 0);
     ~LogMessage();
 
+    // noncopyable
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
 // 基础数据类型
 #define BASIC_SIMPLE_LOG(BASIC_TYPE)                \
     inline LogMessage& operator<<(BASIC_TYPE msg)   \
@@ -80,6 +58,8 @@ class LogMessage
     BASIC_SIMPLE_LOG(unsigned int)
     BASIC_SIMPLE_LOG(signed long)
     BASIC_SIMPLE_LOG(unsigned long)
+    BASIC_SIMPLE_LOG(signed long long)
+    BASIC_SIMPLE_LOG(unsigned long long)
     BASIC_SIMPLE_LOG(float)
     BASIC_SIMPLE_LOG(double)
     BASIC_SIMPLE_LOG(char*)
@@ -89,143 +69,277 @@ class LogMessage
 
     inline LogMessage& operator<<(const std::string& msg) { stream_ << msg; return *this; }
     inline LogMessage& operator<<(std::ostream& (*ostream_fp)(std::ostream&)) { stream_ << ostream_fp; return *this; }
-    inline LogMessage& operator<<(const std::ios_base& (*ios_base_fp)(std::ios_base&)) { stream_ << ios_base_fp; return *this; }
+    inline LogMessage& operator<<(std::ios_base& (*ios_base_fp)(std::ios_base&)) { stream_ << ios_base_fp; return *this; }
 
-    template<typename Iterator>
-    inline LogMessage& WriteIterator(Iterator it_begin, Iterator it_end, std::size_t sz)
+    /**
+     * 输出[begin, end)范围内的元素，形如"[1,2,3,...]"
+     * @param format 最多输出的元素个数和分隔符
+     */
+    template <typename Iterator>
+    inline LogMessage& WriteIterator(Iterator it_begin, Iterator it_end, const ContainerFormat& format)
     {
-        stream_ << "[";
-        // todo:长度，间隔符
-        for(std::size_t i = 0; it_begin != it_end && i < 3; ++i, ++it_begin)
+        size_t separator_length = strlen(format.separator);
+        stream_.Append('[');
+        for (size_t i = 0; it_begin != it_end && i < format.max_elements; ++i, ++it_begin)
         {
+            if (i > 0) stream_.Append(format.separator, separator_length);
             operator<<(*it_begin);
-            stream_ << ((i < sz - 1) ? "," : "");
         }
-        if(it_begin != it_end)
+        if (it_begin != it_end)
         {
-            stream_ << "...";
+            if (format.max_elements > 0) stream_.Append(format.separator, separator_length);
+            stream_.Append("...", 3);
         }
-        stream_ << "]";
+        stream_.Append(']');
 
         return *this;
     }
 
-// STL容器类型
-#define ITERATOR_CONTAINER_LOG_ONE_ARG(CONTAINER_TYPE)                              \
-    template <typename T>                                                           \
-    inline LogMessage& operator<<(const CONTAINER_TYPE<T>& container)               \
-    {                                                                               \
-        return WriteIterator(container.begin(), container.end(), container.size()); \
+    // 按格式输出容器，容器适配器直接遍历底层容器，不拷贝
+    template <typename Container>
+    inline LogMessage& WriteContainer(const Container& container, const ContainerFormat& format)
+    {
+        return WriteIterator(container.begin(), container.end(), format);
     }
+
+    // queue从队首到队尾输出
+    template <typename T, typename Container>
+    inline LogMessage& WriteContainer(const std::queue<T, Container>& q, const ContainerFormat& format)
+    {
+        const Container& c = AdaptorAccess<std::queue<T, Container>>::GetContainer(q);
+        return WriteIterator(c.begin(), c.end(), format);
+    }
+
+    // stack从栈顶到栈底输出
+    template <typename T, typename Container>
+    inline LogMessage& WriteContainer(const std::stack<T, Container>& s, const ContainerFormat& format)
+    {
+        const Container& c = AdaptorAccess<std::stack<T, Container>>::GetContainer(s);
+        return WriteIterator(c.rbegin(), c.rend(), format);
+    }
+
+    // priority_queue按堆数组的顺序输出，第一个元素是堆顶，之后的元素不保证有序
+    template <typename T, typename Container, typename Compare>
+    inline LogMessage& WriteContainer(const std::priority_queue<T, Container, Compare>& q,
+                                      const ContainerFormat& format)
+    {
+        const Container& c = AdaptorAccess<std::priority_queue<T, Container, Compare>>::GetContainer(q);
+        return WriteIterator(c.begin(), c.end(), format);
+    }
+
+    // 按LogContainer()指定的格式输出
+    template <typename Container>
+    inline LogMessage& operator<<(const ContainerFormatter<Container>& formatter)
+    {
+        return WriteContainer(formatter.container, formatter.format);
+    }
+
+// STL容器类型，按默认格式输出
 #define ITERATOR_CONTAINER_LOG_TWO_ARG(CONTAINER_TYPE)                              \
     template <typename T1, typename T2>                                             \
     inline LogMessage& operator<<(const CONTAINER_TYPE<T1, T2>& container)          \
     {                                                                               \
-        return WriteIterator(container.begin(), container.end(), container.size()); \
+        return WriteContainer(container, GetDefaultContainerFormat());              \
     }
 #define ITERATOR_CONTAINER_LOG_THREE_ARG(CONTAINER_TYPE)                            \
     template <typename T1, typename T2, typename T3>                                \
     inline LogMessage& operator<<(const CONTAINER_TYPE<T1, T2, T3>& container)      \
     {                                                                               \
-        return WriteIterator(container.begin(), container.end(), container.size()); \
+        return WriteContainer(container, GetDefaultContainerFormat());              \
     }
 #define ITERATOR_CONTAINER_LOG_FOUR_ARG(CONTAINER_TYPE)                             \
     template <typename T1, typename T2, typename T3, typename T4>                   \
     inline LogMessage& operator<<(const CONTAINER_TYPE<T1, T2, T3, T4>& container)  \
     {                                                                               \
-        return WriteIterator(container.begin(), container.end(), container.size()); \
+        return WriteContainer(container, GetDefaultContainerFormat());              \
     }
 #define ITERATOR_CONTAINER_LOG_FIVE_ARG(CONTAINER_TYPE)                                 \
     template <typename T1, typename T2, typename T3, typename T4, typename T5>          \
     inline LogMessage& operator<<(const CONTAINER_TYPE<T1, T2, T3, T4, T5>& container)  \
     {                                                                                   \
-        return WriteIterator(container.begin(), container.end(), container.size());     \
+        return WriteContainer(container, GetDefaultContainerFormat());                  \
     }
 
     ITERATOR_CONTAINER_LOG_TWO_ARG(std::vector)
     ITERATOR_CONTAINER_LOG_TWO_ARG(std::list)
     ITERATOR_CONTAINER_LOG_TWO_ARG(std::deque)
+    ITERATOR_CONTAINER_LOG_TWO_ARG(std::queue)
+    ITERATOR_CONTAINER_LOG_TWO_ARG(std::stack)
     ITERATOR_CONTAINER_LOG_THREE_ARG(std::set)
     ITERATOR_CONTAINER_LOG_THREE_ARG(std::multiset)
+    ITERATOR_CONTAINER_LOG_THREE_ARG(std::priority_queue)
     ITERATOR_CONTAINER_LOG_FOUR_ARG(std::map)
     ITERATOR_CONTAINER_LOG_FOUR_ARG(std::multimap)
+    ITERATOR_CONTAINER_LOG_FOUR_ARG(std::unordered_set)
+    ITERATOR_CONTAINER_LOG_FOUR_ARG(std::unordered_multiset)
+    ITERATOR_CONTAINER_LOG_FIVE_ARG(std::unordered_map)
+    ITERATOR_CONTAINER_LOG_FIVE_ARG(std::unordered_multimap)
 
-    // 迭代器适配容器
-    template <typename T, typename Container>
-    inline LogMessage& operator<<(const std::queue<T, Container>& q)
+    template <typename T, size_t N>
+    inline LogMessage& operator<<(const std::array<T, N>& container)
     {
-        IterableQueue<T, Container> iterable_queue = static_cast<IterableQueue<T, Container>>(q);
-        return WriteIterator(iterable_queue.begin(), iterable_queue.end(), iterable_queue.size());
+        return WriteContainer(container, GetDefaultContainerFormat());
     }
 
-    template <typename T, typename Container>
-    inline LogMessage& operator<<(const std::stack<T, Container>& s)
+    template <typename First, typename Second>
+    inline LogMessage& operator<<(const std::pair<First, Second>& p)
     {
-        IterableStack<T, Container> iterable_stack = static_cast<IterableStack<T, Container>>(s);
-        return WriteIterator(iterable_stack.begin(), iterable_stack.end(), iterable_stack.size());
+        stream_.Append('(');
+        operator<<(p.first);
+        stream_.Append(',');
+        operator<<(p.second);
+        stream_.Append(')');
+
+        return *this;
     }
 
-    template <typename T, typename Container, typename Compare>
-    inline LogMessage& operator<<(const std::priority_queue<T, Container, Compare>& q)
+    template <typename... Types>
+    inline LogMessage& operator<<(const std::tuple<Types...>& t)
     {
-        IterablePriorityQueue<T, Container, Compare> iterable_priority_queue = static_cast<IterablePriorityQueue<T, Container, Compare>>(q);
-        return WriteIterator(iterable_priority_queue.begin(), iterable_priority_queue.end(), iterable_priority_queue.size());
+        stream_.Append('(');
+        WriteTupleElements<0>(t);
+        stream_.Append(')');
+
+        return *this;
     }
 
-    template <typename First, typename Second>
-    inline LogMessage& operator<<(const std::pair<First, Second>& p)
-    {
-        stream_ << "(";
-        operator<<(static_cast<First>(p.first));
-        stream_ << ",";
-        operator<<(static_cast<Second>(p.second));
-        stream_ << ")";
+// 结构化字段：LOG_INFO(net).kv("conn", id).kv("bytes", n) << "closed"
+// 字段按类型编码保存，输出时以" key=value"的形式追加在日志文本末尾，JSON等结构化后端可以直接读取类型化的字段
+#define KV_FIELD_LOG(VALUE_TYPE, ADD_METHOD, CAST_TYPE)                 \
+    inline LogMessage& kv(const char* key, VALUE_TYPE value)           \
+    {                                                                   \
+        field_encoder_.ADD_METHOD(key, static_cast<CAST_TYPE>(value));  \
+        return *this;                                                   \
+    }
 
+    KV_FIELD_LOG(bool, AddBool, bool)
+    KV_FIELD_LOG(signed short, AddInt, int64_t)
+    KV_FIELD_LOG(unsigned short, AddUint, uint64_t)
+    KV_FIELD_LOG(signed int, AddInt, int64_t)
+    KV_FIELD_LOG(unsigned int, AddUint, uint64_t)
+    KV_FIELD_LOG(signed long, AddInt, int64_t)
+    KV_FIELD_LOG(unsigned long, AddUint, uint64_t)
+    KV_FIELD_LOG(signed long long, AddInt, int64_t)
+    KV_FIELD_LOG(unsigned long long, AddUint, uint64_t)
+    KV_FIELD_LOG(float, AddDouble, double)
+    KV_FIELD_LOG(double, AddDouble, double)
+
+    inline LogMessage& kv(const char* key, char value) { field_encoder_.AddString(key, &value, 1); return *this; }
+    inline LogMessage& kv(const char* key, const char* value)
+    {
+        field_encoder_.AddString(key, value != nullptr ? value : "(null)", value != nullptr ? strlen(value) : 6);
+        return *this;
+    }
+    inline LogMessage& kv(const char* key, const std::string& value)
+    {
+        field_encoder_.AddString(key, value.data(), value.size());
         return *this;
     }
 
+    // 获取日志流，用于直接向日志文本追加内容
+    LogStream& GetStream() { return stream_; }
+
     // 获取Log文本的长度
     size_t GetLogTextLength() const { return nums_to_log_; }
 
     // 获取Log文本
-    const char* GetLogText() const { return stream_buf_.GetBuffer(); }
+    const char* GetLogText() const { return text_; }
+
+    // 获取Log文本中渲染结构化字段之前的部分（即日志消息本身，不包含结尾的'\n'）的长度
+    size_t GetMessageLength() const { return message_length_; }
+
+    // 获取编码后的结构化字段，用LogFieldReader解码
+    const char* GetFields() const { return fields_; }
+    size_t GetFieldsSize() const { return fields_size_; }
 
     /**
      * 获取日志消息的级别
      * @return 日志消息的级别
      */
-    LogSeverity GetLogSeverity() const { return msg_severity_; }
+    LogSeverity GetLogSeverity() const { return site_->severity; }
+
+    // 获取打印日志的调用点
+    const LogSite& GetSite() const { return *site_; }
+
+    // 获取打印日志的文件路径、函数名、行数
+    const char* GetFile() const { return site_->file; }
+    const char* GetFunc() const { return site_->func; }
+    int GetLine() const { return site_->line; }
+
+    // 获取打印日志的时间
+    const struct timeval& GetTime() const { return tv_; }
+
+    // 获取打印日志的线程号
+    long GetThreadId() const { return thread_id_; }
 
     /**
-     * 根据传入格式组织日志头部
+     * 根据传入格式组织日志头部。每次调用都要重新解析格式串，日志输出后端应使用预编译的HeaderPattern
      * @param header_pattern 头部格式，确保传入正确格式（设置时检查）
      * @return 日志头部内容字符串
      */
     std::string GetLogHeader(const std::string& header_pattern) const;
 
+    enum
+    {
+        // 单条日志文本最大长度的下限
+        kMinTextSize = 256
+    };
+
+    /**
+     * 设置单条日志文本的最大长度，超过的部分被截断，文本末尾标记"...[truncated N bytes]"
+     * @param max_size 字节数，限制在kMinTextSize ~ LogStream::kMaxSizeLimit之间，默认为LogStream::kDefaultMaxSize
+     */
+    static void SetMaxTextSize(size_t max_size);
+    static size_t GetMaxTextSize();
+
   private:
     void Flush();
 
+    // 依次输出tuple的第I个及之后的元素
+    template <size_t I, typename... Types>
+    inline typename std::enable_if<(I < sizeof...(Types))>::type WriteTupleElements(const std::tuple<Types...>& t)
+    {
+        if (I > 0) stream_.Append(',');
+        operator<<(std::get<I>(t));
+        WriteTupleElements<I + 1>(t);
+    }
+
+    template <size_t I, typename... Types>
+    inline typename std::enable_if<(I == sizeof...(Types))>::type WriteTupleElements(const std::tuple<Types...>&)
+    {
+    }
+
+    // LogStream的扩容方法，换成能容纳required个字符的最小一级扩容缓冲区
+    static char* GrowBuffer(void* context, const char* buffer, size_t count, size_t required, size_t& capacity);
+
   private:
-    // 日志等级
-    const LogSeverity msg_severity_;
-    // 打印日志的文件名
-    const char* const file_;
-    // 打印日志的函数名
-    const char* const func_;
-    // 打印日志的文件行数
-    const int line_;
+    // 调用点，包括日志等级、文件名、函数名、行数和模块名
+    const LogSite* const site_;
     // 打印日志的时间
     struct timeval tv_;
+    // 打印日志的线程号（异步模式下由后台线程输出，需要在构造时记录）
+    long thread_id_;
     // 日志输出后端
     LogFunc log_func_;
     // 记录日志是否已经输出
     bool flushed_;
-    // 日志流的缓冲区
-    LogStreamBuf stream_buf_;
+    // 日志文本缓冲区，优先复用线程级的缓冲区
+    char* buffer_;
+    // 日志文本超过行内缓冲区后使用的扩容缓冲区及其级别
+    char* spill_buffer_;
+    unsigned spill_class_;
     // 日志流
-    std::ostream stream_;
+    LogStream stream_;
     // 日志文本的字符数
     size_t nums_to_log_;
+    // 日志文本，默认指向stream_的缓冲区
+    const char* text_;
+    // 结构化字段编码器，写到buffer_中日志文本之后的区域
+    LogFieldEncoder field_encoder_;
+    // 编码后的结构化字段
+    const char* fields_;
+    size_t fields_size_;
+    // 日志文本中渲染字段之前的部分的长度
+    size_t message_length_;
 };
 }
\ No newline at end of file
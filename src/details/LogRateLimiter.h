@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Nlog
+{
+// 限频日志的调用点状态，每条LOG_EVERY_N/LOG_FIRST_N/LOG_EVERY_T语句对应一个静态对象。
+// 判断只有一次原子操作，不需要打印时不会构造LogMessage
+
+// 每n次打印一次，第1次一定打印
+class LogEveryNSite
+{
+  public:
+    constexpr LogEveryNSite() : count_(0) {}
+
+    /**
+     * @param n 间隔次数，小于等于1时每次都打印
+     * @return true表示本次需要打印
+     */
+    bool ShouldLog(int64_t n)
+    {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        return n <= 1 || count % static_cast<uint64_t>(n) == 0;
+    }
+
+  private:
+    std::atomic<uint64_t> count_;
+};
+
+// 只打印前n次
+class LogFirstNSite
+{
+  public:
+    constexpr LogFirstNSite() : count_(0) {}
+
+    /**
+     * @param n 打印次数
+     * @return true表示本次需要打印
+     */
+    bool ShouldLog(int64_t n)
+    {
+        // 打印够之后只有一次读，不再写共享的缓存行
+        if (count_.load(std::memory_order_relaxed) >= n) return false;
+        return count_.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+
+  private:
+    std::atomic<int64_t> count_;
+};
+
+// 每隔一段时间最多打印一次，第1次一定打印
+class LogEveryTSite
+{
+  public:
+    constexpr LogEveryTSite() : next_time_ns_(0) {}
+
+    /**
+     * @param interval 间隔时长（s），可以是小数
+     * @return true表示本次需要打印
+     */
+    bool ShouldLog(double interval)
+    {
+        int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+        int64_t next_time_ns = next_time_ns_.load(std::memory_order_relaxed);
+        if (now_ns < next_time_ns) return false;
+        // 多个线程同时到期时只有一个能打印
+        return next_time_ns_.compare_exchange_strong(next_time_ns, now_ns + static_cast<int64_t>(interval * 1e9),
+                                                     std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<int64_t> next_time_ns_;
+};
+
+/**
+ * 按概率采样，每个线程使用自己的随机数生成器（xorshift64*），不需要调用点状态，线程间没有共享写
+ * @param probability 打印的概率，大于等于1时每次都打印，小于等于0时不打印
+ * @return true表示本次需要打印
+ */
+inline bool ShouldLogSampled(double probability)
+{
+    if (probability >= 1) return true;
+    if (probability <= 0) return false;
+
+    static thread_local uint64_t state = 0;
+    if (state == 0)
+    {
+        // 用线程私有变量的地址和时间作为种子，保证不为0
+        state = (reinterpret_cast<uintptr_t>(&state) ^
+                 static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())) |
+                1;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    // 取高53位转换为[0, 1)的浮点数
+    return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0) < probability;
+}
+}  // namespace Nlog
@@ -0,0 +1,313 @@
+#include "LogRetention.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+
+#include "Utils.h"
+
+namespace Nlog
+{
+constexpr std::chrono::seconds LogRetention::kCheckInterval;
+// 内置压缩算法（Lz4LogCodec）的后缀，目录中还没有压缩文件时也能找到
+const char kBuiltinCompressedSuffix[] = "lz4";
+// 压缩过程中的临时文件后缀
+const char kCompressingFileSuffix[] = ".tmp";
+
+// 获取文件大小，文件不存在时返回false
+static bool StatFileSize(const std::string& file_name, uint64_t& size)
+{
+    struct stat st;
+    if (stat(file_name.c_str(), &st) != 0) return false;
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+LogRetention::LogRetention(const std::string& dir_name, const RetentionPolicy& policy)
+    : dir_name_(dir_name), policy_(policy), total_bytes_(0), dirty_(true), stopping_(false)
+{
+    compressed_suffixes_.insert(kBuiltinCompressedSuffix);
+    Scan();
+    if (!policy_.IsUnlimited())
+    {
+        thread_ = std::thread(&LogRetention::Run, this);
+    }
+}
+
+LogRetention::~LogRetention()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void LogRetention::Scan()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.clear();
+    total_bytes_ = 0;
+
+    DIR* dir = opendir(dir_name_.c_str());
+    if (nullptr == dir)
+    {
+        std::cerr << "INFO: dir not exist, dir:" << dir_name_ << std::endl;
+        return;
+    }
+
+    std::string logged_prefix = std::string(kLoggedFileSuffix) + ".";
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr)
+    {
+        int log_index = 0;
+        std::string suffix;
+        time_t ts = ParseLogFileName(dp->d_name, log_index, suffix);
+        if (0 == ts) continue;
+
+        LogSegment::State state;
+        std::string compressed_suffix;
+        if (suffix == kLoggingFileSuffix)
+        {
+            state = LogSegment::kLogging;
+        }
+        else if (suffix == kLoggedFileSuffix)
+        {
+            state = LogSegment::kLogged;
+        }
+        else if (suffix.compare(0, logged_prefix.size(), logged_prefix) == 0 && !EndsWith(suffix, kCompressingFileSuffix))
+        {
+            state = LogSegment::kCompressed;
+            compressed_suffix = suffix.substr(logged_prefix.size());
+            compressed_suffixes_.insert(compressed_suffix);
+        }
+        else
+        {
+            // 压缩的临时文件等
+            continue;
+        }
+
+        uint64_t size = 0;
+        if (!StatFileSize(dir_name_ + "/" + dp->d_name, size)) continue;
+
+        // 同一个日志文件可能同时存在多种形式（如压缩完成后还没删除原文件），状态取最靠前的，大小累加
+        SegmentKey key(ts, log_index);
+        std::map<SegmentKey, LogSegment>::iterator it = segments_.find(key);
+        if (it == segments_.end())
+        {
+            LogSegment& segment = segments_[key];
+            segment.ts = ts;
+            segment.index = log_index;
+            segment.state = state;
+            segment.size = size;
+            segment.compressed_suffix = compressed_suffix;
+        }
+        else
+        {
+            LogSegment& segment = it->second;
+            segment.size += size;
+            if (state < segment.state) segment.state = state;
+            if (!compressed_suffix.empty()) segment.compressed_suffix = compressed_suffix;
+        }
+        total_bytes_ += size;
+    }
+
+    (void)closedir(dir);
+}
+
+bool LogRetention::RecoverLoggingSegment(LogSegment& segment)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool found = false;
+    for (std::map<SegmentKey, LogSegment>::reverse_iterator it = segments_.rbegin(); it != segments_.rend(); ++it)
+    {
+        LogSegment& logging_segment = it->second;
+        if (logging_segment.state != LogSegment::kLogging) continue;
+        if (!found)
+        {
+            segment = logging_segment;
+            found = true;
+            continue;
+        }
+
+        // NOTE ignore rename fail
+        if (rename(GetLogFileName(dir_name_, logging_segment.ts, true, logging_segment.index).c_str(),
+                   GetLogFileName(dir_name_, logging_segment.ts, false, logging_segment.index).c_str()) == 0)
+        {
+            logging_segment.state = LogSegment::kLogged;
+        }
+    }
+    return found;
+}
+
+void LogRetention::OnOpen(time_t ts, int index, uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LogSegment& segment = segments_[SegmentKey(ts, index)];
+    total_bytes_ += size - segment.size;
+    segment.ts = ts;
+    segment.index = index;
+    segment.size = size;
+    segment.state = LogSegment::kLogging;
+}
+
+void LogRetention::OnRotate(time_t ts, int index, uint64_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LogSegment& segment = segments_[SegmentKey(ts, index)];
+        total_bytes_ += size - segment.size;
+        segment.ts = ts;
+        segment.index = index;
+        segment.size = size;
+        segment.state = LogSegment::kLogged;
+        dirty_ = true;
+    }
+    cond_.notify_all();
+}
+
+std::vector<LogSegment> LogRetention::GetSegments()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LogSegment> segments;
+    segments.reserve(segments_.size());
+    for (const auto& key_segment : segments_)
+    {
+        segments.push_back(key_segment.second);
+    }
+    return segments;
+}
+
+uint64_t LogRetention::GetTotalBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_bytes_;
+}
+
+bool LogRetention::RefreshLoggedSegments(std::vector<LogSegment>& segments,
+                                         const std::set<std::string>& compressed_suffixes) const
+{
+    bool missing = false;
+    for (LogSegment& segment : segments)
+    {
+        std::string logged_name = GetLogFileName(dir_name_, segment.ts, false, segment.index);
+        if (StatFileSize(logged_name, segment.size)) continue;
+
+        bool found = false;
+        for (const std::string& compressed_suffix : compressed_suffixes)
+        {
+            if (StatFileSize(logged_name + "." + compressed_suffix, segment.size))
+            {
+                segment.state = LogSegment::kCompressed;
+                segment.compressed_suffix = compressed_suffix;
+                found = true;
+                break;
+            }
+        }
+        missing = missing || !found;
+    }
+    return missing;
+}
+
+void LogRetention::Enforce()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 写完的文件可能已经被压缩，按写完时的大小计算是偏大的，超过总大小限制时先确认实际大小。
+    // 确认时不持有锁，不影响切分文件
+    if (policy_.max_total_bytes > 0 && total_bytes_ > policy_.max_total_bytes)
+    {
+        std::vector<LogSegment> logged_segments;
+        for (const auto& key_segment : segments_)
+        {
+            if (key_segment.second.state == LogSegment::kLogged) logged_segments.push_back(key_segment.second);
+        }
+        std::set<std::string> compressed_suffixes = compressed_suffixes_;
+        lock.unlock();
+
+        if (RefreshLoggedSegments(logged_segments, compressed_suffixes))
+        {
+            // 有文件被外部删除或者使用了未知的压缩后缀，重新遍历目录
+            Scan();
+            lock.lock();
+        }
+        else
+        {
+            lock.lock();
+            for (const LogSegment& logged_segment : logged_segments)
+            {
+                std::map<SegmentKey, LogSegment>::iterator it =
+                    segments_.find(SegmentKey(logged_segment.ts, logged_segment.index));
+                if (it == segments_.end() || it->second.state != LogSegment::kLogged) continue;
+                total_bytes_ += logged_segment.size - it->second.size;
+                it->second = logged_segment;
+            }
+        }
+    }
+
+    std::vector<LogSegment> expired_segments;
+    time_t now = time(0);
+    size_t file_count = segments_.size();
+    std::map<SegmentKey, LogSegment>::iterator it = segments_.begin();
+    while (it != segments_.end())
+    {
+        const LogSegment& segment = it->second;
+        // 不删除正在写入的文件
+        if (segment.state == LogSegment::kLogging)
+        {
+            ++it;
+            continue;
+        }
+
+        bool expired = (policy_.max_files > 0 && file_count > policy_.max_files) ||
+                       (policy_.max_total_bytes > 0 && total_bytes_ > policy_.max_total_bytes) ||
+                       (policy_.max_age.count() > 0 && segment.ts + policy_.max_age.count() < now);
+        if (!expired) break;
+
+        expired_segments.push_back(segment);
+        total_bytes_ -= segment.size;
+        --file_count;
+        it = segments_.erase(it);
+    }
+    std::set<std::string> compressed_suffixes = compressed_suffixes_;
+    lock.unlock();
+
+    for (const LogSegment& segment : expired_segments)
+    {
+        RemoveSegmentFiles(segment, compressed_suffixes);
+    }
+}
+
+void LogRetention::RemoveSegmentFiles(const LogSegment& segment, const std::set<std::string>& compressed_suffixes)
+{
+    std::string logged_name = GetLogFileName(dir_name_, segment.ts, false, segment.index);
+    unlink(GetLogFileName(dir_name_, segment.ts, true, segment.index).c_str());
+    unlink(logged_name.c_str());
+    // 索引中的状态可能落后于压缩，所有已知的压缩后缀都尝试删除
+    for (const std::string& compressed_suffix : compressed_suffixes)
+    {
+        unlink((logged_name + "." + compressed_suffix).c_str());
+    }
+}
+
+void LogRetention::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        cond_.wait_for(lock, kCheckInterval, [this] { return stopping_ || dirty_; });
+        if (stopping_) break;
+        dirty_ = false;
+
+        lock.unlock();
+        Enforce();
+        lock.lock();
+    }
+}
+}  // namespace Nlog
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Nlog
+{
+// 日志文件保留策略，为0的项不限制，超过任意一项限制时从最旧的日志文件开始删除
+struct RetentionPolicy
+{
+    // 日志文件（包括压缩后的文件）的总大小上限
+    uint64_t max_total_bytes = 0;
+    // 日志文件个数上限
+    size_t max_files = 0;
+    // 最长保留时间，按文件名中的时间（即文件开始写入的时间）计算
+    std::chrono::seconds max_age = std::chrono::seconds(0);
+
+    bool IsUnlimited() const { return max_total_bytes == 0 && max_files == 0 && max_age.count() == 0; }
+};
+
+// 日志目录中的一个日志文件，压缩前后算同一个
+struct LogSegment
+{
+    enum State
+    {
+        // 正在写入，后缀为.logging
+        kLogging,
+        // 已经写完，后缀为.log
+        kLogged,
+        // 已经压缩，后缀为.log.压缩后缀
+        kCompressed,
+    };
+
+    time_t ts = 0;
+    int index = 0;
+    uint64_t size = 0;
+    State state = kLogged;
+    // 压缩后缀，如lz4
+    std::string compressed_suffix;
+};
+
+// 日志目录的内存索引和保留策略的执行者。
+// 启动时扫描一次目录建立索引，之后由日志输出后端在打开和切分文件时更新索引，不再遍历目录；
+// 超过保留策略的日志文件由后台线程删除，不占用写日志的线程
+class LogRetention
+{
+  public:
+    // 后台线程检查的间隔，切分文件时会立即检查
+    static constexpr std::chrono::seconds kCheckInterval = std::chrono::seconds(60);
+
+    /**
+     * 扫描目录建立索引，保留策略有限制时启动后台线程
+     * @param dir_name 日志文件目录
+     * @param policy 保留策略
+     */
+    LogRetention(const std::string& dir_name, const RetentionPolicy& policy);
+    ~LogRetention();
+
+    LogRetention(const LogRetention&) = delete;
+    LogRetention& operator=(const LogRetention&) = delete;
+
+    /**
+     * 获取最新的正在写入的日志文件用于继续写入，更旧的.logging文件（上次异常退出遗留）重命名为.log
+     * @param segment 最新的正在写入的日志文件
+     * @return 没有正在写入的日志文件时返回false
+     */
+    bool RecoverLoggingSegment(LogSegment& segment);
+
+    /**
+     * 打开了新的日志文件
+     */
+    void OnOpen(time_t ts, int index, uint64_t size);
+
+    /**
+     * 日志文件写完并重命名为.log，通知后台线程检查保留策略
+     * @param size 文件大小
+     */
+    void OnRotate(time_t ts, int index, uint64_t size);
+
+    /**
+     * @return 按时间从旧到新排列的所有日志文件
+     */
+    std::vector<LogSegment> GetSegments();
+
+    /**
+     * @return 所有日志文件的总大小
+     */
+    uint64_t GetTotalBytes();
+
+    /**
+     * 立即执行一次保留策略，一般由后台线程调用
+     */
+    void Enforce();
+
+  private:
+    typedef std::pair<time_t, int> SegmentKey;
+
+    /**
+     * 遍历目录，重新建立索引
+     */
+    void Scan();
+
+    /**
+     * 确认已经写完的日志文件的实际大小，它们可能已经被压缩，不需要持有mutex_
+     * @param segments 已经写完的日志文件，更新其大小和状态
+     * @param compressed_suffixes 已知的压缩后缀
+     * @return 有找不到的文件，需要重新遍历目录
+     */
+    bool RefreshLoggedSegments(std::vector<LogSegment>& segments,
+                               const std::set<std::string>& compressed_suffixes) const;
+
+    /**
+     * 删除日志文件的所有形式（.logging/.log/压缩文件）
+     */
+    void RemoveSegmentFiles(const LogSegment& segment, const std::set<std::string>& compressed_suffixes);
+
+    void Run();
+
+  private:
+    const std::string dir_name_;
+    const RetentionPolicy policy_;
+    // mutex_ 保护下面的成员
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // 按时间和序号排序的日志文件
+    std::map<SegmentKey, LogSegment> segments_;
+    // 所有日志文件的总大小
+    uint64_t total_bytes_;
+    // 目录中出现过的压缩后缀，用于查找压缩后的文件
+    std::set<std::string> compressed_suffixes_;
+    // 有文件写完，需要检查保留策略
+    bool dirty_;
+    bool stopping_;
+    std::thread thread_;
+};
+}  // namespace Nlog
@@ -21,6 +21,9 @@ enum LogSeverity
     FATAL,    // 致命级别
 };
 
+// 默认的全局日志等级
+constexpr LogSeverity kDefaultLogSeverity = DEBUG;
+
 /**
  * 获取日志级别对应的名称
  * @param log_severity 日志级别
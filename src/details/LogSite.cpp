@@ -0,0 +1,116 @@
+#include "LogSite.h"
+
+#include <fnmatch.h>
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../Nlog.h"
+
+namespace Nlog
+{
+constexpr int LogSite::kLevelBits;
+constexpr uint64_t LogSite::kLevelMask;
+constexpr uint32_t LogSite::kHasRulesFlag;
+std::atomic<uint64_t> LogSite::generation_(1);
+std::atomic<uint32_t> LogSite::level_filter_(kDefaultLogSeverity);
+
+// g_rules_mutex 保护下面的规则，只在设置规则和调用点解析有效等级时使用
+static std::mutex g_rules_mutex;
+// 模块名对应的日志等级
+static std::map<std::string, LogSeverity> g_module_severities;
+// 文件名规则，按设置顺序排列
+static std::vector<std::pair<std::string, LogSeverity>> g_file_severities;
+
+void LogSite::SetModuleSeverity(const std::string& module_name, LogSeverity log_severity)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_rules_mutex);
+        g_module_severities[module_name] = log_severity;
+    }
+    InvalidateSeverityCache();
+}
+
+void LogSite::SetFileSeverity(const std::string& pattern, LogSeverity log_severity)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_rules_mutex);
+        // 相同的模式只保留最后一次设置
+        for (auto it = g_file_severities.begin(); it != g_file_severities.end(); ++it)
+        {
+            if (it->first == pattern)
+            {
+                g_file_severities.erase(it);
+                break;
+            }
+        }
+        g_file_severities.emplace_back(pattern, log_severity);
+    }
+    InvalidateSeverityCache();
+}
+
+void LogSite::ClearSeverityRules()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_rules_mutex);
+        g_module_severities.clear();
+        g_file_severities.clear();
+    }
+    InvalidateSeverityCache();
+}
+
+void LogSite::InvalidateSeverityCache()
+{
+    std::lock_guard<std::mutex> lock(g_rules_mutex);
+    UpdateLevelFilter();
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+void LogSite::UpdateLevelFilter()
+{
+    LogSeverity min_level = Logging::GetLogSeverity();
+    for (const auto& rule : g_module_severities)
+    {
+        if (rule.second < min_level) min_level = rule.second;
+    }
+    for (const auto& rule : g_file_severities)
+    {
+        if (rule.second < min_level) min_level = rule.second;
+    }
+    bool has_rules = !g_module_severities.empty() || !g_file_severities.empty();
+    level_filter_.store(static_cast<uint32_t>(min_level) | (has_rules ? kHasRulesFlag : 0),
+                        std::memory_order_relaxed);
+}
+
+bool LogSite::ResolveIsOn()
+{
+    // 先读代数再读配置，解析过程中配置又变化时缓存的是旧代数，下次判断会重新解析
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    LogSeverity level = Logging::GetLogSeverity();
+    {
+        std::lock_guard<std::mutex> lock(g_rules_mutex);
+        auto module_it = g_module_severities.find(module);
+        if (module_it != g_module_severities.end())
+        {
+            level = module_it->second;
+        }
+        else
+        {
+            for (auto it = g_file_severities.rbegin(); it != g_file_severities.rend(); ++it)
+            {
+                const std::string& pattern = it->first;
+                const char* name = pattern.find('/') != std::string::npos ? file : file_name;
+                if (fnmatch(pattern.c_str(), name, 0) == 0)
+                {
+                    level = it->second;
+                    break;
+                }
+            }
+        }
+    }
+    level_cache_.store(generation << kLevelBits | static_cast<uint64_t>(level), std::memory_order_relaxed);
+    return severity >= level;
+}
+}  // namespace Nlog
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "LogSeverity.h"
+
+namespace Nlog
+{
+constexpr const char* FindBaseNameOr(const char* found, const char* path, size_t length);
+
+/**
+ * 查找路径中最后一个'/'之后的位置，二分递归，编译期计算时递归深度只有log(length)
+ * @return 没有'/'时返回nullptr
+ */
+constexpr const char* FindBaseName(const char* path, size_t length)
+{
+    return length == 0   ? nullptr
+           : length == 1 ? (*path == '/' ? path + 1 : nullptr)
+                         : FindBaseNameOr(FindBaseName(path + length / 2, length - length / 2), path, length / 2);
+}
+
+// 后半段中找到时直接返回，否则再查找前半段
+constexpr const char* FindBaseNameOr(const char* found, const char* path, size_t length)
+{
+    return found != nullptr ? found : FindBaseName(path, length);
+}
+
+/**
+ * 获取路径中的文件名（去掉目录），可以在编译期计算
+ * @param path 路径
+ * @param length 路径长度
+ * @return 指向path中文件名起始位置的指针
+ */
+constexpr const char* GetBaseName(const char* path, size_t length)
+{
+    return FindBaseName(path, length) != nullptr ? FindBaseName(path, length) : path;
+}
+
+// 日志调用点的静态信息，每条日志语句对应一个在编译期初始化（常量初始化）的静态对象，LogMessage只保存指向它的指针。
+// 文件名、函数名的长度都在编译期算好，格式化头部时不需要strrchr和strlen；
+// 日志输出后端可以用调用点的地址作为key缓存按调用点计算的结果。
+// 没有模块和文件名规则时只和全局等级比较，只需要一次原子读；有规则时低于所有等级中最低的等级的也只需要一次原子读，
+// 其余的调用点缓存自己的有效日志等级（按模块名、文件名和全局等级解析），配置变化时通过全局代数失效，需要两次原子读
+struct LogSite
+{
+    /**
+     * @param log_file 文件路径，一般为__FILE__
+     * @param file_length 文件路径长度
+     * @param log_func 函数名，一般为__func__
+     * @param log_func_length 函数名长度
+     * @param log_module 模块名，即LOG_INFO(module)中的module
+     */
+    constexpr LogSite(LogSeverity log_severity, const char* log_file, size_t file_length, const char* log_func,
+                      size_t log_func_length, int log_line, const char* log_module)
+        : severity(log_severity),
+          file(log_file),
+          file_name(GetBaseName(log_file, file_length)),
+          file_name_length(file_length - static_cast<size_t>(GetBaseName(log_file, file_length) - log_file)),
+          func(log_func),
+          func_length(log_func_length),
+          line(log_line),
+          module(log_module),
+          level_cache_(0)
+    {
+    }
+
+    LogSite(const LogSite&) = delete;
+    LogSite& operator=(const LogSite&) = delete;
+
+    /**
+     * 判断调用点的日志等级是否打开，没有规则时只有一次原子读，有效等级已经缓存且没有失效时最多两次原子读
+     * @return true表示打开
+     */
+    bool IsOn()
+    {
+        uint32_t filter = level_filter_.load(std::memory_order_relaxed);
+        if (severity < static_cast<LogSeverity>(filter & kLevelMask)) return false;
+        if ((filter & kHasRulesFlag) == 0) return true;
+
+        uint64_t cache = level_cache_.load(std::memory_order_relaxed);
+        if (cache >> kLevelBits == generation_.load(std::memory_order_relaxed))
+        {
+            return severity >= static_cast<LogSeverity>(cache & kLevelMask);
+        }
+        return ResolveIsOn();
+    }
+
+    /**
+     * 设置模块的日志等级，优先于文件名规则和全局等级
+     * @param module_name 模块名，即LOG_INFO(module)中的module
+     */
+    static void SetModuleSeverity(const std::string& module_name, LogSeverity log_severity);
+
+    /**
+     * 设置文件名匹配的日志等级，优先于全局等级，多条规则都匹配时后设置的优先
+     * @param pattern glob模式（fnmatch），包含'/'时匹配完整路径（__FILE__），否则只匹配文件名
+     */
+    static void SetFileSeverity(const std::string& pattern, LogSeverity log_severity);
+
+    /**
+     * 清除所有模块和文件名规则，只使用全局等级
+     */
+    static void ClearSeverityRules();
+
+    /**
+     * 使所有调用点缓存的有效等级失效，修改全局等级后调用
+     */
+    static void InvalidateSeverityCache();
+
+    const LogSeverity severity;
+    // 文件路径
+    const char* const file;
+    // 文件名（去掉目录），指向file中的位置
+    const char* const file_name;
+    const size_t file_name_length;
+    const char* const func;
+    const size_t func_length;
+    const int line;
+    const char* const module;
+
+  private:
+    static constexpr int kLevelBits = 8;
+    static constexpr uint64_t kLevelMask = (1u << kLevelBits) - 1;
+    static constexpr uint32_t kHasRulesFlag = 1u << kLevelBits;
+
+    /**
+     * 按全局等级和规则更新level_filter_，调用方需要持有规则的锁
+     */
+    static void UpdateLevelFilter();
+
+    /**
+     * 解析有效等级并缓存
+     * @return true表示打开
+     */
+    bool ResolveIsOn();
+
+    // 高位为解析时的全局代数，低kLevelBits位为有效等级，0表示还没有解析过
+    std::atomic<uint64_t> level_cache_;
+    // 全局代数，从1开始，日志等级配置每变化一次加1
+    static std::atomic<uint64_t> generation_;
+    // 低kLevelBits位为全局等级和所有规则中最低的等级，kHasRulesFlag表示设置了模块或文件名规则
+    static std::atomic<uint32_t> level_filter_;
+};
+}  // namespace Nlog
+
+// 定义当前调用点的静态LogSite，使用constexpr构造函数，在编译期完成初始化
+#define NLOG_DEFINE_LOG_SITE(name, log_severity, module)                                                               \
+    static Nlog::LogSite name(Nlog::log_severity, __FILE__, sizeof(__FILE__) - 1, __func__, sizeof(__func__) - 1,      \
+                              __LINE__, #module)
+
+// 定义当前调用点的静态LogSite并返回其指针。语句表达式（GCC/Clang扩展）中的__func__是所在函数的名字，
+// lambda中的则是operator()
+#define NLOG_LOG_SITE(log_severity, module)                                                                            \
+    (__extension__({                                                                                                   \
+        NLOG_DEFINE_LOG_SITE(nlog_site, log_severity, module);                                                         \
+        &nlog_site;                                                                                                    \
+    }))
@@ -0,0 +1,97 @@
+#include "LogStats.h"
+
+#include <cstdio>
+
+namespace Nlog
+{
+PipelineCounters g_pipeline_counters;
+
+// 下一个分配给新线程的分片
+static std::atomic<size_t> g_next_stats_shard(0);
+
+size_t GetStatsShard()
+{
+    static thread_local size_t shard = g_next_stats_shard.fetch_add(1, std::memory_order_relaxed) % kStatsShards;
+    return shard;
+}
+
+uint64_t LatencyStats::Percentile(double quantile) const
+{
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(quantile * count);
+    if (rank >= count) rank = count - 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kLatencyBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen > rank) return uint64_t(2) << i;
+    }
+    return uint64_t(2) << (kLatencyBuckets - 1);
+}
+
+void LatencyHistogram::Snapshot(LatencyStats& stats) const
+{
+    stats = LatencyStats();
+    for (const Shard& shard : shards_)
+    {
+        for (size_t i = 0; i < kLatencyBuckets; ++i)
+        {
+            uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+            stats.buckets[i] += n;
+            stats.count += n;
+        }
+        stats.total_ns += shard.total_ns.load(std::memory_order_relaxed);
+    }
+}
+
+void LoggerStats::Snapshot(SinkStats& stats) const
+{
+    stats.messages = messages.Get();
+    stats.bytes = bytes.Get();
+    stats.dropped = dropped.Get();
+    stats.rotations = rotations.Get();
+    stats.lock_waits = lock_waits.Get();
+    stats.lock_wait_ns = lock_wait_ns.Get();
+    write_latency.Snapshot(stats.write_latency);
+    flush_latency.Snapshot(stats.flush_latency);
+}
+
+// 输出延迟统计：次数、平均值和分位数，单位为微秒
+static void AppendLatency(std::string& out, const char* name, const LatencyStats& stats)
+{
+    char buf[160];
+    double avg_us = stats.count > 0 ? stats.total_ns / 1000.0 / stats.count : 0;
+    snprintf(buf, sizeof(buf), " %s={count=%llu avg=%.1f p50=%.1f p99=%.1f p999=%.1f}", name,
+             static_cast<unsigned long long>(stats.count), avg_us, stats.Percentile(0.5) / 1000.0,
+             stats.Percentile(0.99) / 1000.0, stats.Percentile(0.999) / 1000.0);
+    out += buf;
+}
+
+std::string LogStats::ToString() const
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "messages={V=%llu D=%llu I=%llu W=%llu E=%llu F=%llu} truncated=%llu async_queue=%llu "
+             "async_dropped=%llu binary_dropped=%llu dedup_suppressed=%llu",
+             static_cast<unsigned long long>(messages[VERBOSE]), static_cast<unsigned long long>(messages[DEBUG]),
+             static_cast<unsigned long long>(messages[INFO]), static_cast<unsigned long long>(messages[WARN]),
+             static_cast<unsigned long long>(messages[ERROR]), static_cast<unsigned long long>(messages[FATAL]),
+             static_cast<unsigned long long>(truncated), static_cast<unsigned long long>(async_queue_size),
+             static_cast<unsigned long long>(async_dropped), static_cast<unsigned long long>(binary_dropped),
+             static_cast<unsigned long long>(dedup_suppressed));
+    std::string out(buf);
+    for (const SinkStats& sink : sinks)
+    {
+        snprintf(buf, sizeof(buf),
+                 " | %s: messages=%llu bytes=%llu dropped=%llu rotations=%llu lock_waits=%llu lock_wait_us=%.1f",
+                 sink.name.c_str(), static_cast<unsigned long long>(sink.messages),
+                 static_cast<unsigned long long>(sink.bytes), static_cast<unsigned long long>(sink.dropped),
+                 static_cast<unsigned long long>(sink.rotations), static_cast<unsigned long long>(sink.lock_waits),
+                 sink.lock_wait_ns / 1000.0);
+        out += buf;
+        AppendLatency(out, "write_us", sink.write_latency);
+        AppendLatency(out, "flush_us", sink.flush_latency);
+    }
+    return out;
+}
+}  // namespace Nlog
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LogSeverity.h"
+
+namespace Nlog
+{
+enum
+{
+    // 计数器分片数，线程按首次使用的顺序轮流分配到各个分片，线程数不超过分片数时互不竞争
+    kStatsShards = 16,
+    // 延迟直方图的桶数，第i个桶统计[2^i, 2^(i+1))纳秒的样本，最后一个桶统计其余所有更大的样本
+    kLatencyBuckets = 32,
+    kSeverityCount = FATAL + 1,
+};
+
+/**
+ * 获取当前线程使用的统计分片
+ * @return 0 ~ kStatsShards - 1
+ */
+size_t GetStatsShard();
+
+/**
+ * 单调时钟的当前时间，用于统计耗时
+ * @return 纳秒
+ */
+inline uint64_t GetStatsNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 按线程分片的计数器，增加计数只有一次写本分片的原子加，读取时把所有分片相加。
+// 没有用户定义的构造函数，静态对象零初始化，成员对象需要值初始化
+class ShardedCounter
+{
+  public:
+    void Add(uint64_t value = 1) { shards_[GetStatsShard()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    uint64_t Get() const
+    {
+        uint64_t sum = 0;
+        for (const Shard& shard : shards_)
+        {
+            sum += shard.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+  private:
+    enum
+    {
+        kCacheLineSize = 64
+    };
+    // 每个分片独占一个缓存行大小的空间，避免伪共享
+    struct Shard
+    {
+        std::atomic<uint64_t> value;
+        char padding[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+    };
+    Shard shards_[kStatsShards];
+};
+
+// 延迟统计的快照
+struct LatencyStats
+{
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t buckets[kLatencyBuckets] = {};
+
+    /**
+     * 按桶估算分位数，返回样本所在桶的上界
+     * @param quantile 0 ~ 1
+     * @return 纳秒，没有样本时返回0
+     */
+    uint64_t Percentile(double quantile) const;
+};
+
+// 按线程分片、按2的幂分桶的延迟直方图
+class LatencyHistogram
+{
+  public:
+    /**
+     * 记录一个样本
+     * @param ns 耗时（纳秒）
+     */
+    void Record(uint64_t ns)
+    {
+        Shard& shard = shards_[GetStatsShard()];
+        size_t bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+        if (bucket >= kLatencyBuckets) bucket = kLatencyBuckets - 1;
+        shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        shard.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /**
+     * 记录从begin_ns到现在的耗时
+     * @param begin_ns GetStatsNowNs()的返回值
+     */
+    void RecordSince(uint64_t begin_ns) { Record(GetStatsNowNs() - begin_ns); }
+
+    void Snapshot(LatencyStats& stats) const;
+
+  private:
+    struct Shard
+    {
+        std::atomic<uint64_t> buckets[kLatencyBuckets];
+        std::atomic<uint64_t> total_ns;
+        // 补齐到缓存行大小的整数倍
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    Shard shards_[kStatsShards];
+};
+
+// 一个日志输出后端的统计快照
+struct SinkStats
+{
+    std::string name;
+    // 写入的日志条数和字节数（包括头部）
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    // 因缓冲区满等原因丢弃的日志条数
+    uint64_t dropped = 0;
+    // 日志文件切分次数
+    uint64_t rotations = 0;
+    // 写日志时锁有竞争的次数和等待锁的总时长
+    uint64_t lock_waits = 0;
+    uint64_t lock_wait_ns = 0;
+    // 每次把缓冲区写到文件（write/pwrite）的耗时
+    LatencyStats write_latency;
+    // 每次Flush调用的耗时
+    LatencyStats flush_latency;
+};
+
+// 日志输出后端的统计计数器，由Logger持有，各后端在对应的位置更新
+struct LoggerStats
+{
+    ShardedCounter messages;
+    ShardedCounter bytes;
+    ShardedCounter dropped;
+    ShardedCounter rotations;
+    ShardedCounter lock_waits;
+    ShardedCounter lock_wait_ns;
+    LatencyHistogram write_latency;
+    LatencyHistogram flush_latency;
+
+    /**
+     * 加锁，锁有竞争时统计等待时长。没有竞争时只有一次try_lock，不读取时钟
+     * @param mutex 锁
+     */
+    void Lock(std::mutex& mutex)
+    {
+        if (mutex.try_lock()) return;
+        uint64_t begin_ns = GetStatsNowNs();
+        mutex.lock();
+        lock_waits.Add();
+        lock_wait_ns.Add(GetStatsNowNs() - begin_ns);
+    }
+
+    void Snapshot(SinkStats& stats) const;
+};
+
+// 统计等待时长的lock_guard
+class StatsLockGuard
+{
+  public:
+    StatsLockGuard(std::mutex& mutex, LoggerStats& stats) : mutex_(mutex) { stats.Lock(mutex_); }
+    ~StatsLockGuard() { mutex_.unlock(); }
+
+    StatsLockGuard(const StatsLockGuard&) = delete;
+    StatsLockGuard& operator=(const StatsLockGuard&) = delete;
+
+  private:
+    std::mutex& mutex_;
+};
+
+// 日志流水线的全局计数器，静态对象零初始化
+struct PipelineCounters
+{
+    // 各等级输出的日志条数
+    ShardedCounter messages[kSeverityCount];
+    // 文本超过最大长度（LogMessage::SetMaxTextSize）被截断的日志条数
+    ShardedCounter truncated;
+};
+
+extern PipelineCounters g_pipeline_counters;
+
+// 日志流水线的统计快照，Logging::GetStats()返回
+struct LogStats
+{
+    uint64_t messages[kSeverityCount] = {};
+    uint64_t truncated = 0;
+    // 异步模式下队列中等待输出的日志条数和因队列满丢弃的条数
+    uint64_t async_queue_size = 0;
+    uint64_t async_dropped = 0;
+    // 二进制日志模式下因缓冲区满丢弃的条数
+    uint64_t binary_dropped = 0;
+    // 被折叠的重复日志条数
+    uint64_t dedup_suppressed = 0;
+    std::vector<SinkStats> sinks;
+
+    /**
+     * 格式化为一行可读的文本，延迟单位为微秒
+     */
+    std::string ToString() const;
+};
+}  // namespace Nlog
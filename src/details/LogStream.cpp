@@ -0,0 +1,454 @@
+#include "LogStream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <ostream>
+
+#include "NumberFormatter.h"
+
+namespace Nlog
+{
+// 默认浮点数精度，与std::ostream一致
+constexpr int kDefaultPrecision = 6;
+// 浮点数格式化的临时缓冲区大小，足够容纳double按%f输出的最大长度，long double超出时按需分配
+constexpr size_t kFloatBufferSize = 320;
+
+LogStream::LogStream(char* buffer, size_t capacity, GrowFunc grow_func, void* grow_context)
+    : base_(10),
+      float_format_(kFixed),
+      flags_(0),
+      buffer_(buffer),
+      cur_(buffer),
+      end_(buffer + capacity),
+      grow_func_(grow_func),
+      grow_context_(grow_context),
+      truncated_bytes_(0)
+{
+}
+
+bool LogStream::Grow(size_t length)
+{
+    if (grow_func_ == nullptr) return false;
+    size_t count = GetCount();
+    size_t capacity = end_ - buffer_;
+    char* buffer = grow_func_(grow_context_, buffer_, count, count + length, capacity);
+    if (buffer == nullptr) return false;
+    buffer_ = buffer;
+    cur_ = buffer + count;
+    end_ = buffer + capacity;
+    return Available() >= length;
+}
+
+void LogStream::AppendSlow(const char* data, size_t length)
+{
+    Grow(length);
+    size_t avail = Available();
+    if (length > avail)
+    {
+        truncated_bytes_ += length - avail;
+        length = avail;
+    }
+    memcpy(cur_, data, length);
+    cur_ += length;
+}
+
+size_t LogStream::Finish()
+{
+    size_t length = GetCount();
+    if (length == 0) return 0;
+
+    if (truncated_bytes_ > 0)
+    {
+        // 用截断标记覆盖文本末尾，被覆盖的字符不计入标记中的字节数
+        char marker[48];
+        size_t marker_length = static_cast<size_t>(
+            snprintf(marker, sizeof(marker), "...[truncated %llu bytes]", static_cast<unsigned long long>(truncated_bytes_)));
+        if (marker_length > static_cast<size_t>(end_ - buffer_)) marker_length = end_ - buffer_;
+        if (length + marker_length > static_cast<size_t>(end_ - buffer_)) length = end_ - buffer_ - marker_length;
+        memcpy(buffer_ + length, marker, marker_length);
+        length += marker_length;
+        cur_ = buffer_ + length;
+    }
+
+    if (buffer_[length - 1] != '\n')
+    {
+        // 已经保证buffer_至少还有kReservedSize个字符的可用空间
+        buffer_[length++] = '\n';
+    }
+    // 确保buffer是一个C风格的字符串，对于某些输出流来说会比较方便使用
+    buffer_[length] = '\0';
+    return length;
+}
+
+LogStream& LogStream::operator<<(bool value)
+{
+    if (flags_ & kBoolAlpha)
+    {
+        if (value)
+            Append("true", 4);
+        else
+            Append("false", 5);
+    }
+    else
+    {
+        Append(value ? '1' : '0');
+    }
+    return *this;
+}
+
+LogStream& LogStream::FormatSigned(long long value, size_t type_size)
+{
+    if (base_ == 10)
+    {
+        if (value < 0)
+        {
+            FormatInteger(0 - static_cast<unsigned long long>(value), true);
+        }
+        else
+        {
+            FormatInteger(static_cast<unsigned long long>(value), false);
+        }
+        return *this;
+    }
+    // 与std::ostream一致，十六进制和八进制按同宽度的无符号数输出
+    return FormatUnsigned(static_cast<unsigned long long>(value), type_size);
+}
+
+LogStream& LogStream::FormatUnsigned(unsigned long long value, size_t type_size)
+{
+    if (type_size < sizeof(value))
+    {
+        value &= (1ULL << (type_size * 8)) - 1;
+    }
+    // 无符号数不受showpos影响
+    uint8_t flags = flags_;
+    flags_ &= ~kShowPos;
+    FormatInteger(value, false);
+    flags_ = flags;
+    return *this;
+}
+
+void LogStream::FormatInteger(unsigned long long abs_value, bool negative)
+{
+    // 最长为64位八进制数加上前缀
+    char digits[32];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+
+    if (base_ == 10)
+    {
+        if (Available() >= NumberFormatter::kMaxUnsignedDigits + 1)
+        {
+            // 空间足够时直接写入缓冲区
+            if (negative)
+                *cur_++ = '-';
+            else if (flags_ & kShowPos)
+                *cur_++ = '+';
+            cur_ += NumberFormatter::FormatUnsigned(abs_value, cur_);
+            return;
+        }
+        p -= NumberFormatter::FormatUnsigned(abs_value, digits);
+        memmove(p, digits, end - p);
+        if (negative)
+            *--p = '-';
+        else if (flags_ & kShowPos)
+            *--p = '+';
+    }
+    else if (base_ == 16)
+    {
+        const char* hex_digits = (flags_ & kUpperCase) ? "0123456789ABCDEF" : "0123456789abcdef";
+        unsigned long long value = abs_value;
+        do
+        {
+            *--p = hex_digits[value & 0xF];
+            value >>= 4;
+        } while (value != 0);
+        if ((flags_ & kShowBase) && abs_value != 0)
+        {
+            *--p = (flags_ & kUpperCase) ? 'X' : 'x';
+            *--p = '0';
+        }
+    }
+    else
+    {
+        unsigned long long value = abs_value;
+        do
+        {
+            *--p = static_cast<char>('0' + (value & 0x7));
+            value >>= 3;
+        } while (value != 0);
+        if ((flags_ & kShowBase) && abs_value != 0)
+        {
+            *--p = '0';
+        }
+    }
+    Append(p, end - p);
+}
+
+// 按printf格式输出浮点数
+template <typename T>
+static int PrintFloat(char* buf, size_t size, char conversion, bool show_pos, int precision, T value)
+{
+    // 格式形如"%+.*Lf"
+    char format[8];
+    char* p = format;
+    *p++ = '%';
+    if (show_pos) *p++ = '+';
+    *p++ = '.';
+    *p++ = '*';
+    if (sizeof(T) > sizeof(double)) *p++ = 'L';
+    *p++ = conversion;
+    *p = '\0';
+    return snprintf(buf, size, format, precision, value);
+}
+
+static inline float ParseFloat(const char* str, float) { return strtof(str, nullptr); }
+static inline double ParseFloat(const char* str, double) { return strtod(str, nullptr); }
+static inline long double ParseFloat(const char* str, long double) { return strtold(str, nullptr); }
+
+// 输出能精确还原成原值的最短十进制表示：从digits10位有效数字开始尝试，最多到max_digits10位。
+// 有效数字不超过digits10位的值，按digits10位舍入得到的就是其最短表示（%g会去掉末尾的0）。
+// 每次尝试都要调用snprintf和strtod，只用于long double，float和double由NumberFormatter::FormatShortest处理
+template <typename T>
+static int PrintShortestFloat(char* buf, size_t size, bool show_pos, bool upper_case, int digits10, int max_digits10,
+                              T value)
+{
+    char conversion = upper_case ? 'G' : 'g';
+    int length = 0;
+    for (int precision = digits10; precision <= max_digits10; ++precision)
+    {
+        length = PrintFloat(buf, size, conversion, show_pos, precision, value);
+        if (length < 0 || static_cast<size_t>(length) >= size || value != value ||
+            ParseFloat(buf, value) == value)
+        {
+            break;
+        }
+    }
+    return length;
+}
+
+template <typename T>
+static int PrintFloatWithFormat(char* buf, size_t size, LogStream::FloatFormat float_format, bool show_pos,
+                                bool upper_case, int digits10, int max_digits10, T value)
+{
+    switch (float_format)
+    {
+        case LogStream::kFixed:
+            return PrintFloat(buf, size, upper_case ? 'F' : 'f', show_pos, kDefaultPrecision, value);
+        case LogStream::kScientific:
+            return PrintFloat(buf, size, upper_case ? 'E' : 'e', show_pos, kDefaultPrecision, value);
+        case LogStream::kHexFloat:
+            // 精度为负数时按%a输出完整精度
+            return PrintFloat(buf, size, upper_case ? 'A' : 'a', show_pos, -1, value);
+        case LogStream::kShortest:
+            break;
+    }
+    return PrintShortestFloat(buf, size, show_pos, upper_case, digits10, max_digits10, value);
+}
+
+// std::fixed默认精度下的快速路径：整数部分直接转十进制，小数部分用128位整数精确舍入（与printf一样四舍六入五成双），
+// 结果与printf("%.6f")完全一致。超出范围或非有限值返回false，由printf处理
+static bool AppendFixedDouble(LogStream& stream, double value, bool show_pos)
+{
+    static_assert(kDefaultPrecision == 6, "fast path assumes 6 fractional digits");
+    constexpr uint64_t kScale = 1000000;
+    // 整数部分需要能用uint64_t表示
+    constexpr double kMaxValue = 9007199254740992.0;  // 2^53
+
+    bool negative = std::signbit(value);
+    double abs_value = negative ? -value : value;
+    if (!(abs_value < kMaxValue)) return false;
+
+    uint64_t int_part = static_cast<uint64_t>(abs_value);
+    // 小于2^53的double减去其整数部分是精确的
+    double frac = abs_value - static_cast<double>(int_part);
+
+    uint64_t frac_digits = 0;
+    if (frac != 0)
+    {
+        int exponent = 0;
+        // frac = mantissa * 2^(exponent - 53)，mantissa为53位整数
+        double normalized = frexp(frac, &exponent);
+        uint64_t mantissa = static_cast<uint64_t>(ldexp(normalized, 53));
+        int shift = 53 - exponent;
+        if (shift < 120)
+        {
+            unsigned __int128 scaled = static_cast<unsigned __int128>(mantissa) * kScale;
+            uint64_t quotient = static_cast<uint64_t>(scaled >> shift);
+            unsigned __int128 remainder = scaled & ((static_cast<unsigned __int128>(1) << shift) - 1);
+            unsigned __int128 half = static_cast<unsigned __int128>(1) << (shift - 1);
+            if (remainder > half || (remainder == half && (quotient & 1)))
+            {
+                ++quotient;
+            }
+            frac_digits = quotient;
+        }
+        // 否则小数部分小于2^-66，舍入后为0
+        if (frac_digits == kScale)
+        {
+            frac_digits = 0;
+            ++int_part;
+        }
+    }
+
+    char buf[NumberFormatter::kMaxUnsignedDigits + 1 + 1 + kDefaultPrecision];
+    char* p = buf;
+    if (negative)
+        *p++ = '-';
+    else if (show_pos)
+        *p++ = '+';
+    p += NumberFormatter::FormatUnsigned(int_part, p);
+    *p++ = '.';
+    NumberFormatter::WritePadded3(static_cast<unsigned>(frac_digits / 1000), p);
+    NumberFormatter::WritePadded3(static_cast<unsigned>(frac_digits % 1000), p + 3);
+    p += kDefaultPrecision;
+    stream.Append(buf, p - buf);
+    return true;
+}
+
+// 输出最短十进制表示，只做一次Grisu2和整数运算，开销固定。非有限值返回false，由printf处理
+template <typename T>
+static bool AppendShortestFloat(LogStream& stream, bool show_pos, bool upper_case, T value)
+{
+    if (!std::isfinite(value)) return false;
+
+    char buf[1 + NumberFormatter::kMaxShortestLength];
+    char* p = buf;
+    if (show_pos && !std::signbit(value)) *p++ = '+';
+    p += NumberFormatter::FormatShortest(value, p, upper_case);
+    stream.Append(buf, p - buf);
+    return true;
+}
+
+template <typename T>
+static void AppendFloat(LogStream& stream, LogStream::FloatFormat float_format, bool show_pos, bool upper_case,
+                        int digits10, int max_digits10, T value)
+{
+    char buf[kFloatBufferSize];
+    int length =
+        PrintFloatWithFormat(buf, sizeof(buf), float_format, show_pos, upper_case, digits10, max_digits10, value);
+    if (length < 0) return;
+    if (static_cast<size_t>(length) < sizeof(buf))
+    {
+        stream.Append(buf, length);
+        return;
+    }
+    // 很大的数按%f输出可能超过临时缓冲区，按需分配
+    std::string large(length + 1, '\0');
+    PrintFloatWithFormat(&large[0], large.size(), float_format, show_pos, upper_case, digits10, max_digits10, value);
+    stream.Append(large.data(), length);
+}
+
+LogStream& LogStream::operator<<(float value)
+{
+    // float转double是精确的，按std::ostream的行为以double输出
+    if (float_format_ == kFixed && AppendFixedDouble(*this, value, flags_ & kShowPos)) return *this;
+    if (float_format_ == kShortest && AppendShortestFloat(*this, flags_ & kShowPos, flags_ & kUpperCase, value))
+    {
+        return *this;
+    }
+    AppendFloat(*this, float_format_, flags_ & kShowPos, flags_ & kUpperCase, 6, 9, value);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(double value)
+{
+    if (float_format_ == kFixed && AppendFixedDouble(*this, value, flags_ & kShowPos)) return *this;
+    if (float_format_ == kShortest && AppendShortestFloat(*this, flags_ & kShowPos, flags_ & kUpperCase, value))
+    {
+        return *this;
+    }
+    AppendFloat(*this, float_format_, flags_ & kShowPos, flags_ & kUpperCase, 15, 17, value);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(long double value)
+{
+    AppendFloat(*this, float_format_, flags_ & kShowPos, flags_ & kUpperCase, 18, 21, value);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const char* value)
+{
+    if (value == nullptr)
+    {
+        Append("(null)", 6);
+    }
+    else
+    {
+        Append(value, strlen(value));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void* value)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(value);
+    if (address == 0)
+    {
+        Append('0');
+        return *this;
+    }
+    // 与std::ostream一致，指针按0x前缀的十六进制输出
+    uint8_t base = base_;
+    uint8_t flags = flags_;
+    base_ = 16;
+    flags_ = kShowBase;
+    FormatInteger(address, false);
+    base_ = base;
+    flags_ = flags;
+    return *this;
+}
+
+LogStream& LogStream::operator<<(std::ostream& (*ostream_fp)(std::ostream&))
+{
+    typedef std::ostream& (*ManipFunc)(std::ostream&);
+    if (ostream_fp == static_cast<ManipFunc>(std::endl))
+    {
+        Append('\n');
+    }
+    else if (ostream_fp == static_cast<ManipFunc>(std::ends))
+    {
+        Append('\0');
+    }
+    // std::flush以及其他操作符没有效果，日志在LogMessage析构时统一输出
+    return *this;
+}
+
+LogStream& LogStream::operator<<(std::ios_base& (*ios_base_fp)(std::ios_base&))
+{
+    if (ios_base_fp == std::dec)
+        base_ = 10;
+    else if (ios_base_fp == std::hex)
+        base_ = 16;
+    else if (ios_base_fp == std::oct)
+        base_ = 8;
+    else if (ios_base_fp == std::fixed)
+        float_format_ = kFixed;
+    else if (ios_base_fp == std::scientific)
+        float_format_ = kScientific;
+    else if (ios_base_fp == std::hexfloat)
+        float_format_ = kHexFloat;
+    else if (ios_base_fp == std::defaultfloat)
+        float_format_ = kShortest;
+    else if (ios_base_fp == std::boolalpha)
+        flags_ |= kBoolAlpha;
+    else if (ios_base_fp == std::noboolalpha)
+        flags_ &= ~kBoolAlpha;
+    else if (ios_base_fp == std::showbase)
+        flags_ |= kShowBase;
+    else if (ios_base_fp == std::noshowbase)
+        flags_ &= ~kShowBase;
+    else if (ios_base_fp == std::showpos)
+        flags_ |= kShowPos;
+    else if (ios_base_fp == std::noshowpos)
+        flags_ &= ~kShowPos;
+    else if (ios_base_fp == std::uppercase)
+        flags_ |= kUpperCase;
+    else if (ios_base_fp == std::nouppercase)
+        flags_ &= ~kUpperCase;
+    return *this;
+}
+}  // namespace Nlog
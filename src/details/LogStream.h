@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ios>
+#include <string>
+
+namespace Nlog
+{
+// 日志文本格式化器，替代std::ostream + std::streambuf
+// 整数直接查表转十进制，浮点数默认按std::fixed输出，std::defaultfloat时输出能精确还原的最短表示，
+// 字符串直接memcpy，没有locale查找、sentry对象和虚函数调用。
+// 缓冲区写满时通过扩容方法换成更大的缓冲区，不能再扩容时丢弃溢出的字符，并在Finish时在文本末尾标记截断
+class LogStream
+{
+  public:
+    enum
+    {
+        // 行内缓冲区的大小，绝大多数日志在这里格式化完成，不需要扩容
+        kInlineSize = 1024,
+        // 单条日志文本的默认最大长度
+        kDefaultMaxSize = 64 * 1024,
+        // 单条日志文本最大长度的上限
+        kMaxSizeLimit = 1024 * 1024,
+        // 缓冲区需要在容量之外预留的空间，用于追加'\n'和'\0'
+        kReservedSize = 2 + 1
+    };
+
+    /**
+     * 扩容方法，把已有的count个字符拷贝到新的缓冲区
+     * @param context 构造时传入的上下文
+     * @param buffer 当前缓冲区
+     * @param count 已有的字符数
+     * @param required 需要的容量
+     * @param capacity 输入当前容量，输出新的容量（可能小于required）
+     * @return 新的缓冲区，大小至少为capacity + kReservedSize，不能扩容时返回nullptr
+     */
+    typedef char* (*GrowFunc)(void* context, const char* buffer, size_t count, size_t required, size_t& capacity);
+
+    // 浮点数输出格式
+    enum FloatFormat : uint8_t
+    {
+        kFixed,       // std::fixed，默认格式
+        kScientific,  // std::scientific
+        kHexFloat,    // std::hexfloat
+        kShortest,    // std::defaultfloat，能精确还原的最短表示
+    };
+
+    /**
+     * @param buffer 缓冲区，由调用方管理，大小至少为capacity + kReservedSize
+     * @param capacity 可写入的文本长度，超出且不能扩容时丢弃溢出的字符
+     * @param grow_func 扩容方法，为nullptr时不扩容
+     * @param grow_context 传给扩容方法的上下文
+     */
+    LogStream(char* buffer, size_t capacity, GrowFunc grow_func = nullptr, void* grow_context = nullptr);
+
+    // noncopyable
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
+
+    /**
+     * 追加文本，缓冲区满时先扩容，不能扩容时丢弃溢出的字符
+     * @param data 文本
+     * @param length 文本长度
+     */
+    inline void Append(const char* data, size_t length)
+    {
+        if (length > Available())
+        {
+            AppendSlow(data, length);
+            return;
+        }
+        memcpy(cur_, data, length);
+        cur_ += length;
+    }
+
+    inline void Append(char c)
+    {
+        if (cur_ < end_ || Grow(1))
+        {
+            *cur_++ = c;
+        }
+        else
+        {
+            ++truncated_bytes_;
+        }
+    }
+
+    LogStream& operator<<(bool value);
+    LogStream& operator<<(char value)
+    {
+        Append(value);
+        return *this;
+    }
+    LogStream& operator<<(signed short value) { return FormatSigned(value, sizeof(value)); }
+    LogStream& operator<<(unsigned short value) { return FormatUnsigned(value, sizeof(value)); }
+    LogStream& operator<<(signed int value) { return FormatSigned(value, sizeof(value)); }
+    LogStream& operator<<(unsigned int value) { return FormatUnsigned(value, sizeof(value)); }
+    LogStream& operator<<(signed long value) { return FormatSigned(value, sizeof(value)); }
+    LogStream& operator<<(unsigned long value) { return FormatUnsigned(value, sizeof(value)); }
+    LogStream& operator<<(signed long long value) { return FormatSigned(value, sizeof(value)); }
+    LogStream& operator<<(unsigned long long value) { return FormatUnsigned(value, sizeof(value)); }
+    LogStream& operator<<(float value);
+    LogStream& operator<<(double value);
+    LogStream& operator<<(long double value);
+    LogStream& operator<<(const char* value);
+    LogStream& operator<<(const void* value);
+    LogStream& operator<<(const std::string& value)
+    {
+        Append(value.data(), value.size());
+        return *this;
+    }
+
+    // 支持std::endl、std::ends、std::flush
+    LogStream& operator<<(std::ostream& (*ostream_fp)(std::ostream&));
+    // 支持std::dec/hex/oct、std::fixed/scientific/defaultfloat/hexfloat、std::boolalpha、std::showbase、
+    // std::showpos、std::uppercase以及对应的no*版本
+    LogStream& operator<<(std::ios_base& (*ios_base_fp)(std::ios_base&));
+
+    /**
+     * 获取缓存区
+     * @return 缓冲区起始地址
+     */
+    const char* GetBuffer() const { return buffer_; }
+
+    /**
+     * 获取buffer的已用空间大小
+     * @return buffer的已用空间大小
+     */
+    size_t GetCount() const { return cur_ - buffer_; }
+
+    /**
+     * 获取因超过最大长度被丢弃的字符数
+     */
+    size_t GetTruncatedBytes() const { return truncated_bytes_; }
+
+    /**
+     * 结束输出：确保文本以'\n'结尾，并追加'\0'。有字符被丢弃时，文本末尾替换为"...[truncated N bytes]"
+     * @return 日志文本长度（包含'\n'，不包含'\0'）
+     */
+    size_t Finish();
+
+  private:
+    size_t Available() const { return end_ - cur_; }
+
+    /**
+     * 扩容到至少还能写入length个字符
+     * @return 扩容后空间足够时返回true
+     */
+    bool Grow(size_t length);
+
+    // 空间不足时追加文本：先扩容，仍然放不下的部分丢弃
+    void AppendSlow(const char* data, size_t length);
+
+    LogStream& FormatSigned(long long value, size_t type_size);
+    LogStream& FormatUnsigned(unsigned long long value, size_t type_size);
+    // 按当前进制输出，十进制以外的进制不区分正负
+    void FormatInteger(unsigned long long abs_value, bool negative);
+
+    enum Flag : uint8_t
+    {
+        kBoolAlpha = 1 << 0,
+        kShowBase = 1 << 1,
+        kShowPos = 1 << 2,
+        kUpperCase = 1 << 3,
+    };
+
+    // 当前整数输出进制
+    uint8_t base_;
+    // 当前浮点数输出格式
+    FloatFormat float_format_;
+    // 其他格式标志位
+    uint8_t flags_;
+    char* buffer_;
+    char* cur_;
+    char* end_;
+    // 扩容方法和上下文
+    GrowFunc grow_func_;
+    void* grow_context_;
+    // 被丢弃的字符数
+    size_t truncated_bytes_;
+};
+}  // namespace Nlog
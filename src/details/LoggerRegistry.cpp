@@ -0,0 +1,212 @@
+#include "LoggerRegistry.h"
+
+namespace Nlog
+{
+// hazard槽位的数量，即可以同时无锁读取注册表的线程数，超出的线程退化为加锁读取
+constexpr size_t kMaxHazardSlots = 256;
+constexpr size_t kCacheLineSize = 64;
+
+// 每个槽位独占一个cache line，避免不同线程发布hazard pointer时互相干扰
+struct HazardSlot
+{
+    std::atomic<const void*> pointer;
+    std::atomic<bool> owned;
+    char padding[kCacheLineSize - sizeof(std::atomic<const void*>) - sizeof(std::atomic<bool>)];
+};
+
+static HazardSlot g_hazard_slots[kMaxHazardSlots];
+
+// 本线程读取注册表的状态。没有析构函数，线程退出过程中（其他thread_local析构时）仍然可以访问
+struct ThreadHazardState
+{
+    // 本线程占用的槽位，没有可用槽位或者已经归还时为空
+    HazardSlot* slot;
+    // 是否已经尝试过占用槽位
+    bool acquired;
+    // 嵌套的快照层数，只有最外层的快照发布hazard pointer，内层快照沿用最外层读到的列表
+    uint32_t depth;
+    const LoggerRegistry* registry;
+    const void* list;
+};
+
+static thread_local ThreadHazardState t_hazard_state;
+
+// 线程第一次读取注册表时占用一个槽位，线程退出时归还，归还之后的读取退化为加锁读取
+class ThreadHazardSlot
+{
+  public:
+    ThreadHazardSlot()
+    {
+        for (size_t i = 0; i < kMaxHazardSlots; ++i)
+        {
+            bool expected = false;
+            if (!g_hazard_slots[i].owned.load(std::memory_order_relaxed) &&
+                g_hazard_slots[i].owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                t_hazard_state.slot = &g_hazard_slots[i];
+                break;
+            }
+        }
+    }
+
+    ~ThreadHazardSlot()
+    {
+        HazardSlot* slot = t_hazard_state.slot;
+        t_hazard_state.slot = nullptr;
+        if (slot != nullptr)
+        {
+            slot->pointer.store(nullptr, std::memory_order_release);
+            slot->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static HazardSlot* GetThreadHazardSlot()
+{
+    if (!t_hazard_state.acquired)
+    {
+        t_hazard_state.acquired = true;
+        static thread_local ThreadHazardSlot slot;
+        (void)slot;
+    }
+    return t_hazard_state.slot;
+}
+
+LoggerRegistry::Snapshot::Snapshot(const LoggerRegistry& registry) : hazard_(nullptr), list_(nullptr)
+{
+    ThreadHazardState& state = t_hazard_state;
+    if (state.depth > 0 && state.registry == &registry)
+    {
+        // 在输出日志的过程中再次读取（如后端的回调函数中打印日志），外层快照保护的列表在本快照析构前一直有效，
+        // 不能覆盖外层的hazard pointer，也不能再次加锁
+        ++state.depth;
+        list_ = static_cast<const LoggerList*>(state.list);
+        return;
+    }
+
+    HazardSlot* slot = state.depth == 0 ? GetThreadHazardSlot() : nullptr;
+    if (slot == nullptr)
+    {
+        fallback_lock_ = std::unique_lock<std::mutex>(registry.write_mutex_);
+        list_ = registry.current_.load(std::memory_order_acquire);
+    }
+    else
+    {
+        // 发布hazard pointer后再次确认快照没有被替换，保证写线程回收时能看到本线程正在读
+        hazard_ = &slot->pointer;
+        const LoggerList* list = registry.current_.load(std::memory_order_acquire);
+        for (;;)
+        {
+            hazard_->store(list, std::memory_order_seq_cst);
+            const LoggerList* current = registry.current_.load(std::memory_order_seq_cst);
+            if (current == list) break;
+            list = current;
+        }
+        list_ = list;
+    }
+
+    if (state.depth++ == 0)
+    {
+        state.registry = &registry;
+        state.list = list_;
+    }
+}
+
+LoggerRegistry::Snapshot::~Snapshot()
+{
+    ThreadHazardState& state = t_hazard_state;
+    if (--state.depth == 0)
+    {
+        state.registry = nullptr;
+        state.list = nullptr;
+    }
+    if (hazard_ != nullptr)
+    {
+        hazard_->store(nullptr, std::memory_order_release);
+    }
+}
+
+LoggerRegistry::LoggerRegistry() : current_(new LoggerList()) {}
+
+LoggerRegistry::~LoggerRegistry()
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    delete current_.load();
+    for (const LoggerList* list : retired_)
+    {
+        delete list;
+    }
+}
+
+bool LoggerRegistry::Add(const LoggerPtr& logger)
+{
+    if (logger == nullptr) return false;
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const LoggerList* list = current_.load(std::memory_order_relaxed);
+    for (auto& registered_logger : *list)
+    {
+        if (registered_logger->GetName() == logger->GetName())
+        {
+            return false;
+        }
+    }
+
+    LoggerList* new_list = new LoggerList(*list);
+    new_list->push_back(logger);
+    Publish(new_list);
+    return true;
+}
+
+bool LoggerRegistry::Remove(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const LoggerList* list = current_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < list->size(); i++)
+    {
+        if ((*list)[i]->GetName() == name)
+        {
+            LoggerList* new_list = new LoggerList(*list);
+            // 交换当前的Logger和最后的Logger
+            (*new_list)[i] = new_list->back();
+            new_list->pop_back();
+            Publish(new_list);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LoggerRegistry::Publish(const LoggerList* list)
+{
+    const LoggerList* old_list = current_.exchange(list, std::memory_order_seq_cst);
+    retired_.push_back(old_list);
+    ReclaimRetired();
+}
+
+void LoggerRegistry::Reclaim()
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    ReclaimRetired();
+}
+
+void LoggerRegistry::ReclaimRetired()
+{
+    if (retired_.empty()) return;
+
+    std::vector<const LoggerList*> remaining;
+    for (const LoggerList* retired_list : retired_)
+    {
+        bool in_use = false;
+        for (size_t i = 0; i < kMaxHazardSlots && !in_use; ++i)
+        {
+            in_use = g_hazard_slots[i].pointer.load(std::memory_order_seq_cst) == retired_list;
+        }
+        if (in_use)
+            remaining.push_back(retired_list);
+        else
+            delete retired_list;
+    }
+    retired_.swap(remaining);
+}
+}  // namespace Nlog
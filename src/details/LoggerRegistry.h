@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../loggers/Logger.h"
+
+namespace Nlog
+{
+// 线程安全的日志输出后端注册表
+// 当前的日志输出后端列表是一个不可变的快照，通过原子指针发布。增删后端时拷贝出新的列表再替换指针（写时复制），
+// 旧列表用hazard pointer保护，确认没有线程在读之后才释放。读取路径只有一次原子读和一次写本线程的hazard槽位，没有锁
+class LoggerRegistry
+{
+  public:
+    typedef std::vector<LoggerPtr> LoggerList;
+
+    // 读取注册表时持有的快照，析构前快照中的后端不会被释放
+    class Snapshot
+    {
+      public:
+        explicit Snapshot(const LoggerRegistry& registry);
+        ~Snapshot();
+
+        // noncopyable
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        LoggerList::const_iterator begin() const { return list_->begin(); }
+        LoggerList::const_iterator end() const { return list_->end(); }
+
+      private:
+        // 本线程的hazard槽位，没有可用槽位时为空，此时退化为加锁读取。嵌套的快照沿用最外层快照的列表，
+        // 既不发布hazard pointer也不加锁
+        std::atomic<const void*>* hazard_;
+        std::unique_lock<std::mutex> fallback_lock_;
+        const LoggerList* list_;
+    };
+
+    LoggerRegistry();
+    ~LoggerRegistry();
+
+    // noncopyable
+    LoggerRegistry(const LoggerRegistry&) = delete;
+    LoggerRegistry& operator=(const LoggerRegistry&) = delete;
+
+    /**
+     * 增加日志输出后端，名字重复时失败
+     * @param logger 日志输出后端
+     * @return true表示添加成功，false表示添加失败
+     */
+    bool Add(const LoggerPtr& logger);
+
+    /**
+     * 通过名字移除日志输出后端
+     * @param name 日志输出后端名称
+     * @return true表示移除成功，false移除失败
+     */
+    bool Remove(const std::string& name);
+
+    /**
+     * 释放已经没有线程在读的旧快照
+     */
+    void Reclaim();
+
+  private:
+    // 发布新的快照，调用方需要持有write_mutex_
+    void Publish(const LoggerList* list);
+
+    // 释放已经没有线程在读的旧快照，调用方需要持有write_mutex_
+    void ReclaimRetired();
+
+    std::atomic<const LoggerList*> current_;
+    // 串行化写操作，同时用于没有hazard槽位时的读取
+    mutable std::mutex write_mutex_;
+    // 已经被替换下来、等待释放的快照
+    std::vector<const LoggerList*> retired_;
+};
+}  // namespace Nlog
@@ -14,6 +14,5 @@ class Logging
   public:
   private:
     LogSeverity log_severity_ = LogSeverity::DEBUG;
-    std::unique_ptr<>
 };
 }  // namespace Nlog
\ No newline at end of file
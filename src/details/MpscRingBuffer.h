@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Nlog
+{
+// 有界无锁多生产者单消费者环形队列（Dmitry Vyukov的bounded queue算法）
+// 所有槽位在构造时一次性分配，生产者通过CAS抢占写入位置，每个槽位用序号标识可读/可写状态
+template <typename T>
+class MpscRingBuffer
+{
+  public:
+    /**
+     * @param capacity 队列容量，向上取整为2的幂
+     */
+    explicit MpscRingBuffer(size_t capacity)
+        : capacity_(RoundUpPowerOfTwo(capacity)), mask_(capacity_ - 1), cells_(new Cell[capacity_]),
+          enqueue_pos_(0), dequeue_pos_(0)
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // noncopyable
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    /**
+     * 尝试写入一个元素，writer直接在槽位上填充数据，避免额外拷贝
+     * @param writer 形如void(T&)的可调用对象
+     * @return 队列已满返回false
+     */
+    template <typename Writer>
+    bool TryPush(Writer&& writer)
+    {
+        Cell* cell = nullptr;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                // 槽位还没被消费者读走，队列已满
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        writer(cell->data);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 尝试读出一个元素，只能由唯一的消费者线程调用
+     * @param reader 形如void(const T&)的可调用对象
+     * @return 队列为空（或队首元素还没写完）返回false
+     */
+    template <typename Reader>
+    bool TryPop(Reader&& reader)
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell = &cells_[pos & mask_];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+        {
+            return false;
+        }
+        reader(static_cast<const T&>(cell->data));
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * 队列中的元素个数（近似值，仅用于统计）
+     */
+    size_t Size() const
+    {
+        size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+    size_t Capacity() const { return capacity_; }
+
+    /**
+     * 释放所有槽位，之后只能调用Size()和Capacity()。调用方需要保证队列为空且没有线程再读写
+     */
+    void ReleaseCells() { cells_.reset(); }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static size_t RoundUpPowerOfTwo(size_t n)
+    {
+        size_t capacity = 2;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+    enum
+    {
+        kCacheLineSize = 64
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    // 生产者和消费者的位置分开放在不同的cache line，避免伪共享
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[kCacheLineSize];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[kCacheLineSize];
+};
+}  // namespace Nlog
@@ -0,0 +1,367 @@
+#include "NumberFormatter.h"
+
+#include <cmath>
+#include <limits>
+
+namespace Nlog
+{
+namespace NumberFormatter
+{
+const char kDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// 以下为Grisu2算法（Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"）。
+// 把原值和前后相邻浮点数的中点乘上一个缓存的10的幂，使其落在固定的二进制指数范围内，
+// 在中点之间的区间里逐位生成尽量少的十进制数字，全程只用64位整数运算
+
+// 浮点数f * 2^e，f不带符号
+struct DiyFp
+{
+    uint64_t f;
+    int e;
+};
+
+static inline DiyFp Multiply(const DiyFp& x, const DiyFp& y)
+{
+    unsigned __int128 product = static_cast<unsigned __int128>(x.f) * y.f;
+    uint64_t high = static_cast<uint64_t>(product >> 64);
+    uint64_t low = static_cast<uint64_t>(product);
+    // 舍入到高64位
+    return DiyFp{high + (low >> 63), x.e + y.e + 64};
+}
+
+static inline DiyFp Normalize(const DiyFp& x)
+{
+    int shift = __builtin_clzll(x.f);
+    return DiyFp{x.f << shift, x.e - shift};
+}
+
+// 原值和前后两个中点，三者的二进制指数相同
+struct Boundaries
+{
+    DiyFp w;
+    DiyFp minus;
+    DiyFp plus;
+};
+
+template <typename Float, typename Bits>
+static Boundaries ComputeBoundaries(Float value)
+{
+    constexpr int kPrecision = std::numeric_limits<Float>::digits;
+    constexpr int kBias = std::numeric_limits<Float>::max_exponent - 1 + (kPrecision - 1);
+    constexpr int kMinExponent = 1 - kBias;
+    constexpr uint64_t kHiddenBit = static_cast<uint64_t>(1) << (kPrecision - 1);
+
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t biased_exponent = bits >> (kPrecision - 1);
+    uint64_t fraction = bits & (kHiddenBit - 1);
+
+    DiyFp v = biased_exponent == 0 ? DiyFp{fraction, kMinExponent}
+                                   : DiyFp{fraction + kHiddenBit, static_cast<int>(biased_exponent) - kBias};
+    // 尾数为2的幂时与前一个浮点数的距离只有一半
+    bool lower_boundary_is_closer = fraction == 0 && biased_exponent > 1;
+    DiyFp plus = Normalize(DiyFp{2 * v.f + 1, v.e - 1});
+    DiyFp minus = lower_boundary_is_closer ? DiyFp{4 * v.f - 1, v.e - 2} : DiyFp{2 * v.f - 1, v.e - 1};
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    return Boundaries{Normalize(v), minus, plus};
+}
+
+// 10^k的近似值f * 2^e
+struct CachedPower
+{
+    uint64_t f;
+    int e;
+    int k;
+};
+
+// 乘上缓存的幂之后二进制指数的范围
+constexpr int kAlpha = -60;
+constexpr int kGamma = -32;
+constexpr int kCachedPowersMinDecExp = -300;
+constexpr int kCachedPowersDecStep = 8;
+
+// 10^-300到10^324，步长8
+static const CachedPower kCachedPowers[] = {
+    {0xAB70FE17C79AC6CAULL, -1060, -300},
+    {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+    {0xBE5691EF416BD60CULL, -1007, -284},
+    {0x8DD01FAD907FFC3CULL, -980, -276},
+    {0xD3515C2831559A83ULL, -954, -268},
+    {0x9D71AC8FADA6C9B5ULL, -927, -260},
+    {0xEA9C227723EE8BCBULL, -901, -252},
+    {0xAECC49914078536DULL, -874, -244},
+    {0x823C12795DB6CE57ULL, -847, -236},
+    {0xC21094364DFB5637ULL, -821, -228},
+    {0x9096EA6F3848984FULL, -794, -220},
+    {0xD77485CB25823AC7ULL, -768, -212},
+    {0xA086CFCD97BF97F4ULL, -741, -204},
+    {0xEF340A98172AACE5ULL, -715, -196},
+    {0xB23867FB2A35B28EULL, -688, -188},
+    {0x84C8D4DFD2C63F3BULL, -661, -180},
+    {0xC5DD44271AD3CDBAULL, -635, -172},
+    {0x936B9FCEBB25C996ULL, -608, -164},
+    {0xDBAC6C247D62A584ULL, -582, -156},
+    {0xA3AB66580D5FDAF6ULL, -555, -148},
+    {0xF3E2F893DEC3F126ULL, -529, -140},
+    {0xB5B5ADA8AAFF80B8ULL, -502, -132},
+    {0x87625F056C7C4A8BULL, -475, -124},
+    {0xC9BCFF6034C13053ULL, -449, -116},
+    {0x964E858C91BA2655ULL, -422, -108},
+    {0xDFF9772470297EBDULL, -396, -100},
+    {0xA6DFBD9FB8E5B88FULL, -369, -92},
+    {0xF8A95FCF88747D94ULL, -343, -84},
+    {0xB94470938FA89BCFULL, -316, -76},
+    {0x8A08F0F8BF0F156BULL, -289, -68},
+    {0xCDB02555653131B6ULL, -263, -60},
+    {0x993FE2C6D07B7FACULL, -236, -52},
+    {0xE45C10C42A2B3B06ULL, -210, -44},
+    {0xAA242499697392D3ULL, -183, -36},
+    {0xFD87B5F28300CA0EULL, -157, -28},
+    {0xBCE5086492111AEBULL, -130, -20},
+    {0x8CBCCC096F5088CCULL, -103, -12},
+    {0xD1B71758E219652CULL, -77, -4},
+    {0x9C40000000000000ULL, -50, 4},
+    {0xE8D4A51000000000ULL, -24, 12},
+    {0xAD78EBC5AC620000ULL, 3, 20},
+    {0x813F3978F8940984ULL, 30, 28},
+    {0xC097CE7BC90715B3ULL, 56, 36},
+    {0x8F7E32CE7BEA5C70ULL, 83, 44},
+    {0xD5D238A4ABE98068ULL, 109, 52},
+    {0x9F4F2726179A2245ULL, 136, 60},
+    {0xED63A231D4C4FB27ULL, 162, 68},
+    {0xB0DE65388CC8ADA8ULL, 189, 76},
+    {0x83C7088E1AAB65DBULL, 216, 84},
+    {0xC45D1DF942711D9AULL, 242, 92},
+    {0x924D692CA61BE758ULL, 269, 100},
+    {0xDA01EE641A708DEAULL, 295, 108},
+    {0xA26DA3999AEF774AULL, 322, 116},
+    {0xF209787BB47D6B85ULL, 348, 124},
+    {0xB454E4A179DD1877ULL, 375, 132},
+    {0x865B86925B9BC5C2ULL, 402, 140},
+    {0xC83553C5C8965D3DULL, 428, 148},
+    {0x952AB45CFA97A0B3ULL, 455, 156},
+    {0xDE469FBD99A05FE3ULL, 481, 164},
+    {0xA59BC234DB398C25ULL, 508, 172},
+    {0xF6C69A72A3989F5CULL, 534, 180},
+    {0xB7DCBF5354E9BECEULL, 561, 188},
+    {0x88FCF317F22241E2ULL, 588, 196},
+    {0xCC20CE9BD35C78A5ULL, 614, 204},
+    {0x98165AF37B2153DFULL, 641, 212},
+    {0xE2A0B5DC971F303AULL, 667, 220},
+    {0xA8D9D1535CE3B396ULL, 694, 228},
+    {0xFB9B7CD9A4A7443CULL, 720, 236},
+    {0xBB764C4CA7A44410ULL, 747, 244},
+    {0x8BAB8EEFB6409C1AULL, 774, 252},
+    {0xD01FEF10A657842CULL, 800, 260},
+    {0x9B10A4E5E9913129ULL, 827, 268},
+    {0xE7109BFBA19C0C9DULL, 853, 276},
+    {0xAC2820D9623BF429ULL, 880, 284},
+    {0x80444B5E7AA7CF85ULL, 907, 292},
+    {0xBF21E44003ACDD2DULL, 933, 300},
+    {0x8E679C2F5E44FF8FULL, 960, 308},
+    {0xD433179D9C8CB841ULL, 986, 316},
+    {0x9E19DB92B4E31BA9ULL, 1013, 324},
+};
+
+// 选择缓存的幂c，使c * 2^e的二进制指数落在[kAlpha, kGamma]之间
+static inline const CachedPower& GetCachedPower(int e)
+{
+    int f = kAlpha - e - 1;
+    // 78913 / 2^18约等于log10(2)
+    int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+    int index = (-kCachedPowersMinDecExp + k + (kCachedPowersDecStep - 1)) / kCachedPowersDecStep;
+    return kCachedPowers[index];
+}
+
+// 不超过n的最大的10的幂，返回其位数
+static inline int FindLargestPow10(uint32_t n, uint32_t& pow10)
+{
+    static const uint32_t kPowers[] = {1,      10,      100,      1000,      10000,
+                                       100000, 1000000, 10000000, 100000000, 1000000000};
+    int digits = 10;
+    while (digits > 1 && n < kPowers[digits - 1]) --digits;
+    pow10 = kPowers[digits - 1];
+    return digits;
+}
+
+// 区间允许时把最后一位向原值靠近
+static inline void RoundWeed(char* digits, size_t length, uint64_t distance, uint64_t delta, uint64_t rest,
+                             uint64_t ten_k)
+{
+    while (rest < distance && delta - rest >= ten_k &&
+           (rest + ten_k < distance || distance - rest > rest + ten_k - distance))
+    {
+        --digits[length - 1];
+        rest += ten_k;
+    }
+}
+
+// 在(minus, plus)之间生成尽量少的数字，w为原值
+static size_t GenerateDigits(char* digits, int& exponent, const DiyFp& minus, const DiyFp& w, const DiyFp& plus)
+{
+    uint64_t delta = plus.f - minus.f;
+    uint64_t distance = plus.f - w.f;
+    int shift = -plus.e;
+    uint64_t one = static_cast<uint64_t>(1) << shift;
+
+    // plus = p1 + p2 * 2^e，先生成整数部分
+    uint32_t p1 = static_cast<uint32_t>(plus.f >> shift);
+    uint64_t p2 = plus.f & (one - 1);
+    size_t length = 0;
+
+    uint32_t pow10 = 0;
+    int n = FindLargestPow10(p1, pow10);
+    while (n > 0)
+    {
+        digits[length++] = static_cast<char>('0' + p1 / pow10);
+        p1 %= pow10;
+        --n;
+        uint64_t rest = (static_cast<uint64_t>(p1) << shift) + p2;
+        if (rest <= delta)
+        {
+            exponent += n;
+            RoundWeed(digits, length, distance, delta, rest, static_cast<uint64_t>(pow10) << shift);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    // 再生成小数部分
+    int m = 0;
+    for (;;)
+    {
+        p2 *= 10;
+        digits[length++] = static_cast<char>('0' + (p2 >> shift));
+        p2 &= one - 1;
+        ++m;
+        delta *= 10;
+        distance *= 10;
+        if (p2 <= delta) break;
+    }
+    exponent -= m;
+    RoundWeed(digits, length, distance, delta, p2, one);
+    return length;
+}
+
+static size_t Grisu2(const Boundaries& boundaries, char* digits, int& exponent)
+{
+    const CachedPower& cached = GetCachedPower(boundaries.plus.e);
+    DiyFp c{cached.f, cached.e};
+    DiyFp w = Multiply(boundaries.w, c);
+    DiyFp minus = Multiply(boundaries.minus, c);
+    DiyFp plus = Multiply(boundaries.plus, c);
+    // 乘法有误差，区间向内收缩1保证结果仍在中点之间
+    ++minus.f;
+    --plus.f;
+    exponent = -cached.k;
+    return GenerateDigits(digits, exponent, minus, w, plus);
+}
+
+size_t ShortestDigits(double value, char* digits, int& exponent)
+{
+    return Grisu2(ComputeBoundaries<double, uint64_t>(value), digits, exponent);
+}
+
+size_t ShortestDigits(float value, char* digits, int& exponent)
+{
+    return Grisu2(ComputeBoundaries<float, uint32_t>(value), digits, exponent);
+}
+
+template <typename Float>
+static size_t FormatShortestImpl(Float value, char* buf, bool upper_case)
+{
+    char* p = buf;
+    if (std::signbit(value))
+    {
+        *p++ = '-';
+        value = -value;
+    }
+    if (value == 0)
+    {
+        *p++ = '0';
+        return p - buf;
+    }
+
+    char digits[kMaxShortestDigits];
+    int exponent = 0;
+    int length = static_cast<int>(ShortestDigits(value, digits, exponent));
+    while (length > 1 && digits[length - 1] == '0')
+    {
+        --length;
+        ++exponent;
+    }
+    // 科学计数法下的指数
+    int sci_exponent = exponent + length - 1;
+    int digits10 = std::numeric_limits<Float>::digits10;
+    int precision = length > digits10 ? length : digits10;
+
+    if (sci_exponent < -4 || sci_exponent >= precision)
+    {
+        *p++ = digits[0];
+        if (length > 1)
+        {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        *p++ = upper_case ? 'E' : 'e';
+        *p++ = sci_exponent < 0 ? '-' : '+';
+        unsigned abs_exponent = static_cast<unsigned>(sci_exponent < 0 ? -sci_exponent : sci_exponent);
+        if (abs_exponent >= 100)
+        {
+            WritePadded3(abs_exponent, p);
+            p += 3;
+        }
+        else
+        {
+            WritePadded2(abs_exponent, p);
+            p += 2;
+        }
+    }
+    else if (sci_exponent < 0)
+    {
+        // 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -sci_exponent - 1);
+        p += -sci_exponent - 1;
+        memcpy(p, digits, length);
+        p += length;
+    }
+    else if (exponent >= 0)
+    {
+        // 整数，末尾补0
+        memcpy(p, digits, length);
+        p += length;
+        memset(p, '0', exponent);
+        p += exponent;
+    }
+    else
+    {
+        // ddd.ddd
+        int int_digits = sci_exponent + 1;
+        memcpy(p, digits, int_digits);
+        p += int_digits;
+        *p++ = '.';
+        memcpy(p, digits + int_digits, length - int_digits);
+        p += length - int_digits;
+    }
+    return p - buf;
+}
+
+size_t FormatShortest(double value, char* buf, bool upper_case) { return FormatShortestImpl(value, buf, upper_case); }
+
+size_t FormatShortest(float value, char* buf, bool upper_case) { return FormatShortestImpl(value, buf, upper_case); }
+}  // namespace NumberFormatter
+}  // namespace Nlog
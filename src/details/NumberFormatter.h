@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace Nlog
+{
+// 整数转十进制字符串的辅助函数，不依赖iostream和locale
+namespace NumberFormatter
+{
+// 00~99的两位数字表，每次查表输出两位
+extern const char kDigitPairs[201];
+
+// 无符号整数转十进制最多需要的字符数
+constexpr size_t kMaxUnsignedDigits = 20;
+
+/**
+ * 输出固定两位的十进制数（不足补0）
+ * @param value 0~99
+ * @param buf 至少2个字符的空间
+ */
+inline void WritePadded2(unsigned value, char* buf) { memcpy(buf, kDigitPairs + value * 2, 2); }
+
+/**
+ * 输出固定三位的十进制数（不足补0）
+ * @param value 0~999
+ * @param buf 至少3个字符的空间
+ */
+inline void WritePadded3(unsigned value, char* buf)
+{
+    buf[0] = static_cast<char>('0' + value / 100);
+    WritePadded2(value % 100, buf + 1);
+}
+
+/**
+ * 输出固定四位的十进制数（不足补0）
+ * @param value 0~9999
+ * @param buf 至少4个字符的空间
+ */
+inline void WritePadded4(unsigned value, char* buf)
+{
+    WritePadded2(value / 100, buf);
+    WritePadded2(value % 100, buf + 2);
+}
+
+/**
+ * 无符号整数转十进制，每次处理两位
+ * @param value 整数
+ * @param buf 至少kMaxUnsignedDigits个字符的空间
+ * @return 输出的字符数
+ */
+inline size_t FormatUnsigned(uint64_t value, char* buf)
+{
+    char tmp[kMaxUnsignedDigits];
+    char* end = tmp + kMaxUnsignedDigits;
+    char* p = end;
+    while (value >= 100)
+    {
+        unsigned index = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, kDigitPairs + index, 2);
+    }
+    if (value < 10)
+    {
+        *--p = static_cast<char>('0' + value);
+    }
+    else
+    {
+        p -= 2;
+        memcpy(p, kDigitPairs + value * 2, 2);
+    }
+    size_t length = end - p;
+    memcpy(buf, p, length);
+    return length;
+}
+
+/**
+ * 有符号整数转十进制
+ * @param value 整数
+ * @param buf 至少kMaxUnsignedDigits + 1个字符的空间
+ * @return 输出的字符数
+ */
+inline size_t FormatSigned(int64_t value, char* buf)
+{
+    if (value < 0)
+    {
+        *buf = '-';
+        // 先转成无符号再取反，避免INT64_MIN取反溢出
+        return 1 + FormatUnsigned(0 - static_cast<uint64_t>(value), buf + 1);
+    }
+    return FormatUnsigned(static_cast<uint64_t>(value), buf);
+}
+
+// 浮点数最短十进制表示最多的有效数字位数
+constexpr size_t kMaxShortestDigits = 17;
+
+/**
+ * 计算能精确还原成原值的最短十进制有效数字（Grisu2算法，固定开销，不调用printf和strtod），
+ * 结果为digits * 10^exponent。极少数情况下（约万分之五）比真正的最短表示多几位，但一定能精确还原
+ * @param value 有限的正数
+ * @param digits 至少kMaxShortestDigits个字符的空间，输出不带前导0和末尾0的有效数字
+ * @param exponent 输出十进制指数
+ * @return 有效数字的位数
+ */
+size_t ShortestDigits(double value, char* digits, int& exponent);
+
+/**
+ * 按float的精度计算最短十进制有效数字，参数同上
+ */
+size_t ShortestDigits(float value, char* digits, int& exponent);
+
+// FormatShortest最多输出的字符数
+constexpr size_t kMaxShortestLength = 32;
+
+/**
+ * 按%g的格式输出能精确还原成原值的最短十进制表示：有效数字位数取digits10和实际位数中较大的一个作为%g的精度，
+ * 十进制指数小于-4或者不小于该精度时按科学计数法输出
+ * @param value 有限的浮点数
+ * @param buf 至少kMaxShortestLength个字符的空间
+ * @param upper_case 科学计数法是否用大写的E
+ * @return 输出的字符数
+ */
+size_t FormatShortest(double value, char* buf, bool upper_case = false);
+
+/**
+ * 按float的精度输出，参数同上
+ */
+size_t FormatShortest(float value, char* buf, bool upper_case = false);
+}  // namespace NumberFormatter
+}  // namespace Nlog
@@ -2,9 +2,9 @@
 
 namespace Nlog
 {
-PeriodicWorker::PeriodicWorker(const std::function<void()>& callback_func, std::chrono::seconds interval)
+PeriodicWorker::PeriodicWorker(const std::function<void()>& callback_func, std::chrono::milliseconds interval)
 {
-   active_ = (interval > std::chrono::seconds::zero());
+   active_ = (interval > std::chrono::milliseconds::zero());
 
    if(!active_) return;
 
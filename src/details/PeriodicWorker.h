@@ -11,7 +11,7 @@ namespace Nlog
 class PeriodicWorker
 {
   public:
-    PeriodicWorker(const std::function<void()>& callback_func, std::chrono::seconds interval);
+    PeriodicWorker(const std::function<void()>& callback_func, std::chrono::milliseconds interval);
     PeriodicWorker(const PeriodicWorker&) = delete;
     PeriodicWorker& operator=(const PeriodicWorker&) = delete;
     ~PeriodicWorker();
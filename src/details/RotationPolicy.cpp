@@ -0,0 +1,93 @@
+#include "RotationPolicy.h"
+
+#include <algorithm>
+
+namespace Nlog
+{
+constexpr size_t RotationPolicy::kDefaultMaxFileSize;
+constexpr int RotationPolicy::kDefaultIntervalMinutes;
+constexpr time_t RotationPolicy::kNever;
+constexpr size_t RotationPolicy::kUnlimitedSize;
+// 一天的分钟数
+constexpr int kMinutesPerDay = 24 * 60;
+
+// 获取day所在的那一天0点之后第minutes分钟的时间戳，minutes可以超过一天
+static time_t MakeLocalTime(const tm& day, int minutes)
+{
+    tm ltm = {0};
+    ltm.tm_year = day.tm_year;
+    ltm.tm_mon = day.tm_mon;
+    ltm.tm_mday = day.tm_mday;
+    ltm.tm_min = minutes;
+    // 由mktime判断是否是夏令时
+    ltm.tm_isdst = -1;
+    return mktime(&ltm);
+}
+
+RotationPolicy::RotationPolicy()
+    : max_file_size_(kDefaultMaxFileSize), interval_minutes_(kDefaultIntervalMinutes), daily_minute_(-1)
+{
+}
+
+RotationPolicy RotationPolicy::None()
+{
+    RotationPolicy policy;
+    policy.max_file_size_ = kUnlimitedSize;
+    policy.interval_minutes_ = 0;
+    policy.daily_minute_ = -1;
+    return policy;
+}
+
+RotationPolicy& RotationPolicy::SetMaxFileSize(size_t max_file_size)
+{
+    max_file_size_ = max_file_size > 0 ? max_file_size : kUnlimitedSize;
+    return *this;
+}
+
+RotationPolicy& RotationPolicy::SetInterval(std::chrono::minutes interval)
+{
+    interval_minutes_ = static_cast<int>(std::min<std::chrono::minutes::rep>(
+        std::max<std::chrono::minutes::rep>(interval.count(), 0), kMinutesPerDay));
+    return *this;
+}
+
+RotationPolicy& RotationPolicy::SetDaily(int hour, int minute)
+{
+    daily_minute_ = (hour % 24) * 60 + minute % 60;
+    return *this;
+}
+
+RotationPolicy& RotationPolicy::ClearDaily()
+{
+    daily_minute_ = -1;
+    return *this;
+}
+
+time_t RotationPolicy::GetNextRotateTime(time_t ts) const
+{
+    if (interval_minutes_ == 0 && daily_minute_ < 0)
+    {
+        return kNever;
+    }
+
+    // NOTICE localtime线程不安全，使用localtime_r
+    tm ltm = {0};
+    localtime_r(&ts, &ltm);
+    int minute_of_day = ltm.tm_hour * 60 + ltm.tm_min;
+
+    time_t next_time = kNever;
+    if (interval_minutes_ > 0)
+    {
+        // 间隔不能整除一天时，最后一段在0点截止，第二天重新对齐
+        int next_minute = std::min((minute_of_day / interval_minutes_ + 1) * interval_minutes_, kMinutesPerDay);
+        next_time = std::min(next_time, MakeLocalTime(ltm, next_minute));
+    }
+    if (daily_minute_ >= 0)
+    {
+        int next_minute = daily_minute_ > minute_of_day ? daily_minute_ : daily_minute_ + kMinutesPerDay;
+        next_time = std::min(next_time, MakeLocalTime(ltm, next_minute));
+    }
+    // 夏令时回拨时本地时间可能重复，保证切分时间点在ts之后
+    return std::max(next_time, ts + 1);
+}
+}  // namespace Nlog
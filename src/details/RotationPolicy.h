@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <limits>
+
+namespace Nlog
+{
+// 日志文件切分策略，按大小、固定间隔、每小时、每天切分可以任意组合，满足任意一个条件即切分。
+// 按时间切分的时间点按本地时间计算，日志输出后端在打开文件时用GetNextRotateTime预先算好下一个切分时间点，
+// 之后每条日志只需要和日志自己的时间戳比较一次
+class RotationPolicy
+{
+  public:
+    // 默认单个文件最大10MB
+    static constexpr size_t kDefaultMaxFileSize = 10 * 1024 * 1024;
+    // 默认每15分钟切分
+    static constexpr int kDefaultIntervalMinutes = 15;
+    // 不按时间切分时的下一个切分时间点
+    static constexpr time_t kNever = std::numeric_limits<time_t>::max();
+    // 不按大小切分时的文件大小上限
+    static constexpr size_t kUnlimitedSize = std::numeric_limits<size_t>::max();
+
+    /**
+     * 默认策略：单个文件超过10MB或者到了整15分钟时切分
+     */
+    RotationPolicy();
+
+    /**
+     * @return 不切分的策略，用于再组合需要的切分条件
+     */
+    static RotationPolicy None();
+
+    /**
+     * 按大小切分
+     * @param max_file_size 单个文件超过该字节数后切分，0表示不按大小切分
+     */
+    RotationPolicy& SetMaxFileSize(size_t max_file_size);
+
+    /**
+     * 按固定间隔切分，切分时间点从本地时间0点开始对齐，如15分钟间隔在每小时的0、15、30、45分切分
+     * @param interval 间隔，超过1天按1天算，0表示不按间隔切分
+     */
+    RotationPolicy& SetInterval(std::chrono::minutes interval);
+
+    /**
+     * 每小时整点切分
+     */
+    RotationPolicy& SetHourly() { return SetInterval(std::chrono::minutes(60)); }
+
+    /**
+     * 每天在指定的本地时间切分
+     * @param hour 小时，0-23
+     * @param minute 分钟，0-59
+     */
+    RotationPolicy& SetDaily(int hour = 0, int minute = 0);
+
+    /**
+     * 取消每天定时切分
+     */
+    RotationPolicy& ClearDaily();
+
+    /**
+     * @return 单个文件的大小上限，不按大小切分时返回kUnlimitedSize
+     */
+    size_t GetMaxFileSize() const { return max_file_size_; }
+
+    /**
+     * 计算一个时间点之后的下一个切分时间点
+     * @param ts 时间戳，一般为打开日志文件时第一条日志的时间
+     * @return 大于ts的下一个切分时间点，不按时间切分时返回kNever
+     */
+    time_t GetNextRotateTime(time_t ts) const;
+
+  private:
+    // 单个文件的大小上限
+    size_t max_file_size_;
+    // 切分间隔，单位分钟，0表示不按间隔切分
+    int interval_minutes_;
+    // 每天切分的时间点，为一天中的第几分钟，-1表示不按天切分
+    int daily_minute_;
+};
+}  // namespace Nlog
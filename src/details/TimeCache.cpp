@@ -0,0 +1,64 @@
+#include "TimeCache.h"
+
+#include <time.h>
+
+#include "NumberFormatter.h"
+
+namespace Nlog
+{
+namespace TimeCache
+{
+struct LocalTimeCache
+{
+    // 缓存的本地小时的起始时间，-1表示缓存无效
+    time_t hour_begin = -1;
+    // 已经输出到text中的秒
+    time_t second = -1;
+    // 已经输出到text中的毫秒
+    long millisecond = -1;
+    char text[kDateTimeMsLength + 1] = "0000-00-00 00:00:00.000";
+};
+
+const char* FormatLocalTime(const struct timeval& tv)
+{
+    static thread_local LocalTimeCache cache;
+
+    const time_t sec = tv.tv_sec;
+    if (sec != cache.second)
+    {
+        if (cache.hour_begin < 0 || sec < cache.hour_begin || sec >= cache.hour_begin + 3600)
+        {
+            // 跨小时，重新计算年月日时
+            struct tm result = {};
+            (void)localtime_r(&sec, &result);
+            NumberFormatter::WritePadded4(static_cast<unsigned>(1900 + result.tm_year) % 10000,
+                                          cache.text + kYearOffset);
+            NumberFormatter::WritePadded2(1 + result.tm_mon, cache.text + kMonthOffset);
+            NumberFormatter::WritePadded2(result.tm_mday, cache.text + kDayOffset);
+            NumberFormatter::WritePadded2(result.tm_hour, cache.text + kHourOffset);
+            NumberFormatter::WritePadded2(result.tm_min, cache.text + kMinuteOffset);
+            NumberFormatter::WritePadded2(result.tm_sec, cache.text + kSecondOffset);
+            // 包含闰秒的时区下tm_sec可能为60，无法按整数推算，不缓存
+            bool leap_second = result.tm_sec >= 60;
+            cache.hour_begin = leap_second ? -1 : sec - result.tm_min * 60 - result.tm_sec;
+            cache.second = leap_second ? -1 : sec;
+        }
+        else
+        {
+            unsigned seconds_in_hour = static_cast<unsigned>(sec - cache.hour_begin);
+            NumberFormatter::WritePadded2(seconds_in_hour / 60, cache.text + kMinuteOffset);
+            NumberFormatter::WritePadded2(seconds_in_hour % 60, cache.text + kSecondOffset);
+            cache.second = sec;
+        }
+    }
+
+    long millisecond = tv.tv_usec / 1000;
+    if (millisecond != cache.millisecond)
+    {
+        NumberFormatter::WritePadded3(static_cast<unsigned>(millisecond), cache.text + kMillisecondOffset);
+        cache.millisecond = millisecond;
+    }
+    return cache.text;
+}
+}  // namespace TimeCache
+}  // namespace Nlog
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <sys/time.h>
+
+namespace Nlog
+{
+// 线程级缓存的本地时间文本，格式为"YYYY-MM-DD hh:mm:ss.iii"
+// 同一小时内只用整数运算更新分、秒和毫秒，跨小时（可能发生夏令时切换）才调用一次localtime_r，
+// 避免每条日志都进入localtime_r内部的时区锁
+namespace TimeCache
+{
+// 时间文本中各字段的位置和长度
+enum
+{
+    kYearOffset = 0,
+    kMonthOffset = 5,
+    kDayOffset = 8,
+    kHourOffset = 11,
+    kMinuteOffset = 14,
+    kSecondOffset = 17,
+    kMillisecondOffset = 20,
+    // "YYYY-MM-DD hh:mm:ss"
+    kDateTimeLength = 19,
+    // "YYYY-MM-DD hh:mm:ss.iii"
+    kDateTimeMsLength = 23
+};
+
+/**
+ * 获取指定时间的本地时间文本，返回的缓冲区属于当前线程，下次调用时会被覆盖
+ * @param tv 时间
+ * @return kDateTimeMsLength个字符的时间文本（不以'\0'结尾）
+ */
+const char* FormatLocalTime(const struct timeval& tv);
+}  // namespace TimeCache
+}  // namespace Nlog
@@ -1,7 +1,9 @@
 #include "Utils.h"
 
 #include <sys/stat.h>
+#include <cstdio>
 #include <cstdlib>
+#include <iostream>
 
 namespace Nlog
 {
@@ -20,4 +22,77 @@ bool CreateDirectory(const std::string& path)
     std::string mkdir_cmd = "mkdir -p " + path;
     return 0 == system(mkdir_cmd.c_str());
 }
-}
\ No newline at end of file
+
+const char kLoggingFileSuffix[] = "logging";
+const char kLoggedFileSuffix[] = "log";
+
+std::string GetLogFileName(const std::string& dir_name, time_t ts, bool is_logging, int log_index)
+{
+    // tm_year 从1990开始算
+    // tm_mon 从0开始
+    tm ltm = {0};
+    localtime_r(&ts, &ltm);
+    char buff[1024];
+    int buff_writen_size = snprintf(buff, sizeof buff, "%s/%04d%02d%02d%02d%02d.%d.%s", dir_name.c_str(),
+                                    ltm.tm_year + 1900, ltm.tm_mon + 1, ltm.tm_mday, ltm.tm_hour, ltm.tm_min,
+                                    log_index, (is_logging ? kLoggingFileSuffix : kLoggedFileSuffix));
+    return std::string(buff, buff_writen_size);
+}
+
+time_t ParseLogFileName(const std::string& log_file_name, int& log_index, std::string& suffix)
+{
+    tm ltm = {0};
+    int suffix_pos = 0;
+    int ret = sscanf(log_file_name.c_str(), "%04d%02d%02d%02d%02d.%d.%n", &ltm.tm_year, &ltm.tm_mon, &ltm.tm_mday,
+                     &ltm.tm_hour, &ltm.tm_min, &log_index, &suffix_pos);
+    constexpr int kLogFieldNum = 6;
+    if (ret != kLogFieldNum || suffix_pos == 0)
+    {
+        return 0;
+    }
+    suffix.assign(log_file_name, suffix_pos, std::string::npos);
+    ltm.tm_year -= 1900;
+    ltm.tm_mon -= 1;
+    // 与GetLogFileName的localtime_r对应，由mktime判断是否是夏令时
+    ltm.tm_isdst = -1;
+    return mktime(&ltm);
+}
+
+time_t GetTsFromLogFileName(const std::string& log_file_name, bool is_logging, int& log_index)
+{
+    std::string suffix;
+    time_t ts = ParseLogFileName(log_file_name, log_index, suffix);
+    if (suffix != (is_logging ? kLoggingFileSuffix : kLoggedFileSuffix))
+    {
+        return 0;
+    }
+    return ts;
+}
+
+time_t GetTsFromLoggingFileName(const std::string& log_file_name, int& log_index)
+{
+    time_t ts = GetTsFromLogFileName(log_file_name, true, log_index);
+    if (0 == ts)
+    {
+        // format error
+        std::cerr << "WARN: log file name format error, log_file_name:" << log_file_name << std::endl;
+    }
+    return ts;
+}
+
+bool EndsWith(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+size_t GetFileSize(const std::string& file_name)
+{
+    struct stat st;
+    if (stat(file_name.c_str(), &st) == 0)
+    {
+        return st.st_size;
+    }
+    // 默认没超过限制，包括文件不存在等情况
+    return 0;
+}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <ctime>
+#include <functional>
 #include <string>
 #include <memory>
 #include <type_traits>
@@ -20,6 +22,66 @@ bool DirectoryExists(const std::string& path);
  */
 bool CreateDirectory(const std::string& path);
 
+// 正在写入的日志文件后缀
+extern const char kLoggingFileSuffix[];
+// 已经写完的日志文件后缀
+extern const char kLoggedFileSuffix[];
+
+/**
+ * 获取日志文件名，格式为 目录/年月日时分.序号.后缀
+ * @param dir_name 日志文件目录
+ * @param ts 时间戳
+ * @param is_logging 是否正在写入，正在写入的文件后缀为logging，否则为log
+ * @param log_index 日志文件序号
+ * @return 日志文件名
+ */
+std::string GetLogFileName(const std::string& dir_name, time_t ts, bool is_logging, int log_index);
+
+/**
+ * 从日志文件名（不含目录）中解析时间戳、序号和后缀，如 202401011200.3.log.lz4 的后缀为 log.lz4
+ * @param log_file_name 日志文件名
+ * @param log_index 日志文件序号
+ * @param suffix 序号之后的部分
+ * @return 时间戳，不是日志文件时返回0
+ */
+time_t ParseLogFileName(const std::string& log_file_name, int& log_index, std::string& suffix);
+
+/**
+ * 从日志文件名（不含目录）中解析时间戳和序号，文件名必须完全符合GetLogFileName的格式，
+ * 压缩后的文件（后面多了压缩后缀）等其他文件都不匹配
+ * @param log_file_name 日志文件名
+ * @param is_logging 是否正在写入，正在写入的文件后缀为logging，否则为log
+ * @param log_index 日志文件序号
+ * @return 时间戳，格式不匹配时返回0
+ */
+time_t GetTsFromLogFileName(const std::string& log_file_name, bool is_logging, int& log_index);
+
+/**
+ * 从正在写入的日志文件名（不含目录）中解析时间戳和序号
+ * @param log_file_name 日志文件名
+ * @param log_index 日志文件序号
+ * @return 时间戳，格式错误时返回0
+ */
+time_t GetTsFromLoggingFileName(const std::string& log_file_name, int& log_index);
+
+// 日志文件写完（从.logging重命名为.log）后的回调，参数为.log文件名（含目录）
+typedef std::function<void(const std::string& log_file_name)> RotateCallback;
+
+/**
+ * 判断字符串是否以指定后缀结尾
+ * @param str 字符串
+ * @param suffix 后缀
+ * @return true表示以suffix结尾
+ */
+bool EndsWith(const std::string& str, const std::string& suffix);
+
+/**
+ * 获取文件大小
+ * @param file_name 文件名
+ * @return 文件大小，文件不存在时返回0
+ */
+size_t GetFileSize(const std::string& file_name);
+
 
 #if __cplusplus >= 201402L
 using std::make_unique;
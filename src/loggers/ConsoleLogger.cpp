@@ -0,0 +1,290 @@
+#include "ConsoleLogger.h"
+
+#include <errno.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace Nlog
+{
+constexpr size_t ConsoleLogger::kDefaultBufferSize;
+constexpr std::chrono::milliseconds ConsoleLogger::kDefaultMaxLatency;
+
+// 颜色标记的最大长度：开始标记如"\033[35m"，结束标记"\033[0m"
+constexpr size_t kMaxColorTagsSize = 16;
+constexpr const char kColorEndTag[] = "\033[0m";
+// 写缓冲区至少能放下一条不需要扩容的日志
+constexpr size_t kMinBufferSize =
+    HeaderPattern::kMaxHeaderSize + kMaxColorTagsSize + LogStream::kInlineSize + LogStream::kReservedSize;
+
+static bool ShouldUseColor(int fd, ConsoleLogger::ColorMode color_mode)
+{
+    switch (color_mode)
+    {
+        case ConsoleLogger::ColorMode::kAlways: return true;
+        case ConsoleLogger::ColorMode::kNever: return false;
+        case ConsoleLogger::ColorMode::kAuto: break;
+    }
+    return isatty(fd) == 1;
+}
+
+ConsoleLogger::ConsoleLogger(int fd, size_t buffer_size, std::chrono::milliseconds max_latency, bool drop_when_full,
+                             ColorMode color_mode)
+    : Logger("console"),
+      fd_(fd),
+      buffer_capacity_(buffer_size < kMinBufferSize ? kMinBufferSize : buffer_size),
+      max_latency_(max_latency),
+      drop_when_full_(drop_when_full),
+      use_color_(ShouldUseColor(fd, color_mode)),
+      buffer_(static_cast<char*>(malloc(buffer_capacity_))),
+      buffer_size_(0),
+      write_buffer_(static_cast<char*>(malloc(buffer_capacity_))),
+      writing_(false),
+      large_line_size_(0),
+      large_line_offset_(0),
+      has_large_line_(false),
+      write_now_(false),
+      swapped_count_(0),
+      written_count_(0),
+      stopping_(false),
+      dropped_count_(0)
+{
+}
+
+ConsoleLogger::~ConsoleLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    writer_cond_.notify_one();
+    if (writer_thread_.joinable())
+    {
+        writer_thread_.join();
+    }
+    free(buffer_);
+    free(write_buffer_);
+}
+
+std::shared_ptr<ConsoleLogger> ConsoleLogger::Create(int fd, size_t buffer_size, std::chrono::milliseconds max_latency,
+                                                     bool drop_when_full, ColorMode color_mode)
+{
+    ConsoleLoggerPtr logger(new ConsoleLogger(fd, buffer_size, max_latency, drop_when_full, color_mode));
+    if (logger->buffer_ == nullptr || logger->write_buffer_ == nullptr)
+    {
+        return nullptr;
+    }
+    logger->writer_thread_ = std::thread(&ConsoleLogger::Run, logger.get());
+    return logger;
+}
+
+void ConsoleLogger::Write(const LogMessage& log_message)
+{
+    // 颜色标记和头部在加锁前格式化到栈上
+    char prefix[HeaderPattern::kMaxHeaderSize + kMaxColorTagsSize];
+    size_t prefix_length = 0;
+    const char* color_begin_tag = use_color_ ? GetLogColorBySeverity(log_message.GetLogSeverity()) : nullptr;
+    if (color_begin_tag != nullptr)
+    {
+        size_t tag_length = strlen(color_begin_tag);
+        memcpy(prefix, color_begin_tag, tag_length);
+        prefix_length = tag_length;
+        prefix_length += FormatHeader(log_message, prefix + prefix_length, HeaderPattern::kMaxHeaderSize);
+        memcpy(prefix + prefix_length, kColorEndTag, sizeof(kColorEndTag) - 1);
+        prefix_length += sizeof(kColorEndTag) - 1;
+    }
+    else
+    {
+        prefix_length = FormatHeader(log_message, prefix, HeaderPattern::kMaxHeaderSize);
+    }
+    const char* text = log_message.GetLogText();
+    size_t text_length = log_message.GetLogTextLength();
+    size_t length = prefix_length + text_length;
+
+    stats_.Lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_, std::adopt_lock);
+
+    if (length > buffer_capacity_ && drop_when_full_)
+    {
+        // 丢弃模式下打印日志的线程不调用write，输出阻塞时也不会被卡住
+        if (!QueueLargeLine(prefix, prefix_length, text, text_length))
+        {
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            stats_.dropped.Add();
+            return;
+        }
+    }
+    else if (length > buffer_capacity_)
+    {
+        // 等后台线程写完，保证日志的顺序
+        while (writing_)
+        {
+            space_cond_.wait(lock);
+        }
+        WriteLargeLine(prefix, prefix_length, text, text_length);
+    }
+    else
+    {
+        if (!WaitForSpace(lock, length))
+        {
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            stats_.dropped.Add();
+            return;
+        }
+        bool was_empty = buffer_size_ == 0;
+        memcpy(buffer_ + buffer_size_, prefix, prefix_length);
+        memcpy(buffer_ + buffer_size_ + prefix_length, text, text_length);
+        buffer_size_ += length;
+        if (was_empty)
+        {
+            // 缓冲区由空变为非空时通知后台线程开始计时，之后的日志不再通知
+            first_line_time_ = std::chrono::steady_clock::now();
+            writer_cond_.notify_one();
+        }
+    }
+    stats_.messages.Add();
+    stats_.bytes.Add(length);
+}
+
+bool ConsoleLogger::WaitForSpace(std::unique_lock<std::mutex>& lock, size_t length)
+{
+    while (buffer_capacity_ - buffer_size_ < length)
+    {
+        // 后台线程正在写说明输出跟不上，丢弃模式下不等待
+        if (drop_when_full_ && writing_) return false;
+        write_now_ = true;
+        writer_cond_.notify_one();
+        space_cond_.wait(lock);
+    }
+    return true;
+}
+
+void ConsoleLogger::WriteLargeLine(const char* prefix, size_t prefix_length, const char* text, size_t text_length)
+{
+    struct iovec iov[3];
+    iov[0].iov_base = buffer_;
+    iov[0].iov_len = buffer_size_;
+    iov[1].iov_base = const_cast<char*>(prefix);
+    iov[1].iov_len = prefix_length;
+    iov[2].iov_base = const_cast<char*>(text);
+    iov[2].iov_len = text_length;
+    uint64_t begin_ns = GetStatsNowNs();
+    WriteAll(iov, 3);
+    stats_.write_latency.RecordSince(begin_ns);
+    buffer_size_ = 0;
+    // 相当于交换并写完了一个缓冲区，等待Flush的线程按序号判断
+    ++swapped_count_;
+    ++written_count_;
+    space_cond_.notify_all();
+}
+
+bool ConsoleLogger::QueueLargeLine(const char* prefix, size_t prefix_length, const char* text, size_t text_length)
+{
+    if (writing_ || has_large_line_) return false;
+
+    size_t length = prefix_length + text_length;
+    if (large_line_.size() < length) large_line_.resize(length);
+    memcpy(large_line_.data(), prefix, prefix_length);
+    memcpy(large_line_.data() + prefix_length, text, text_length);
+    large_line_size_ = length;
+    // 缓冲区中已有的日志在长日志之前写出，之后追加的在长日志之后写出
+    large_line_offset_ = buffer_size_;
+    has_large_line_ = true;
+    write_now_ = true;
+    writer_cond_.notify_one();
+    return true;
+}
+
+void ConsoleLogger::Flush()
+{
+    uint64_t begin_ns = GetStatsNowNs();
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool has_pending = buffer_size_ > 0 || has_large_line_;
+    uint64_t target = has_pending ? swapped_count_ + 1 : swapped_count_;
+    if (written_count_ >= target) return;
+    if (has_pending)
+    {
+        write_now_ = true;
+        writer_cond_.notify_one();
+    }
+    if (!drop_when_full_)
+    {
+        space_cond_.wait(lock, [this, target] { return written_count_ >= target; });
+    }
+    stats_.flush_latency.RecordSince(begin_ns);
+}
+
+void ConsoleLogger::WriteAll(struct iovec* iov, int iov_count)
+{
+    while (iov_count > 0)
+    {
+        ssize_t n = writev(fd_, iov, iov_count);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            // 写失败（如管道的读端已关闭）时丢弃数据
+            return;
+        }
+        // 部分写入时跳过已经写出的部分
+        while (iov_count > 0 && static_cast<size_t>(n) >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --iov_count;
+        }
+        if (iov_count > 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+void ConsoleLogger::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        writer_cond_.wait(lock, [this] { return buffer_size_ > 0 || has_large_line_ || stopping_; });
+        if (buffer_size_ == 0 && !has_large_line_) return;
+
+        // 等到最早的一行超过延迟阈值，缓冲区写满、有长日志、Flush或者退出时立即写出
+        writer_cond_.wait_until(lock, first_line_time_ + max_latency_, [this] {
+            return write_now_ || stopping_ || (buffer_size_ == 0 && !has_large_line_);
+        });
+        write_now_ = false;
+        // 缓冲区中的日志已经被长日志一起写出
+        if (buffer_size_ == 0 && !has_large_line_) continue;
+
+        std::swap(buffer_, write_buffer_);
+        struct iovec iov[3];
+        int iov_count = 1;
+        iov[0].iov_base = write_buffer_;
+        iov[0].iov_len = buffer_size_;
+        if (has_large_line_)
+        {
+            iov[0].iov_len = large_line_offset_;
+            iov[1].iov_base = large_line_.data();
+            iov[1].iov_len = large_line_size_;
+            iov[2].iov_base = write_buffer_ + large_line_offset_;
+            iov[2].iov_len = buffer_size_ - large_line_offset_;
+            iov_count = 3;
+            has_large_line_ = false;
+        }
+        buffer_size_ = 0;
+        ++swapped_count_;
+        writing_ = true;
+        space_cond_.notify_all();
+
+        lock.unlock();
+        uint64_t begin_ns = GetStatsNowNs();
+        WriteAll(iov, iov_count);
+        stats_.write_latency.RecordSince(begin_ns);
+        lock.lock();
+
+        writing_ = false;
+        ++written_count_;
+        space_cond_.notify_all();
+    }
+}
+}  // namespace Nlog
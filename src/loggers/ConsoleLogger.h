@@ -0,0 +1,134 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+
+namespace Nlog
+{
+// 批量写控制台的日志输出后端。打印日志的线程把颜色标记、头部和文本拷贝到写缓冲区，
+// 由后台线程在缓冲区写满、最早的一行等待超过延迟阈值或者Flush时用一次write(2)写出，
+// 写出期间打印日志的线程继续写另一个缓冲区。输出不是终端（如重定向到管道或文件）时默认不输出颜色标记
+class ConsoleLogger : public Logger
+{
+  public:
+    // 颜色标记的输出方式
+    enum class ColorMode
+    {
+        // 输出到终端时输出颜色标记
+        kAuto,
+        kAlways,
+        kNever
+    };
+
+    // 默认写缓冲区大小
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+    // 默认的延迟阈值：缓冲区中最早的一行最多等待多久写出
+    static constexpr std::chrono::milliseconds kDefaultMaxLatency{10};
+
+    ~ConsoleLogger() override;
+
+    void Write(const LogMessage& log_message) override;
+    // 把缓冲区交给后台线程写出，丢弃模式下不等待写完
+    void Flush() override;
+
+    /**
+     * @param fd 输出的文件描述符，一般为STDOUT_FILENO或STDERR_FILENO，不会被关闭
+     * @param buffer_size 写缓冲区大小，最小能容纳一条不需要扩容的日志。更长的日志在等待模式下由打印日志的线程直接写出，
+     *                    丢弃模式下拷贝一份交给后台线程写出，后台线程正在写或者已经有一条待写的长日志时丢弃
+     * @param max_latency 延迟阈值
+     * @param drop_when_full 后台线程阻塞在write（如管道的读端处理不过来）且缓冲区写满时是否丢弃日志，
+     *                       false表示打印日志的线程等待
+     * @param color_mode 颜色标记的输出方式
+     * @return 创建失败时返回nullptr
+     */
+    static std::shared_ptr<ConsoleLogger> Create(int fd = STDOUT_FILENO, size_t buffer_size = kDefaultBufferSize,
+                                                 std::chrono::milliseconds max_latency = kDefaultMaxLatency,
+                                                 bool drop_when_full = false, ColorMode color_mode = ColorMode::kAuto);
+
+    /**
+     * @return 因为缓冲区满而丢弃的日志条数
+     */
+    uint64_t GetDroppedCount() const { return dropped_count_.load(std::memory_order_relaxed); }
+
+  private:
+    ConsoleLogger(int fd, size_t buffer_size, std::chrono::milliseconds max_latency, bool drop_when_full,
+                  ColorMode color_mode);
+
+    /**
+     * 等待缓冲区有length字节的空间，调用方需要持有mutex_
+     * @return 丢弃模式下需要等待后台线程写完时返回false
+     */
+    bool WaitForSpace(std::unique_lock<std::mutex>& lock, size_t length);
+
+    /**
+     * 写出比缓冲区还长的一行，连同缓冲区中已有的日志一起写出，调用方需要持有mutex_且后台线程空闲
+     */
+    void WriteLargeLine(const char* prefix, size_t prefix_length, const char* text, size_t text_length);
+
+    /**
+     * 丢弃模式下把比缓冲区还长的一行交给后台线程写出，调用方需要持有mutex_
+     * @return 后台线程正在写或者已经有一条待写的长日志时返回false
+     */
+    bool QueueLargeLine(const char* prefix, size_t prefix_length, const char* text, size_t text_length);
+
+    // 写出全部数据，写失败时丢弃
+    void WriteAll(struct iovec* iov, int iov_count);
+
+    // 后台写线程
+    void Run();
+
+  private:
+    // mutex_ 保护下面除了配置和统计以外的所有成员
+    std::mutex mutex_;
+    // 缓冲区由空变为非空、写满、Flush或者需要退出时通知后台线程
+    std::condition_variable writer_cond_;
+    // 后台线程交换或写完缓冲区时通知等待的线程
+    std::condition_variable space_cond_;
+    // 输出的文件描述符
+    const int fd_;
+    // 写缓冲区大小
+    const size_t buffer_capacity_;
+    // 延迟阈值
+    const std::chrono::milliseconds max_latency_;
+    // 缓冲区满时是否丢弃日志
+    const bool drop_when_full_;
+    // 是否输出颜色标记
+    const bool use_color_;
+    // 正在格式化日志的缓冲区和已用大小
+    char* buffer_;
+    size_t buffer_size_;
+    // 后台线程正在写出的缓冲区
+    char* write_buffer_;
+    bool writing_;
+    // 丢弃模式下等待后台线程写出的长日志，写在缓冲区的前large_line_offset_字节之后
+    std::vector<char> large_line_;
+    size_t large_line_size_;
+    size_t large_line_offset_;
+    bool has_large_line_;
+    // 缓冲区中最早一行的时间
+    std::chrono::steady_clock::time_point first_line_time_;
+    // 有线程在等待缓冲区空间或者Flush，后台线程不再等待延迟阈值
+    bool write_now_;
+    // 交换出去的缓冲区个数和已经写完的个数，Flush按序号等待
+    uint64_t swapped_count_;
+    uint64_t written_count_;
+    // 析构时通知后台线程写完剩余的日志后退出
+    bool stopping_;
+    // 后台线程
+    std::thread writer_thread_;
+    // 丢弃的日志条数
+    std::atomic<uint64_t> dropped_count_;
+};
+
+typedef std::shared_ptr<ConsoleLogger> ConsoleLoggerPtr;
+}  // namespace Nlog
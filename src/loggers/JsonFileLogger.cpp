@@ -0,0 +1,245 @@
+#include "JsonFileLogger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include "../details/JsonWriter.h"
+#include "../details/TimeCache.h"
+#include "../details/Utils.h"
+
+namespace Nlog
+{
+constexpr size_t JsonFileLogger::kDefaultBufferSize;
+
+// 文件名、函数名等固定成员的最大长度
+constexpr size_t kMaxFixedMembersSize = 4096;
+// 写缓冲区中一行JSON的最大长度：行内缓冲区的日志文本和字段全部转义后的长度，加上固定成员
+constexpr size_t kMaxLineSize =
+    JsonWriter::MaxEscapedLength(LogStream::kInlineSize + LogStream::kReservedSize + LogFieldEncoder::kMaxFieldsSize) +
+    kMaxFixedMembersSize;
+
+JsonFileLogger::JsonFileLogger(const std::string& file_name, size_t buffer_size)
+    : Logger("json_file"),
+      file_name_(file_name),
+      log_fd_(-1),
+      buffer_(nullptr),
+      buffer_capacity_(buffer_size < kMaxLineSize ? kMaxLineSize : buffer_size),
+      buffer_size_(0),
+      flush_after_write_(false)
+{
+    buffer_ = static_cast<char*>(malloc(buffer_capacity_));
+}
+
+JsonFileLogger::~JsonFileLogger()
+{
+    FlushBuffer();
+    if (log_fd_ >= 0)
+    {
+        close(log_fd_);
+    }
+    free(buffer_);
+}
+
+std::shared_ptr<JsonFileLogger> JsonFileLogger::Create(const std::string& file_name, size_t buffer_size)
+{
+    JsonFileLoggerPtr logger(new JsonFileLogger(file_name, buffer_size));
+    if (logger->buffer_ == nullptr || !logger->Init())
+    {
+        return nullptr;
+    }
+    return logger;
+}
+
+bool JsonFileLogger::Init()
+{
+    size_t pos = file_name_.rfind('/');
+    if (pos != std::string::npos && pos > 0)
+    {
+        std::string dir_name = file_name_.substr(0, pos);
+        // 目录不存在且创建目录失败，则失败
+        if (!DirectoryExists(dir_name) && !CreateDirectory(dir_name))
+        {
+            return false;
+        }
+    }
+    log_fd_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    return log_fd_ >= 0;
+}
+
+// 日志文本以"<module>"开头时跳过，msg只保留日志内容
+static size_t GetModulePrefixLength(const LogMessage& log_message)
+{
+    const char* module = log_message.GetSite().module;
+    size_t module_length = strlen(module);
+    const char* text = log_message.GetLogText();
+    if (module_length == 0 || log_message.GetMessageLength() < module_length + 2) return 0;
+    if (text[0] != '<' || memcmp(text + 1, module, module_length) != 0 || text[module_length + 1] != '>') return 0;
+    return module_length + 2;
+}
+
+// 固定成员的名字，同名的字段加上kReservedKeyPrefix前缀输出，避免对象中出现重复的key
+static const char* const kReservedKeys[] = {"ts", "time", "level", "thread", "file", "line", "func", "module", "msg"};
+constexpr char kReservedKeyPrefix = '_';
+
+static bool IsReservedKey(const char* key, size_t length)
+{
+    for (const char* reserved_key : kReservedKeys)
+    {
+        if (strlen(reserved_key) == length && memcmp(reserved_key, key, length) == 0) return true;
+    }
+    return false;
+}
+
+size_t JsonFileLogger::FormatLine(const LogMessage& log_message, char* buffer, size_t capacity)
+{
+    const LogSite& site = log_message.GetSite();
+    const struct timeval& tv = log_message.GetTime();
+    const char* level = GetLogSeverityName(log_message.GetLogSeverity());
+
+    size_t prefix_length = GetModulePrefixLength(log_message);
+    const char* msg = log_message.GetLogText() + prefix_length;
+    size_t msg_length = log_message.GetMessageLength() - prefix_length;
+    if (msg_length > 0 && msg[msg_length - 1] == '\n') --msg_length;
+
+    JsonWriter writer(buffer, capacity);
+    writer.BeginObject();
+    writer.Key("ts", 2);
+    writer.Int(static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec);
+    writer.Key("time", 4);
+    writer.String(TimeCache::FormatLocalTime(tv), TimeCache::kDateTimeMsLength);
+    writer.Key("level", 5);
+    writer.String(level, strlen(level));
+    writer.Key("thread", 6);
+    writer.Int(log_message.GetThreadId());
+    writer.Key("file", 4);
+    writer.String(site.file_name, site.file_name_length);
+    writer.Key("line", 4);
+    writer.Int(site.line);
+    writer.Key("func", 4);
+    writer.String(site.func, site.func_length);
+    if (site.module[0] != '\0')
+    {
+        writer.Key("module", 6);
+        writer.String(site.module, strlen(site.module));
+    }
+    writer.Key("msg", 3);
+    writer.String(msg, msg_length);
+
+    LogFieldReader reader(log_message.GetFields(), log_message.GetFieldsSize());
+    LogField field;
+    while (reader.Next(field))
+    {
+        if (IsReservedKey(field.key, field.key_length))
+        {
+            char key[1 + LogFieldEncoder::kMaxKeyLength];
+            key[0] = kReservedKeyPrefix;
+            memcpy(key + 1, field.key, field.key_length);
+            writer.Key(key, field.key_length + 1);
+        }
+        else
+        {
+            writer.Key(field.key, field.key_length);
+        }
+        switch (field.type)
+        {
+            case LogFieldType::kInt: writer.Int(field.int_value); break;
+            case LogFieldType::kUint: writer.Uint(field.uint_value); break;
+            case LogFieldType::kDouble: writer.Double(field.double_value); break;
+            case LogFieldType::kBool: writer.Bool(field.bool_value); break;
+            case LogFieldType::kString: writer.String(field.string_value, field.string_length); break;
+        }
+    }
+    writer.EndObject();
+    writer.Raw("\n", 1);
+
+    // 只有函数名、文件名异常长时才可能放不下，丢弃这条日志而不是写出不完整的JSON
+    return writer.IsTruncated() ? 0 : writer.GetSize();
+}
+
+void JsonFileLogger::Write(const LogMessage& log_message)
+{
+    StatsLockGuard lock_guard(write_mutex_, stats_);
+
+    size_t line_size = 0;
+    if (log_message.GetLogTextLength() <= LogStream::kInlineSize)
+    {
+        if (buffer_capacity_ - buffer_size_ < kMaxLineSize)
+        {
+            FlushBuffer();
+        }
+        line_size = FormatLine(log_message, buffer_ + buffer_size_, kMaxLineSize);
+        buffer_size_ += line_size;
+    }
+    else
+    {
+        // 长日志编码到行缓冲区，先写出写缓冲区中更早的日志再写这一行
+        size_t max_line_size =
+            JsonWriter::MaxEscapedLength(log_message.GetLogTextLength() + log_message.GetFieldsSize()) +
+            kMaxFixedMembersSize;
+        if (large_line_.size() < max_line_size) large_line_.resize(max_line_size);
+        line_size = FormatLine(log_message, large_line_.data(), max_line_size);
+        if (line_size > 0)
+        {
+            FlushBuffer();
+            uint64_t begin_ns = GetStatsNowNs();
+            WriteAll(large_line_.data(), line_size);
+            stats_.write_latency.RecordSince(begin_ns);
+        }
+    }
+
+    if (line_size == 0)
+    {
+        stats_.dropped.Add();
+        return;
+    }
+    stats_.messages.Add();
+    stats_.bytes.Add(line_size);
+
+    if (flush_after_write_)
+    {
+        FlushBuffer();
+    }
+}
+
+void JsonFileLogger::Flush()
+{
+    uint64_t begin_ns = GetStatsNowNs();
+    StatsLockGuard lock_guard(write_mutex_, stats_);
+    FlushBuffer();
+    stats_.flush_latency.RecordSince(begin_ns);
+}
+
+void JsonFileLogger::SetFlushAfterWrite(bool on)
+{
+    std::lock_guard<std::mutex> lock_guard(write_mutex_);
+    flush_after_write_ = on;
+}
+
+void JsonFileLogger::FlushBuffer()
+{
+    if (buffer_size_ == 0) return;
+    uint64_t begin_ns = GetStatsNowNs();
+    WriteAll(buffer_, buffer_size_);
+    buffer_size_ = 0;
+    stats_.write_latency.RecordSince(begin_ns);
+}
+
+void JsonFileLogger::WriteAll(const char* data, size_t size)
+{
+    size_t written = 0;
+    while (log_fd_ >= 0 && written < size)
+    {
+        ssize_t n = write(log_fd_, data + written, size - written);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            // 写失败（如磁盘满）时丢弃数据，避免一直阻塞打印日志的线程
+            break;
+        }
+        written += n;
+    }
+}
+}  // namespace Nlog
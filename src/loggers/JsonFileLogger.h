@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Logger.h"
+
+namespace Nlog
+{
+// 输出JSON Lines格式的日志文件后端，每条日志一行JSON对象，便于日志采集和索引系统直接解析：
+// {"ts":1760760000123456,"time":"2025-10-18 12:00:00.123","level":"INFO","thread":1234,"file":"main.cpp",
+//  "line":10,"func":"main","module":"net","msg":"closed","conn":5,"bytes":10}
+// 通过kv()添加的结构化字段按原类型平铺在对象中，与固定成员同名的字段（如msg、level）输出为"_msg"、"_level"。
+// msg只包含日志文本本身（不含模块名前缀和渲染的字段）。
+// 编码过程没有堆内存分配，JSON直接写到写缓冲区，写满或Flush时用write(2)写到文件。
+// 超过行内缓冲区大小的长日志编码到单独的行缓冲区后直接写出
+class JsonFileLogger : public Logger
+{
+  public:
+    ~JsonFileLogger() override;
+
+    void Write(const LogMessage& log_message) override;
+    void Flush() override;
+
+    // 默认写缓冲区大小
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+    /**
+     * @param file_name 日志文件路径，追加写，所在目录不存在时创建
+     * @param buffer_size 写缓冲区大小，最小能容纳一条不需要扩容的日志
+     * @return 创建失败时返回nullptr
+     */
+    static std::shared_ptr<JsonFileLogger> Create(const std::string& file_name,
+                                                  size_t buffer_size = kDefaultBufferSize);
+
+    /**
+     * 设置是否write后自动调用flush
+     * @param on true代表自动flush
+     */
+    void SetFlushAfterWrite(bool on);
+
+  private:
+    JsonFileLogger(const std::string& file_name, size_t buffer_size);
+
+    bool Init();
+
+    /**
+     * 把一条日志编码为一行JSON
+     * @param log_message 日志消息
+     * @param buffer 输出缓冲区
+     * @param capacity 输出缓冲区大小
+     * @return 编码长度，放不下时返回0
+     */
+    static size_t FormatLine(const LogMessage& log_message, char* buffer, size_t capacity);
+
+    /**
+     * 把写缓冲区中的数据写到文件，调用方需要持有write_mutex_
+     */
+    void FlushBuffer();
+
+    // 写出全部数据，写失败时丢弃
+    void WriteAll(const char* data, size_t size);
+
+  private:
+    // write_mutex_ 用于同步Write函数
+    std::mutex write_mutex_;
+    // 日志文件路径
+    const std::string file_name_;
+    // 日志文件描述符，以O_APPEND打开
+    int log_fd_;
+    // 写缓冲区，JSON直接编码到这里
+    char* buffer_;
+    // 写缓冲区大小
+    size_t buffer_capacity_;
+    // 写缓冲区已用大小
+    size_t buffer_size_;
+    // write后自动调用flush
+    bool flush_after_write_;
+    // 长日志的行缓冲区，按需扩大后复用
+    std::vector<char> large_line_;
+};
+
+typedef std::shared_ptr<JsonFileLogger> JsonFileLoggerPtr;
+}  // namespace Nlog
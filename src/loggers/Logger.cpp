@@ -13,6 +13,7 @@ bool Logger::SetHeaderPattern(const std::string& header_pattern)
     if (IsHeaderPatternValid(header_pattern))
     {
         header_pattern_ = header_pattern;
+        header_formatter_.Compile(header_pattern_);
         return true;
     }
     return false;
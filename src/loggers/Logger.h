@@ -3,7 +3,9 @@
 #include <string>
 #include <memory>
 
+#include "../details/HeaderPattern.h"
 #include "../details/LogMessage.h"
+#include "../details/LogStats.h"
 
 namespace Nlog
 {
@@ -12,9 +14,15 @@ namespace Nlog
 class Logger
 {
   public:
-    explicit Logger(const std::string& name) : name_(name), header_pattern_(DEFAULT_PATTERN) {}
+    explicit Logger(const std::string& name)
+        : name_(name), header_pattern_(DEFAULT_PATTERN), header_formatter_(header_pattern_), stats_()
+    {
+    }
 
-    Logger(const std::string& name, const std::string& header_pattern) : name_(name), header_pattern_(header_pattern) {}
+    Logger(const std::string& name, const std::string& header_pattern)
+        : name_(name), header_pattern_(header_pattern), header_formatter_(header_pattern_), stats_()
+    {
+    }
 
     virtual ~Logger() = default;
 
@@ -46,7 +54,18 @@ class Logger
      */
     const std::string& GetHeaderPattern() const { return header_pattern_; }
 
-  protected:
+    /**
+     * 获取输出后端的统计，可以在其他线程正在打印日志时调用
+     * @return 统计快照
+     */
+    SinkStats GetStats() const
+    {
+        SinkStats stats;
+        stats.name = name_;
+        stats_.Snapshot(stats);
+        return stats;
+    }
+
     /**
      * 检查日志头部格式是否正确，支持以下格式:
      * %Y 年
@@ -69,7 +88,20 @@ class Logger
      * @param header_pattern 日志头部格式
      * @return 是否合法格式
      */
-    bool IsHeaderPatternValid(const std::string& header_pattern);
+    static bool IsHeaderPatternValid(const std::string& header_pattern);
+
+  protected:
+    /**
+     * 按预编译的头部格式输出日志头部到缓冲区
+     * @param log_message 日志消息
+     * @param buf 输出缓冲区，建议大小为HeaderPattern::kMaxHeaderSize
+     * @param size 缓冲区大小，空间不足时截断
+     * @return 输出的字符数
+     */
+    size_t FormatHeader(const LogMessage& log_message, char* buf, size_t size) const
+    {
+        return header_formatter_.Format(log_message, buf, size);
+    }
 
   protected:
     // Logger名字
@@ -78,6 +110,12 @@ class Logger
     // Logger头部格式
     std::string header_pattern_;
 
+    // 预编译的头部格式，与header_pattern_保持一致
+    HeaderPattern header_formatter_;
+
+    // 统计计数器，由各后端在写日志、写文件、切分时更新
+    LoggerStats stats_;
+
     // 默认头部格式
     static const std::string DEFAULT_PATTERN;
 };
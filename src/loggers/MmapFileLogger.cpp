@@ -0,0 +1,433 @@
+#include "MmapFileLogger.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "../details/Utils.h"
+
+namespace Nlog
+{
+constexpr size_t MmapFileLogger::kDefaultSegmentSize;
+// 日志文件大小按页对齐
+constexpr size_t kSegmentAlignment = 4096;
+// 日志文件最小1MB，保证能放下多条最长的日志
+constexpr size_t kMinSegmentSize = 1024 * 1024;
+// 同一分钟内最多尝试的文件序号
+constexpr int kMaxLogIndex = 10000;
+
+struct MmapFileLogger::Segment
+{
+    int fd;
+    char* base;
+    size_t capacity;
+    // 文件名中的时间戳和序号
+    time_t ts;
+    int index;
+    // 已经预留的字节数，超过capacity说明文件已经写满
+    std::atomic<size_t> reserved;
+    // 正在写入的线程数，切换文件后等其归零才能解除映射。复用时不重置，登记和撤销总是成对出现
+    std::atomic<int> writers;
+};
+
+// 同一序号已经写完的.log文件，写完后改名会覆盖它
+static bool LoggedFileExists(const std::string& dir_name, time_t ts, int log_index)
+{
+    return access(GetLogFileName(dir_name, ts, false, log_index).c_str(), F_OK) == 0;
+}
+
+// 以O_EXCL创建一个新的.logging文件，同一分钟内已存在的序号依次跳过
+static int CreateLoggingFile(const std::string& dir_name, time_t ts, int& log_index)
+{
+    for (log_index = 0; log_index < kMaxLogIndex; ++log_index)
+    {
+        if (LoggedFileExists(dir_name, ts, log_index)) continue;
+        std::string file_name = GetLogFileName(dir_name, ts, true, log_index);
+        int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+// 把.logging文件改名为新时间戳对应的文件名，不覆盖已存在的文件
+static bool RenameLoggingFile(const std::string& dir_name, time_t old_ts, int old_index, time_t new_ts,
+                              int& new_index)
+{
+    std::string old_name = GetLogFileName(dir_name, old_ts, true, old_index);
+    for (new_index = 0; new_index < kMaxLogIndex; ++new_index)
+    {
+        if (LoggedFileExists(dir_name, new_ts, new_index)) continue;
+        std::string new_name = GetLogFileName(dir_name, new_ts, true, new_index);
+        if (link(old_name.c_str(), new_name.c_str()) == 0)
+        {
+            unlink(old_name.c_str());
+            return true;
+        }
+        if (errno != EEXIST) return false;
+    }
+    return false;
+}
+
+// 预分配的文件中未写入的部分为0，最后一个非0字节之后即为实际长度
+static size_t GetUsedLength(const char* data, size_t length)
+{
+    while (length > 0 && data[length - 1] == '\0') --length;
+    return length;
+}
+
+MmapFileLogger::MmapFileLogger(const std::string& dir_name, size_t segment_size)
+    : Logger("mmap_file"),
+      dir_name_(dir_name),
+      segment_size_((std::max(segment_size, kMinSegmentSize) + kSegmentAlignment - 1) / kSegmentAlignment *
+                    kSegmentAlignment),
+      current_(nullptr),
+      next_(nullptr),
+      create_failed_(false),
+      stopping_(false)
+{
+}
+
+MmapFileLogger::~MmapFileLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(rotate_mutex_);
+        stopping_ = true;
+    }
+    job_cond_.notify_one();
+    if (rotate_thread_.joinable())
+    {
+        rotate_thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(rotate_mutex_);
+    Segment* segment = current_.exchange(nullptr);
+    if (segment != nullptr)
+    {
+        size_t reserved = segment->reserved.load();
+        // 保持.logging后缀，下次启动时恢复
+        FinishSegment(segment, std::min(reserved, segment->capacity), false);
+    }
+    if (next_ != nullptr)
+    {
+        FinishSegment(next_, 0, false);
+        next_ = nullptr;
+    }
+    for (Segment* spare_segment : spare_segments_)
+    {
+        delete spare_segment;
+    }
+}
+
+std::shared_ptr<MmapFileLogger> MmapFileLogger::Create(const std::string& dir_name, size_t segment_size)
+{
+    MmapFileLoggerPtr logger(new MmapFileLogger(dir_name, segment_size));
+    if (!logger->Init())
+    {
+        return nullptr;
+    }
+    return logger;
+}
+
+bool MmapFileLogger::Init()
+{
+    if (!DirectoryExists(dir_name_))
+    {
+        // 目录不存在且创建目录失败，则失败
+        if (!CreateDirectory(dir_name_)) return false;
+    }
+    else
+    {
+        RecoverLoggingFiles();
+    }
+
+    Segment* segment = CreateSegment();
+    if (segment == nullptr) return false;
+    current_.store(segment);
+    next_ = CreateSegment();
+    create_failed_ = next_ == nullptr;
+    rotate_thread_ = std::thread(&MmapFileLogger::Run, this);
+    return true;
+}
+
+void MmapFileLogger::RecoverLoggingFiles()
+{
+    DIR* dir = opendir(dir_name_.c_str());
+    if (nullptr == dir)
+    {
+        std::cerr << "INFO: dir not exist, dir:" << dir_name_ << std::endl;
+        return;
+    }
+
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr)
+    {
+        if (!EndsWith(dp->d_name, kLoggingFileSuffix)) continue;
+
+        int log_index = 0;
+        time_t logging_ts = GetTsFromLoggingFileName(dp->d_name, log_index);
+        if (0 == logging_ts) continue;
+
+        std::string logging_name = GetLogFileName(dir_name_, logging_ts, true, log_index);
+        int fd = open(logging_name.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) continue;
+
+        size_t file_size = GetFileSize(logging_name);
+        size_t used_length = 0;
+        if (file_size > 0)
+        {
+            void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                close(fd);
+                continue;
+            }
+            used_length = GetUsedLength(static_cast<const char*>(data), file_size);
+            munmap(data, file_size);
+        }
+
+        if (used_length == 0)
+        {
+            unlink(logging_name.c_str());
+        }
+        else
+        {
+            // NOTE ignore truncate/rename fail
+            (void)ftruncate(fd, used_length);
+            rename(logging_name.c_str(), GetLogFileName(dir_name_, logging_ts, false, log_index).c_str());
+        }
+        close(fd);
+    }
+
+    (void)closedir(dir);
+}
+
+MmapFileLogger::Segment* MmapFileLogger::CreateSegment()
+{
+    time_t ts = time(0);
+    int log_index = 0;
+    int fd = CreateLoggingFile(dir_name_, ts, log_index);
+    if (fd < 0) return nullptr;
+
+    std::string file_name = GetLogFileName(dir_name_, ts, true, log_index);
+    // 预分配磁盘空间，避免写入映射内存时因磁盘满收到SIGBUS；文件系统不支持时退化为稀疏文件
+    if (fallocate(fd, 0, 0, segment_size_) != 0 &&
+        (errno != EOPNOTSUPP || ftruncate(fd, segment_size_) != 0))
+    {
+        close(fd);
+        unlink(file_name.c_str());
+        return nullptr;
+    }
+
+    // 预先建立页表，写入时不会触发缺页
+    void* base = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        close(fd);
+        unlink(file_name.c_str());
+        return nullptr;
+    }
+
+    Segment* segment = nullptr;
+    if (!spare_segments_.empty())
+    {
+        segment = spare_segments_.back();
+        spare_segments_.pop_back();
+    }
+    else
+    {
+        segment = new Segment;
+        segment->writers.store(0);
+    }
+    segment->fd = fd;
+    segment->base = static_cast<char*>(base);
+    segment->capacity = segment_size_;
+    segment->ts = ts;
+    segment->index = log_index;
+    segment->reserved.store(0);
+    return segment;
+}
+
+void MmapFileLogger::Write(const LogMessage& log_message)
+{
+    char header[HeaderPattern::kMaxHeaderSize];
+    size_t header_length = FormatHeader(log_message, header, sizeof(header));
+    size_t text_length = log_message.GetLogTextLength();
+    size_t length = header_length + text_length;
+    // 比一个文件还长的日志无法写入，直接丢弃
+    if (length > segment_size_)
+    {
+        stats_.dropped.Add();
+        return;
+    }
+
+    for (;;)
+    {
+        Segment* segment = current_.load(std::memory_order_seq_cst);
+        if (segment == nullptr)
+        {
+            // 上次创建文件失败，重试一次，仍然失败则丢弃日志
+            Rotate(nullptr, 0);
+            if (current_.load() == nullptr)
+            {
+                stats_.dropped.Add();
+                return;
+            }
+            continue;
+        }
+        // 登记写入后再次确认文件没有被切换，保证切换文件的线程能等到本线程写完。
+        // Segment对象在logger析构前不会释放，切换后可能被复用为新的文件，因此只在确认之后读取其他字段
+        segment->writers.fetch_add(1, std::memory_order_seq_cst);
+        if (current_.load(std::memory_order_seq_cst) != segment)
+        {
+            segment->writers.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+        // 撤销登记后Segment对象可能被后台线程复用，之后只使用这里读出的容量
+        size_t capacity = segment->capacity;
+        if (segment->reserved.load(std::memory_order_relaxed) > capacity)
+        {
+            // 文件已经写满，等待写不下的线程切换文件
+            segment->writers.fetch_sub(1, std::memory_order_release);
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t offset = segment->reserved.fetch_add(length, std::memory_order_relaxed);
+        if (offset + length <= capacity)
+        {
+            memcpy(segment->base + offset, header, header_length);
+            memcpy(segment->base + offset + header_length, log_message.GetLogText(), text_length);
+            segment->writers.fetch_sub(1, std::memory_order_release);
+            stats_.messages.Add();
+            stats_.bytes.Add(length);
+            return;
+        }
+        segment->writers.fetch_sub(1, std::memory_order_release);
+
+        // 预留的空间连续分配，第一个写不下的线程的起始位置即为文件的实际长度
+        if (offset <= capacity)
+        {
+            Rotate(segment, offset);
+        }
+    }
+}
+
+void MmapFileLogger::Flush() {}
+
+void MmapFileLogger::SetRotateCallback(RotateCallback callback)
+{
+    std::lock_guard<std::mutex> lock(rotate_mutex_);
+    rotate_callback_ = std::move(callback);
+}
+
+void MmapFileLogger::Rotate(Segment* full_segment, size_t used_length)
+{
+    std::unique_lock<std::mutex> lock(rotate_mutex_);
+    if (current_.load() != full_segment) return;
+
+    if (next_ == nullptr)
+    {
+        // 写入速度超过了后台线程创建文件的速度，或者上次创建失败，等待后台线程创建
+        create_failed_ = false;
+        job_cond_.notify_one();
+        ready_cond_.wait(lock, [this] { return next_ != nullptr || create_failed_; });
+        if (current_.load() != full_segment) return;
+    }
+
+    Segment* segment = next_;
+    next_ = nullptr;
+    // 创建失败时当前文件为空，之后的日志被丢弃，直到再次创建成功
+    current_.store(segment, std::memory_order_seq_cst);
+    if (full_segment != nullptr)
+    {
+        stats_.rotations.Add();
+    }
+    if (full_segment != nullptr || segment != nullptr)
+    {
+        rotate_jobs_.push_back(RotateJob{full_segment, used_length, segment});
+    }
+    job_cond_.notify_one();
+}
+
+void MmapFileLogger::Run()
+{
+    std::unique_lock<std::mutex> lock(rotate_mutex_);
+    for (;;)
+    {
+        job_cond_.wait(lock,
+                       [this] { return !rotate_jobs_.empty() || stopping_ || (next_ == nullptr && !create_failed_); });
+        if (!rotate_jobs_.empty())
+        {
+            std::vector<RotateJob> jobs;
+            jobs.swap(rotate_jobs_);
+            RotateCallback callback = rotate_callback_;
+            lock.unlock();
+            for (const RotateJob& job : jobs)
+            {
+                // 预先创建的文件改名为开始写入的时间，写满之前一定先处理这个任务
+                Segment* segment = job.started_segment;
+                time_t now = time(0);
+                int log_index = 0;
+                if (segment != nullptr && now / 60 != segment->ts / 60 &&
+                    RenameLoggingFile(dir_name_, segment->ts, segment->index, now, log_index))
+                {
+                    segment->ts = now;
+                    segment->index = log_index;
+                }
+                if (job.full_segment != nullptr && FinishSegment(job.full_segment, job.used_length, true) &&
+                    callback)
+                {
+                    // Segment对象只由后台线程复用，此时文件名字段仍然有效
+                    callback(GetLogFileName(dir_name_, job.full_segment->ts, false, job.full_segment->index));
+                }
+            }
+            lock.lock();
+            continue;
+        }
+        if (stopping_) return;
+
+        lock.unlock();
+        Segment* segment = CreateSegment();
+        lock.lock();
+        next_ = segment;
+        create_failed_ = segment == nullptr;
+        ready_cond_.notify_all();
+    }
+}
+
+bool MmapFileLogger::FinishSegment(Segment* segment, size_t used_length, bool logged)
+{
+    while (segment->writers.load(std::memory_order_seq_cst) != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    munmap(segment->base, segment->capacity);
+    std::string logging_name = GetLogFileName(dir_name_, segment->ts, true, segment->index);
+    bool renamed = false;
+    if (used_length == 0)
+    {
+        unlink(logging_name.c_str());
+    }
+    else
+    {
+        // NOTE ignore truncate/rename fail
+        (void)ftruncate(segment->fd, used_length);
+        std::string logged_name = GetLogFileName(dir_name_, segment->ts, false, segment->index);
+        renamed = logged && rename(logging_name.c_str(), logged_name.c_str()) == 0;
+    }
+    close(segment->fd);
+    segment->fd = -1;
+    segment->base = nullptr;
+    // 可能还有线程持有该对象的指针，留待复用
+    spare_segments_.push_back(segment);
+    return renamed;
+}
+}  // namespace Nlog
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+#include "../details/Utils.h"
+
+namespace Nlog
+{
+// 基于内存映射的日志文件输出后端。
+// 日志文件按固定大小预分配（fallocate）并映射到内存，写日志时用原子fetch_add预留空间后直接memcpy，
+// 多个线程可以同时写，正常写入路径上没有锁和系统调用。当前文件写满后切换到预先创建好的下一个文件，
+// 写完的文件由后台线程截断到实际长度并从.logging重命名为.log，再预先创建下一个文件，
+// 切换文件的写日志线程只替换当前文件的指针。文件命名规则与RotateFileLogger一致。
+// 正在写入的文件大小为预分配的大小，未写入的部分为0，程序退出或者重启恢复时截断到实际长度
+class MmapFileLogger : public Logger
+{
+  public:
+    // 默认单个日志文件大小，与RotateFileLogger一致
+    static constexpr size_t kDefaultSegmentSize = 10 * 1024 * 1024;
+
+    ~MmapFileLogger() override;
+
+    void Write(const LogMessage& log_message) override;
+    // 映射的内存已经在内核的页缓存中，由内核负责写回，不需要额外操作
+    void Flush() override;
+
+    /**
+     * @param dir_name 日志文件输出目录
+     * @param segment_size 单个日志文件大小，向上取整为4KB的倍数，最小1MB
+     * @return 创建失败时返回nullptr
+     */
+    static std::shared_ptr<MmapFileLogger> Create(const std::string& dir_name,
+                                                  size_t segment_size = kDefaultSegmentSize);
+
+    /**
+     * 设置日志文件写完（重命名为.log）后的回调，如交给LogCompressor压缩
+     * @param callback 在后台线程中调用，阻塞时会推迟下一个文件的创建
+     */
+    void SetRotateCallback(RotateCallback callback);
+
+  private:
+    struct Segment;
+
+    // 交给后台线程的切换任务
+    struct RotateJob
+    {
+        // 写满的文件及其实际长度，为nullptr表示之前没有文件
+        Segment* full_segment;
+        size_t used_length;
+        // 开始写入的文件，改名为开始写入的时间
+        Segment* started_segment;
+    };
+
+    MmapFileLogger(const std::string& dir_name, size_t segment_size);
+
+    bool Init();
+
+    /**
+     * 把上次运行遗留的.logging文件截断到实际长度并重命名为.log
+     */
+    void RecoverLoggingFiles();
+
+    /**
+     * 创建并映射一个新的日志文件，只在初始化、后台线程和析构时调用
+     * @return 失败时返回nullptr
+     */
+    Segment* CreateSegment();
+
+    /**
+     * 切换到预先创建的下一个日志文件，由第一个写不下的线程调用。写满的文件交给后台线程处理，
+     * 只有下一个文件还没有创建好时才等待后台线程
+     * @param full_segment 写满的文件
+     * @param used_length 写满的文件的实际长度
+     */
+    void Rotate(Segment* full_segment, size_t used_length);
+
+    /**
+     * 等待正在写入的线程结束，然后解除映射并截断到实际长度，只在后台线程和析构时调用
+     * @param segment 日志文件
+     * @param used_length 实际长度，为0时删除文件
+     * @param logged 是否重命名为.log
+     * @return 是否已经重命名为.log
+     */
+    bool FinishSegment(Segment* segment, size_t used_length, bool logged);
+
+    // 后台线程：处理切换任务，预先创建下一个文件
+    void Run();
+
+  private:
+    // 日志文件输出目录
+    const std::string dir_name_;
+    // 单个日志文件大小
+    const size_t segment_size_;
+    // 当前写入的日志文件
+    std::atomic<Segment*> current_;
+    // rotate_mutex_ 串行化日志文件的切换，保护下面的成员
+    std::mutex rotate_mutex_;
+    // 有切换任务、需要创建下一个文件或者需要退出时通知后台线程
+    std::condition_variable job_cond_;
+    // 后台线程创建完下一个文件（或者创建失败）时通知等待的写日志线程
+    std::condition_variable ready_cond_;
+    // 预先创建的下一个日志文件
+    Segment* next_;
+    // 上次创建下一个文件失败，有线程需要新文件时再重试
+    bool create_failed_;
+    // 还没有处理的切换任务
+    std::vector<RotateJob> rotate_jobs_;
+    // 析构时通知后台线程处理完切换任务后退出
+    bool stopping_;
+    // 日志文件写完后的回调
+    RotateCallback rotate_callback_;
+    // 已经写完的Segment对象，其他线程可能还持有指针，不释放而是留给下一个文件复用，只由后台线程访问
+    std::vector<Segment*> spare_segments_;
+    // 后台线程
+    std::thread rotate_thread_;
+};
+
+typedef std::shared_ptr<MmapFileLogger> MmapFileLoggerPtr;
+}  // namespace Nlog
@@ -1,229 +1,263 @@
 #include "RotateFileLogger.h"
 
-#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <cstdlib>
-#include <sstream>
+#include <cstring>
 #include <iostream>
 
 #include "../details/Utils.h"
 
 namespace Nlog
 {
-constexpr char kLoggingFileSuffix[] = "logging";
-constexpr char kLoggedFileSuffix[] = "log";
-// 单个日志文件最多10M
-constexpr int64_t kLogFileSizeLimit = 10 * 1024 * 1024;
-// 日志文件切割时间点 整15分钟切割
-constexpr int kLogFileJumpTimeLimit = 15;
+// 写缓冲区按页对齐，大小为页大小的整数倍
+constexpr size_t kBufferAlignment = 4096;
+// 写缓冲区至少能放下头部和一条不需要扩容的日志，更长的日志与缓冲区一起用writev写出
+constexpr size_t kMinBufferSize =
+    HeaderPattern::kMaxHeaderSize + LogStream::kInlineSize + LogStream::kReservedSize;
 
-static size_t GetFileSize(const std::string &file_name) {
-    struct stat st;
-    if (stat(file_name.c_str(), &st) == 0) {
-        return st.st_size;
-    }
-    // 默认没超过限制，包括文件不存在等情况
-    return 0;
-}
+constexpr size_t RotateFileLogger::kDefaultBufferSize;
 
 std::string RotateFileLogger::GetLoggingFileName() {
     return GetFileNameWithTs(last_log_timestamp_, true, log_index_);
 }
 
-static bool EndsWith(const std::string &str, const std::string &suffix) {
-    return str.size() >= suffix.size() &&
-           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
-}
-
-static time_t GetTsFromLoggingFileName(const std::string &log_file_name,
-                                       int &log_index) {
-    tm ltm = {0};
-    int ret = sscanf(log_file_name.c_str(), "%04d%02d%02d%02d%02d.%d.logging",
-                     &ltm.tm_year, &ltm.tm_mon, &ltm.tm_mday, &ltm.tm_hour,
-                     &ltm.tm_min, &log_index);
-    constexpr int kLogFieldNum = 6;
-    if (ret != kLogFieldNum) {
-        // format error
-        std::cerr << "WARN: log file name format error, log_file_name:"
-                         << log_file_name << std::endl;
-        return 0;
-    }
-    ltm.tm_year -= 1900;
-    ltm.tm_mon -= 1;
-    return mktime(&ltm);
-}
-
-// 恢复打印的日志
+// 恢复打印的日志，从启动时建立的索引中取最新的.logging文件，不再遍历目录
 void RotateFileLogger::RecoverLoggingFile() {
-    DIR *dir = opendir(dir_name_.c_str());
-    if (nullptr == dir) {
-        std::cerr << "INFO: dir not exist, dir:" << dir_name_ << std::endl;
+    LogSegment segment;
+    if (!retention_->RecoverLoggingSegment(segment)) {
         return;
     }
-    struct dirent *dp = nullptr;
-    while ((dp = readdir(dir)) != nullptr) {
-        if (EndsWith(dp->d_name, kLoggingFileSuffix)) {
-            time_t logging_ts = GetTsFromLoggingFileName(dp->d_name, log_index_);
-            if (0 == logging_ts) {
-                continue;
-            }
 
-            if (log_file_ != nullptr) {
-                fclose(log_file_);
-            }
+    CloseLogFile();
 
-            std::string log_file_name =
-                GetFileNameWithTs(logging_ts, true, log_index_);
-            log_file_ = fopen(log_file_name.c_str(), "a");
-            if (nullptr == log_file_) {
-                std::cerr << "open old log file fail, log_file:"
-                                 << log_file_name << std::endl;
-            } else {
-                written_bytes_ = GetFileSize(log_file_name);
-                last_log_timestamp_ = logging_ts;
-            }
-            break;
-        }
+    std::string log_file_name =
+        GetFileNameWithTs(segment.ts, true, segment.index);
+    log_fd_ = OpenLogFile(log_file_name);
+    if (log_fd_ < 0) {
+        std::cerr << "open old log file fail, log_file:"
+                         << log_file_name << std::endl;
+    } else {
+        written_bytes_ = GetFileSize(log_file_name);
+        last_log_timestamp_ = segment.ts;
+        log_index_ = segment.index;
+        next_rotate_time_ = rotation_policy_.GetNextRotateTime(segment.ts);
     }
-
-    (void)closedir(dir);
 }
 
 std::string RotateFileLogger::GetFileNameWithTs(time_t ts, bool is_logging,
                                                 int log_index) const {
-    // tm_year 从1990开始算
-    // tm_mon 从0开始
-    tm ltm = {0};
-    localtime_r(&ts, &ltm);
-    char buff[1024];
-    int buff_writen_size = snprintf(
-        buff, sizeof buff, "%s/%04d%02d%02d%02d%02d.%d.%s", dir_name_.c_str(),
-        ltm.tm_year + 1900, ltm.tm_mon + 1, ltm.tm_mday, ltm.tm_hour, ltm.tm_min,
-        log_index, (is_logging ? kLoggingFileSuffix : kLoggedFileSuffix));
-    return std::string(buff, buff_writen_size);
-}
-
-RotateFileLogger::RotateFileLogger(const std::string &dir_name)
-    : Logger("rotate_file"), dir_name_(dir_name), log_file_(nullptr),
+    return GetLogFileName(dir_name_, ts, is_logging, log_index);
+}
+
+RotateFileLogger::RotateFileLogger(const std::string &dir_name,
+                                   const RotationPolicy &rotation_policy,
+                                   const RetentionPolicy &retention_policy,
+                                   size_t buffer_size)
+    : Logger("rotate_file"), dir_name_(dir_name), log_fd_(-1),
+      buffer_(nullptr), buffer_capacity_(0), buffer_size_(0),
       last_log_timestamp_(0), flush_after_write_(false), log_index_(0),
-      written_bytes_(0) {}
+      written_bytes_(0), rotation_policy_(rotation_policy),
+      max_file_size_(rotation_policy.GetMaxFileSize()), next_rotate_time_(0),
+      retention_policy_(retention_policy) {
+    if (buffer_size < kMinBufferSize) {
+        buffer_size = kMinBufferSize;
+    }
+    buffer_capacity_ = (buffer_size + kBufferAlignment - 1) / kBufferAlignment *
+                       kBufferAlignment;
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, kBufferAlignment, buffer_capacity_) == 0) {
+        buffer_ = static_cast<char *>(buffer);
+    } else {
+        buffer_capacity_ = 0;
+    }
+}
 
 RotateFileLogger::~RotateFileLogger() {
-    if (log_file_ != nullptr) {
-        fclose(log_file_);
-        log_file_ = nullptr;
-    }
+    CloseLogFile();
+    free(buffer_);
 }
 
 std::shared_ptr<RotateFileLogger>
-RotateFileLogger::Create(const std::string &dir_name) {
-    RotateFileLoggerPtr logger(new RotateFileLogger(dir_name));
-    if (!logger->Init()) {
+RotateFileLogger::Create(const std::string &dir_name,
+                         const RotationPolicy &rotation_policy,
+                         const RetentionPolicy &retention_policy,
+                         size_t buffer_size) {
+    RotateFileLoggerPtr logger(new RotateFileLogger(
+        dir_name, rotation_policy, retention_policy, buffer_size));
+    if (logger->buffer_ == nullptr || !logger->Init()) {
         return nullptr;
     }
     return logger;
 }
 
 bool RotateFileLogger::Init() {
-    if (!DirectoryExists(dir_name_)) {
-        // 目录不存在且创建目录失败，则失败
-        return CreateDirectory(dir_name_);
-    } else {
-        RecoverLoggingFile();
+    // 目录不存在且创建目录失败，则失败
+    if (!DirectoryExists(dir_name_) && !CreateDirectory(dir_name_)) {
+        return false;
     }
+    // 启动时扫描一次目录建立索引，之后只在切分时更新
+    retention_.reset(new LogRetention(dir_name_, retention_policy_));
+    RecoverLoggingFile();
     return true;
 }
 
-void RotateFileLogger::CheckFileAndRotate() {
-    int64_t cur_time = time(0);
-
-    bool need_rotate = false;
-    int new_log_index = log_index_;
-    if (last_log_timestamp_ > 0) {
-        if (IsTimeJump(cur_time, last_log_timestamp_)) {
-            need_rotate = true;
-            // 如果是切到下一时间点的日志，则重置log_index
-            new_log_index = 0;
-        } else if (written_bytes_ > kLogFileSizeLimit) {
-            need_rotate = true;
-            ++new_log_index;
-        }
-    } else if (0 == last_log_timestamp_) {
-        need_rotate = true;
-        new_log_index = 0;
+void RotateFileLogger::CheckFileAndRotate(time_t cur_time) {
+    // 下一个切分时间点在打开文件时已经算好，不需要切分时只有两次整数比较
+    if (cur_time < next_rotate_time_ && written_bytes_ <= max_file_size_) {
+        return;
     }
 
-    if (!need_rotate) {
-        return;
+    // 如果是切到下一时间点的日志，则重置log_index，按大小切分时递增
+    int new_log_index = 0;
+    if (last_log_timestamp_ > 0 && cur_time < next_rotate_time_) {
+        new_log_index = log_index_ + 1;
     }
 
     // 切分日志
-    if (log_file_ != nullptr) {
+    if (log_fd_ >= 0) {
+        // 先写出缓冲区中属于旧文件的数据
+        CloseLogFile();
         // 超过1h，logging后缀文件更名为log后缀
         if (last_log_timestamp_ != 0) {
             std::string last_logging_suffix = GetLoggingFileName();
             std::string last_logged_suffix =
                 GetFileNameWithTs(last_log_timestamp_, false, log_index_);
             // NOTE ignore rename fail
-            rename(last_logging_suffix.c_str(), last_logged_suffix.c_str());
+            if (rename(last_logging_suffix.c_str(), last_logged_suffix.c_str()) == 0) {
+                stats_.rotations.Add();
+                // 只更新索引并唤醒后台线程，删除旧文件不在写日志的线程中做
+                retention_->OnRotate(last_log_timestamp_, log_index_, written_bytes_);
+                if (rotate_callback_) {
+                    rotate_callback_(last_logged_suffix);
+                }
+            }
         }
-        fclose(log_file_);
-        log_file_ = nullptr;
     }
     written_bytes_ = 0;
 
     // 打开新的日志文件
     std::string log_file_name = GetFileNameWithTs(cur_time, true, new_log_index);
 
-    log_file_ = fopen(log_file_name.c_str(), "a");
-    if (nullptr == log_file_) {
-        // 打开文件失败直接返回，不更新最新的时间戳
+    log_fd_ = OpenLogFile(log_file_name);
+    if (log_fd_ < 0) {
+        // 打开文件失败直接返回，下次写日志时重试
+        next_rotate_time_ = 0;
         return;
     }
     last_log_timestamp_ = cur_time;
     log_index_ = new_log_index;
-}
-
-bool RotateFileLogger::IsTimeJump(time_t cur_ts, time_t logging_ts) {
-    // NOTICE localtime线程不安全，使用localtime_r
-    // 每 15 分钟做一次切分
-    tm cur_tm = {0};
-    tm logging_tm = {0};
-    localtime_r(&cur_ts, &cur_tm);
-    localtime_r(&logging_ts, &logging_tm);
-    return ((0 == cur_tm.tm_min % kLogFileJumpTimeLimit &&
-             cur_tm.tm_min != logging_tm.tm_min) ||
-            cur_tm.tm_hour != logging_tm.tm_hour ||
-            cur_tm.tm_mday != logging_tm.tm_mday ||
-            cur_tm.tm_mon != logging_tm.tm_mon ||
-            cur_tm.tm_year != logging_tm.tm_year);
+    next_rotate_time_ = rotation_policy_.GetNextRotateTime(cur_time);
+    retention_->OnOpen(cur_time, new_log_index, 0);
 }
 
 void RotateFileLogger::Write(const LogMessage &log_message) {
-    std::lock_guard<std::mutex> lock_guard(write_mutex_);
+    size_t text_length = log_message.GetLogTextLength();
 
-    // 检查是否需要日志切分
-    CheckFileAndRotate();
+    StatsLockGuard lock_guard(write_mutex_, stats_);
 
-    if (log_file_ != nullptr) {
-        std::stringstream ss;
-        ss << log_message.GetLogHeader(header_pattern_) << log_message.GetLogText();
-        const std::string &log_text(ss.str());
-        written_bytes_ += log_text.size();
-        fwrite(log_text.c_str(), log_text.size(), 1, log_file_);
-        if (flush_after_write_)
-            fflush(log_file_);
+    // 检查是否需要日志切分，按日志自己的时间戳判断，不需要再取当前时间
+    CheckFileAndRotate(log_message.GetTime().tv_sec);
+
+    if (log_fd_ < 0) {
+        return;
+    }
+
+    // 剩余空间不一定放得下头部和文本时先写出缓冲区
+    if (buffer_capacity_ - buffer_size_ <
+        HeaderPattern::kMaxHeaderSize + text_length) {
+        FlushBuffer();
+    }
+
+    // 头部和文本直接写到缓冲区
+    size_t header_length = FormatHeader(log_message, buffer_ + buffer_size_,
+                                        HeaderPattern::kMaxHeaderSize);
+    if (buffer_capacity_ - buffer_size_ - header_length >= text_length) {
+        memcpy(buffer_ + buffer_size_ + header_length, log_message.GetLogText(),
+               text_length);
+        buffer_size_ += header_length + text_length;
+    } else {
+        // 文本比缓冲区还长，与缓冲区中的头部一起写出，不再拷贝
+        struct iovec iov[2];
+        iov[0].iov_base = buffer_;
+        iov[0].iov_len = buffer_size_ + header_length;
+        iov[1].iov_base = const_cast<char *>(log_message.GetLogText());
+        iov[1].iov_len = text_length;
+        uint64_t begin_ns = GetStatsNowNs();
+        WriteAll(iov, 2);
+        stats_.write_latency.RecordSince(begin_ns);
+        buffer_size_ = 0;
+    }
+    written_bytes_ += header_length + text_length;
+    stats_.messages.Add();
+    stats_.bytes.Add(header_length + text_length);
+
+    if (flush_after_write_) {
+        FlushBuffer();
     }
 }
 
 void RotateFileLogger::Flush() {
-    std::lock_guard<std::mutex> lock_guard(write_mutex_);
-    if (log_file_) {
-        fflush(log_file_);
+    uint64_t begin_ns = GetStatsNowNs();
+    StatsLockGuard lock_guard(write_mutex_, stats_);
+    FlushBuffer();
+    stats_.flush_latency.RecordSince(begin_ns);
+}
+
+int RotateFileLogger::OpenLogFile(const std::string &log_file_name) {
+    return open(log_file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0666);
+}
+
+void RotateFileLogger::FlushBuffer() {
+    if (buffer_size_ == 0) {
+        return;
+    }
+    if (log_fd_ >= 0) {
+        struct iovec iov;
+        iov.iov_base = buffer_;
+        iov.iov_len = buffer_size_;
+        uint64_t begin_ns = GetStatsNowNs();
+        WriteAll(&iov, 1);
+        stats_.write_latency.RecordSince(begin_ns);
     }
+    buffer_size_ = 0;
+}
+
+void RotateFileLogger::WriteAll(struct iovec *iov, int iov_count) {
+    while (iov_count > 0) {
+        ssize_t n = writev(log_fd_, iov, iov_count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 写失败（如磁盘满）时丢弃数据，避免一直阻塞打印日志的线程
+            return;
+        }
+        // 部分写入时跳过已经写出的部分
+        while (iov_count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iov_count;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+void RotateFileLogger::CloseLogFile() {
+    if (log_fd_ < 0) {
+        return;
+    }
+    FlushBuffer();
+    close(log_fd_);
+    log_fd_ = -1;
 }
 
 void RotateFileLogger::SetFlushAfterWrite(bool on) {
@@ -231,4 +265,9 @@ void RotateFileLogger::SetFlushAfterWrite(bool on) {
     flush_after_write_ = on;
 }
 
-}
\ No newline at end of file
+void RotateFileLogger::SetRotateCallback(RotateCallback callback) {
+    std::lock_guard<std::mutex> lock_guard(write_mutex_);
+    rotate_callback_ = std::move(callback);
+}
+
+}
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <cstdio>
 #include <ctime>
 #include <memory>
 #include <mutex>
 
 #include "Logger.h"
+#include "../details/LogRetention.h"
+#include "../details/RotationPolicy.h"
+#include "../details/Utils.h"
 
 namespace Nlog
 {
@@ -17,8 +22,20 @@ class RotateFileLogger : public Logger
     void Write(const LogMessage& log_message) override;
     void Flush() override;
 
+    // 默认写缓冲区大小
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+    /**
+     * @param dir_name 日志文件输出目录
+     * @param rotation_policy 切分策略，默认超过10MB或者整15分钟时切分
+     * @param retention_policy 保留策略，默认不删除日志文件
+     * @param buffer_size 写缓冲区大小，向上取整为4KB的倍数，更长的日志与缓冲区一起用writev写出
+     */
     static std::shared_ptr<RotateFileLogger> Create(
-        const std::string& dir_name);
+        const std::string& dir_name,
+        const RotationPolicy& rotation_policy = RotationPolicy(),
+        const RetentionPolicy& retention_policy = RetentionPolicy(),
+        size_t buffer_size = kDefaultBufferSize);
 
     /**
      * 设置是否write后自动调用flush
@@ -26,11 +43,46 @@ class RotateFileLogger : public Logger
      */
     void SetFlushAfterWrite(bool on);
 
+    /**
+     * 设置日志文件写完（重命名为.log）后的回调，如交给LogCompressor压缩
+     * @param callback 在写日志的线程中调用，不能阻塞
+     */
+    void SetRotateCallback(RotateCallback callback);
+
+    /**
+     * @return 日志目录中的所有日志文件，按时间从旧到新排列
+     */
+    std::vector<LogSegment> GetSegments() { return retention_->GetSegments(); }
+
   private:
-    explicit RotateFileLogger(const std::string& dir_name);
+    RotateFileLogger(const std::string& dir_name,
+                     const RotationPolicy& rotation_policy,
+                     const RetentionPolicy& retention_policy,
+                     size_t buffer_size);
 
     bool Init();
 
+    /**
+     * @brief 打开日志文件（追加写）
+     * @return 文件描述符，失败返回-1
+     **/
+    static int OpenLogFile(const std::string& log_file_name);
+
+    /**
+     * @brief 把写缓冲区中的数据写到文件，调用方需要持有write_mutex_
+     **/
+    void FlushBuffer();
+
+    /**
+     * @brief 写出全部数据，处理部分写入和信号中断
+     **/
+    void WriteAll(struct iovec* iov, int iov_count);
+
+    /**
+     * @brief 关闭当前日志文件，关闭前写出缓冲区中的数据
+     **/
+    void CloseLogFile();
+
     /**
      * @brief 获取一个时间戳对应的文件名
      * @param ts 时间戳
@@ -54,26 +106,43 @@ class RotateFileLogger : public Logger
 
     /**
      * @brief 检查并切分日志
+     * @param cur_time 当前日志的时间戳
      **/
-    void CheckFileAndRotate();
-
-    static bool IsTimeJump(time_t cur_ts, time_t logging_ts);
+    void CheckFileAndRotate(time_t cur_time);
 
   private:
     // write_mutex_ 用于同步Write函数
     std::mutex write_mutex_;
     // 日志文件输出目录
     const std::string dir_name_;
-    // 当前输出日志文件的句柄
-    FILE* log_file_;
+    // 当前输出日志文件的描述符，以O_APPEND打开
+    int log_fd_;
+    // 写缓冲区，按页对齐，日志头部和文本直接格式化到这里，写满或Flush时用write(2)写到文件
+    char* buffer_;
+    // 写缓冲区大小
+    size_t buffer_capacity_;
+    // 写缓冲区已用大小
+    size_t buffer_size_;
     // 最后一次打印日志的时间戳
     time_t last_log_timestamp_;
     // write后自动调用flush
     bool flush_after_write_;
     // 当前时间节点下输出日志文件的序号
     int log_index_;
-    // 单日志文件已写入的字节数
+    // 单日志文件已写入的字节数，包括还在写缓冲区中的数据
     size_t written_bytes_;
+    // 日志文件写完后的回调
+    RotateCallback rotate_callback_;
+    // 切分策略
+    const RotationPolicy rotation_policy_;
+    // 单个文件的大小上限，不按大小切分时为最大值
+    const size_t max_file_size_;
+    // 当前文件的下一个切分时间点，为0时下次写日志会打开新文件
+    time_t next_rotate_time_;
+    // 保留策略
+    const RetentionPolicy retention_policy_;
+    // 日志目录的索引，负责删除超过保留策略的日志文件
+    std::unique_ptr<LogRetention> retention_;
 };
 
 typedef std::shared_ptr<RotateFileLogger> RotateFileLoggerPtr;
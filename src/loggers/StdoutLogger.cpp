@@ -12,22 +12,32 @@ void StdoutLogger::Write(const LogMessage& log_message)
 {
     static const char* color_end_tag = "\033[0m";
     const char* color_begin_tag = GetLogColorBySeverity(log_message.GetLogSeverity());
-    std::lock_guard<std::mutex> lock_guard(write_mutex_);
+    char header[HeaderPattern::kMaxHeaderSize];
+    size_t header_length = FormatHeader(log_message, header, sizeof(header));
+    StatsLockGuard lock_guard(write_mutex_, stats_);
+    uint64_t begin_ns = GetStatsNowNs();
     if (color_begin_tag != nullptr)
     {
-        std::cout << color_begin_tag << log_message.GetLogHeader(header_pattern_) << color_end_tag
-                  << log_message.GetLogText();
+        std::cout << color_begin_tag;
+        std::cout.write(header, header_length);
+        std::cout << color_end_tag;
     }
     else
     {
-        std::cout << log_message.GetLogHeader(header_pattern_) << log_message.GetLogText();
+        std::cout.write(header, header_length);
     }
+    std::cout.write(log_message.GetLogText(), log_message.GetLogTextLength());
     std::cout.flush();
+    stats_.write_latency.RecordSince(begin_ns);
+    stats_.messages.Add();
+    stats_.bytes.Add(header_length + log_message.GetLogTextLength());
 }
 
 void StdoutLogger::Flush()
 {
-    std::lock_guard<std::mutex> lock_guard(write_mutex_);
+    uint64_t begin_ns = GetStatsNowNs();
+    StatsLockGuard lock_guard(write_mutex_, stats_);
     std::cout.flush();
+    stats_.flush_latency.RecordSince(begin_ns);
 }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 namespace Nlog
 {
+// 输出到标准输出，每条日志立即写出并flush。需要批量写出、管道背压时丢弃日志的场景使用ConsoleLogger
 class StdoutLogger : public Logger
 {
   public:
@@ -0,0 +1,555 @@
+#include "UringFileLogger.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../details/IoUring.h"
+#include "../details/Utils.h"
+
+namespace Nlog
+{
+constexpr size_t UringFileLogger::kDefaultBufferSize;
+constexpr size_t UringFileLogger::kDefaultBufferCount;
+constexpr size_t UringFileLogger::kIoThreadCount;
+// 写缓冲区按页对齐，大小为页大小的整数倍
+constexpr size_t kBufferAlignment = 4096;
+// 写缓冲区至少能放下一条默认最大长度的日志，调大最大长度后放不下的日志被丢弃
+constexpr size_t kMinBufferSize =
+    HeaderPattern::kMaxHeaderSize + LogStream::kDefaultMaxSize + LogStream::kReservedSize;
+// 最少两个缓冲区，一个在写文件时另一个可以继续格式化日志
+constexpr size_t kMinBufferCount = 2;
+// io_uring完成项的user_data为缓冲区地址，最低位为1表示是链接在写操作后的fdatasync
+constexpr uint64_t kFsyncTag = 1;
+
+struct UringFileLogger::LogFile
+{
+    int fd;
+    // 文件名中的时间戳和序号
+    time_t ts;
+    int index;
+    // 已经分配给缓冲区的长度，即下一个缓冲区的写入位置
+    uint64_t size;
+    // 正在写入这个文件的缓冲区个数
+    int pending;
+    // 已经切换到新文件，写完后关闭并重命名为.log
+    bool closing;
+    // 线程池模式下需要fdatasync覆盖的最大提交序号，0表示没有
+    uint64_t sync_seq;
+};
+
+struct UringFileLogger::Buffer
+{
+    char* data;
+    // 已经格式化的日志长度和条数
+    size_t size;
+    size_t messages;
+    // 注册到io_uring的固定缓冲区序号
+    int index;
+    // 交给后台线程后有效：目标文件、文件中的写入位置、已经写出的长度、写完后是否fdatasync
+    LogFile* file;
+    uint64_t offset;
+    size_t written;
+    bool sync;
+    // 提交给io_uring还没有完成的操作个数
+    int inflight_ops;
+    // 交给后台线程的顺序，从1开始
+    uint64_t seq;
+};
+
+UringFileLogger::UringFileLogger(const std::string& dir_name, const RotationPolicy& rotation_policy,
+                                 size_t buffer_size, size_t buffer_count, bool drop_when_full)
+    : Logger("uring_file"),
+      dir_name_(dir_name),
+      rotation_policy_(rotation_policy),
+      max_file_size_(rotation_policy.GetMaxFileSize()),
+      buffer_size_((std::max(buffer_size, kMinBufferSize) + kBufferAlignment - 1) / kBufferAlignment *
+                   kBufferAlignment),
+      drop_when_full_(drop_when_full),
+      buffers_(std::max(buffer_count, kMinBufferCount)),
+      current_buffer_(nullptr),
+      current_file_(nullptr),
+      log_index_(0),
+      next_rotate_time_(0),
+      submit_seq_(0),
+      stopping_(false),
+      buffers_registered_(false),
+      dropped_count_(0)
+{
+    for (size_t i = 0; i < buffers_.size(); ++i)
+    {
+        Buffer& buffer = buffers_[i];
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.index = static_cast<int>(i);
+        void* data = nullptr;
+        if (posix_memalign(&data, kBufferAlignment, buffer_size_) == 0)
+        {
+            buffer.data = static_cast<char*>(data);
+            free_buffers_.push_back(&buffer);
+        }
+    }
+}
+
+UringFileLogger::~UringFileLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SubmitCurrentBuffer(false);
+        stopping_ = true;
+    }
+    io_cond_.notify_all();
+    for (std::thread& io_thread : io_threads_)
+    {
+        io_thread.join();
+    }
+
+    // 保持.logging后缀，下次启动时继续写入
+    if (current_file_ != nullptr)
+    {
+        close(current_file_->fd);
+        delete current_file_;
+    }
+    uring_.reset();
+    for (Buffer& buffer : buffers_)
+    {
+        free(buffer.data);
+    }
+}
+
+std::shared_ptr<UringFileLogger> UringFileLogger::Create(const std::string& dir_name,
+                                                         const RotationPolicy& rotation_policy, size_t buffer_size,
+                                                         size_t buffer_count, bool drop_when_full)
+{
+    UringFileLoggerPtr logger(
+        new UringFileLogger(dir_name, rotation_policy, buffer_size, buffer_count, drop_when_full));
+    if (logger->free_buffers_.size() != logger->buffers_.size() || !logger->Init())
+    {
+        return nullptr;
+    }
+    return logger;
+}
+
+bool UringFileLogger::Init()
+{
+    if (!DirectoryExists(dir_name_))
+    {
+        // 目录不存在且创建目录失败，则失败
+        if (!CreateDirectory(dir_name_)) return false;
+    }
+    else
+    {
+        RecoverLoggingFile();
+    }
+
+    if (InitUring())
+    {
+        io_threads_.emplace_back(&UringFileLogger::RunUring, this);
+    }
+    else
+    {
+        uring_.reset();
+        for (size_t i = 0; i < kIoThreadCount; ++i)
+        {
+            io_threads_.emplace_back(&UringFileLogger::RunWorker, this);
+        }
+    }
+    return true;
+}
+
+bool UringFileLogger::InitUring()
+{
+    // 每个缓冲区最多同时提交一个写操作和一个fdatasync，提交队列不会满
+    uring_ = make_unique<IoUring>();
+    if (!uring_->Init(static_cast<unsigned>(buffers_.size() * 2))) return false;
+    // 链接在写操作后的fdatasync需要5.3以上的内核，用5.4加入的IORING_FEAT_SINGLE_MMAP判断
+    if ((uring_->GetFeatures() & IORING_FEAT_SINGLE_MMAP) == 0) return false;
+
+    std::vector<struct iovec> iovecs(buffers_.size());
+    for (size_t i = 0; i < buffers_.size(); ++i)
+    {
+        iovecs[i].iov_base = buffers_[i].data;
+        iovecs[i].iov_len = buffer_size_;
+    }
+    buffers_registered_ = uring_->RegisterBuffers(iovecs.data(), static_cast<unsigned>(iovecs.size()));
+    // 注册失败（如超过RLIMIT_MEMLOCK）时用IORING_OP_WRITE写，需要5.6以上的内核，
+    // 更早的内核中io_uring_setup能成功但每个写操作都返回-EINVAL
+    return buffers_registered_ || uring_->IsOpSupported(IORING_OP_WRITE);
+}
+
+void UringFileLogger::RecoverLoggingFile()
+{
+    DIR* dir = opendir(dir_name_.c_str());
+    if (nullptr == dir)
+    {
+        std::cerr << "INFO: dir not exist, dir:" << dir_name_ << std::endl;
+        return;
+    }
+
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr)
+    {
+        if (!EndsWith(dp->d_name, kLoggingFileSuffix)) continue;
+
+        int log_index = 0;
+        time_t logging_ts = GetTsFromLoggingFileName(dp->d_name, log_index);
+        if (0 == logging_ts) continue;
+
+        current_file_ = OpenLogFile(logging_ts, log_index);
+        if (current_file_ == nullptr)
+        {
+            std::cerr << "open old log file fail, log_file:" << dp->d_name << std::endl;
+        }
+        else
+        {
+            log_index_ = log_index;
+            next_rotate_time_ = rotation_policy_.GetNextRotateTime(logging_ts);
+        }
+        break;
+    }
+
+    (void)closedir(dir);
+}
+
+UringFileLogger::LogFile* UringFileLogger::OpenLogFile(time_t ts, int log_index)
+{
+    // 不使用O_APPEND，写入位置由缓冲区提交的顺序决定，多个缓冲区可以同时写
+    std::string log_file_name = GetLogFileName(dir_name_, ts, true, log_index);
+    int fd = open(log_file_name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0) return nullptr;
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    LogFile* log_file = new LogFile;
+    log_file->fd = fd;
+    log_file->ts = ts;
+    log_file->index = log_index;
+    log_file->size = size > 0 ? static_cast<uint64_t>(size) : 0;
+    log_file->pending = 0;
+    log_file->closing = false;
+    log_file->sync_seq = 0;
+    return log_file;
+}
+
+void UringFileLogger::FinishLogFile(LogFile* log_file)
+{
+    close(log_file->fd);
+    // NOTE ignore rename fail
+    std::string logged_name = GetLogFileName(dir_name_, log_file->ts, false, log_file->index);
+    if (rename(GetLogFileName(dir_name_, log_file->ts, true, log_file->index).c_str(), logged_name.c_str()) == 0 &&
+        rotate_callback_)
+    {
+        rotate_callback_(logged_name);
+    }
+    delete log_file;
+}
+
+void UringFileLogger::CheckFileAndRotate(time_t cur_time)
+{
+    int new_log_index = 0;
+    if (current_file_ != nullptr)
+    {
+        // 下一个切分时间点在打开文件时已经算好，不需要切分时只有两次整数比较
+        size_t written_bytes = current_file_->size + (current_buffer_ != nullptr ? current_buffer_->size : 0);
+        if (cur_time < next_rotate_time_ && written_bytes <= max_file_size_) return;
+
+        // 如果是切到下一时间点的日志，则重置log_index，按大小切分时递增
+        if (cur_time < next_rotate_time_)
+        {
+            new_log_index = log_index_ + 1;
+        }
+
+        // 缓冲区中的数据属于旧文件，旧文件在所有缓冲区写完后由后台线程关闭
+        stats_.rotations.Add();
+        SubmitCurrentBuffer(false);
+        current_file_->closing = true;
+        if (current_file_->pending == 0)
+        {
+            FinishLogFile(current_file_);
+        }
+        current_file_ = nullptr;
+    }
+
+    // 打开文件失败时下次写日志再重试
+    current_file_ = OpenLogFile(cur_time, new_log_index);
+    if (current_file_ != nullptr)
+    {
+        log_index_ = new_log_index;
+        next_rotate_time_ = rotation_policy_.GetNextRotateTime(cur_time);
+    }
+}
+
+void UringFileLogger::Write(const LogMessage& log_message)
+{
+    size_t text_length = log_message.GetLogTextLength();
+    // 空的缓冲区也放不下的日志直接丢弃，否则会一直换缓冲区
+    if (HeaderPattern::kMaxHeaderSize + text_length > buffer_size_)
+    {
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        stats_.dropped.Add();
+        return;
+    }
+
+    stats_.Lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_, std::adopt_lock);
+
+    // 检查是否需要日志切分，按日志自己的时间戳判断
+    CheckFileAndRotate(log_message.GetTime().tv_sec);
+
+    // 剩余空间不一定放得下头部和文本时把缓冲区交给后台线程，换一个空闲的缓冲区
+    for (;;)
+    {
+        if (current_buffer_ != nullptr)
+        {
+            if (buffer_size_ - current_buffer_->size >= HeaderPattern::kMaxHeaderSize + text_length) break;
+            SubmitCurrentBuffer(false);
+        }
+        if (!free_buffers_.empty())
+        {
+            current_buffer_ = free_buffers_.back();
+            free_buffers_.pop_back();
+            continue;
+        }
+        if (drop_when_full_)
+        {
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            stats_.dropped.Add();
+            return;
+        }
+        free_cond_.wait(lock);
+    }
+
+    // 打开日志文件失败
+    if (current_file_ == nullptr)
+    {
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        stats_.dropped.Add();
+        return;
+    }
+
+    // 头部和文本直接写到缓冲区
+    char* data = current_buffer_->data + current_buffer_->size;
+    size_t header_length = FormatHeader(log_message, data, HeaderPattern::kMaxHeaderSize);
+    memcpy(data + header_length, log_message.GetLogText(), text_length);
+    current_buffer_->size += header_length + text_length;
+    ++current_buffer_->messages;
+    stats_.messages.Add();
+    stats_.bytes.Add(header_length + text_length);
+}
+
+void UringFileLogger::Flush()
+{
+    uint64_t begin_ns = GetStatsNowNs();
+    StatsLockGuard lock(mutex_, stats_);
+    SubmitCurrentBuffer(true);
+    stats_.flush_latency.RecordSince(begin_ns);
+}
+
+void UringFileLogger::SetRotateCallback(RotateCallback callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    rotate_callback_ = std::move(callback);
+}
+
+void UringFileLogger::SubmitCurrentBuffer(bool sync)
+{
+    Buffer* buffer = current_buffer_;
+    if (buffer == nullptr || buffer->size == 0)
+    {
+        return;
+    }
+
+    // 缓冲区只在有日志文件时写入，切换文件前会先提交，因此current_file_一定不为空
+    buffer->file = current_file_;
+    buffer->offset = current_file_->size;
+    buffer->written = 0;
+    buffer->sync = sync;
+    buffer->seq = ++submit_seq_;
+    current_file_->size += buffer->size;
+    ++current_file_->pending;
+
+    pending_buffers_.push_back(buffer);
+    current_buffer_ = nullptr;
+    io_cond_.notify_one();
+}
+
+void UringFileLogger::CompleteBuffer(Buffer* buffer)
+{
+    LogFile* log_file = buffer->file;
+    if (--log_file->pending == 0 && log_file->closing)
+    {
+        FinishLogFile(log_file);
+    }
+
+    buffer->file = nullptr;
+    buffer->size = 0;
+    buffer->messages = 0;
+    free_buffers_.push_back(buffer);
+    free_cond_.notify_one();
+}
+
+bool UringFileLogger::TakeSync(const Buffer* buffer)
+{
+    LogFile* log_file = buffer->file;
+    if (log_file->sync_seq == 0) return false;
+    for (const Buffer& other : buffers_)
+    {
+        // 同一文件中更早交付的缓冲区还在写或者等待写，由它写完后执行
+        if (&other != buffer && other.file == log_file && other.seq < log_file->sync_seq) return false;
+    }
+    log_file->sync_seq = 0;
+    return true;
+}
+
+void UringFileLogger::DiscardBuffer(Buffer* buffer)
+{
+    buffer->written = buffer->size;
+    dropped_count_.fetch_add(buffer->messages, std::memory_order_relaxed);
+    stats_.dropped.Add(buffer->messages);
+}
+
+void UringFileLogger::PrepareUringWrite(Buffer* buffer)
+{
+    struct io_uring_sqe* sqe = uring_->GetSqe();
+    sqe->opcode = buffers_registered_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = buffer->file->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer->data + buffer->written);
+    sqe->len = static_cast<uint32_t>(buffer->size - buffer->written);
+    sqe->off = buffer->offset + buffer->written;
+    sqe->buf_index = static_cast<uint16_t>(buffer->index);
+    sqe->user_data = reinterpret_cast<uint64_t>(buffer);
+    buffer->inflight_ops = 1;
+
+    if (buffer->sync)
+    {
+        // 等之前提交的写操作都完成后再写，fdatasync链接在写操作之后，覆盖之前写入的所有数据
+        sqe->flags = IOSQE_IO_DRAIN | IOSQE_IO_LINK;
+        struct io_uring_sqe* fsync_sqe = uring_->GetSqe();
+        fsync_sqe->opcode = IORING_OP_FSYNC;
+        fsync_sqe->fd = buffer->file->fd;
+        fsync_sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        fsync_sqe->user_data = reinterpret_cast<uint64_t>(buffer) | kFsyncTag;
+        ++buffer->inflight_ops;
+    }
+}
+
+void UringFileLogger::RunUring()
+{
+    // 已经提交给io_uring还没有写完的缓冲区个数
+    size_t inflight_buffers = 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        // 每个缓冲区最多占两个提交项，提交队列的长度是缓冲区个数的两倍，不会满
+        while (!pending_buffers_.empty())
+        {
+            PrepareUringWrite(pending_buffers_.front());
+            pending_buffers_.pop_front();
+            ++inflight_buffers;
+        }
+        if (inflight_buffers == 0)
+        {
+            if (stopping_) break;
+            io_cond_.wait(lock);
+            continue;
+        }
+
+        // 提交并等待至少一个完成项，等待期间打印日志的线程可以继续交付缓冲区
+        lock.unlock();
+        int ret = uring_->Submit(1);
+        lock.lock();
+        if (ret < 0 && ret != -EBUSY && ret != -EAGAIN)
+        {
+            std::cerr << "WARN: io_uring_enter fail, error:" << strerror(-ret) << std::endl;
+        }
+
+        struct io_uring_cqe* cqe = nullptr;
+        while ((cqe = uring_->PeekCqe()) != nullptr)
+        {
+            Buffer* buffer = reinterpret_cast<Buffer*>(cqe->user_data & ~kFsyncTag);
+            bool is_fsync = (cqe->user_data & kFsyncTag) != 0;
+            int res = cqe->res;
+            uring_->SeenCqe();
+
+            if (!is_fsync)
+            {
+                if (res > 0)
+                {
+                    buffer->written += res;
+                }
+                else if (res != -EINTR && res != -EAGAIN)
+                {
+                    // 写失败（如磁盘满）或者没有写入任何数据时丢弃，避免一直重新提交
+                    DiscardBuffer(buffer);
+                }
+            }
+            if (--buffer->inflight_ops > 0) continue;
+
+            --inflight_buffers;
+            if (buffer->written < buffer->size)
+            {
+                // 部分写入时继续写剩余部分，链接的fdatasync已被取消，一起重新提交
+                pending_buffers_.push_front(buffer);
+            }
+            else
+            {
+                CompleteBuffer(buffer);
+            }
+        }
+    }
+}
+
+void UringFileLogger::RunWorker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        while (pending_buffers_.empty() && !stopping_)
+        {
+            io_cond_.wait(lock);
+        }
+        if (pending_buffers_.empty()) break;
+
+        Buffer* buffer = pending_buffers_.front();
+        pending_buffers_.pop_front();
+        lock.unlock();
+
+        int fd = buffer->file->fd;
+        uint64_t begin_ns = GetStatsNowNs();
+        while (buffer->written < buffer->size)
+        {
+            ssize_t n = pwrite(fd, buffer->data + buffer->written, buffer->size - buffer->written,
+                               buffer->offset + buffer->written);
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR) continue;
+                // 写失败（如磁盘满）或者没有写入任何数据时丢弃
+                DiscardBuffer(buffer);
+                break;
+            }
+            buffer->written += n;
+        }
+        stats_.write_latency.RecordSince(begin_ns);
+
+        // 另一个I/O线程可能还在写更早交付的缓冲区，fdatasync由同一文件中最后写完的缓冲区执行，
+        // 覆盖Flush之前交付的所有数据
+        lock.lock();
+        if (buffer->sync)
+        {
+            buffer->file->sync_seq = std::max(buffer->file->sync_seq, buffer->seq);
+        }
+        while (TakeSync(buffer))
+        {
+            lock.unlock();
+            fdatasync(fd);
+            lock.lock();
+        }
+        CompleteBuffer(buffer);
+    }
+}
+}  // namespace Nlog
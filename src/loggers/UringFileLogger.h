@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+#include "../details/RotationPolicy.h"
+#include "../details/Utils.h"
+
+namespace Nlog
+{
+class IoUring;
+
+// 异步写文件的日志输出后端，切分规则和文件命名与RotateFileLogger一致。
+// 打印日志的线程只把日志格式化到写缓冲区，写满或者Flush时把缓冲区交给后台I/O线程，
+// 后台线程通过io_uring批量提交写操作（使用注册的固定缓冲区，Flush时在写操作后链接fdatasync），
+// 内核不支持io_uring或者不支持需要的操作时退化为一个小的I/O线程池调用pwrite。打印日志的线程不会阻塞在write/fsync上，
+// 只有所有缓冲区都在写的时候才会等待空闲缓冲区（或者丢弃日志）
+class UringFileLogger : public Logger
+{
+  public:
+    // 默认写缓冲区大小
+    static constexpr size_t kDefaultBufferSize = 256 * 1024;
+    // 默认写缓冲区个数，即同时在写的缓冲区个数上限
+    static constexpr size_t kDefaultBufferCount = 8;
+    // 退化为线程池时的I/O线程数
+    static constexpr size_t kIoThreadCount = 2;
+
+    ~UringFileLogger() override;
+
+    void Write(const LogMessage& log_message) override;
+    // 把当前缓冲区交给后台线程写出并在其后执行fdatasync，覆盖之前交付的所有缓冲区，不等待完成
+    void Flush() override;
+
+    /**
+     * @param dir_name 日志文件输出目录
+     * @param rotation_policy 切分策略，默认超过10MB或者整15分钟时切分
+     * @param buffer_size 写缓冲区大小，向上取整为4KB的倍数，最小能容纳一条默认最大长度的日志，
+     *                    放不下的日志被丢弃
+     * @param buffer_count 写缓冲区个数，最少2个
+     * @param drop_when_full 所有缓冲区都在写时是否丢弃日志，false表示等待空闲缓冲区
+     * @return 创建失败时返回nullptr
+     */
+    static std::shared_ptr<UringFileLogger> Create(const std::string& dir_name,
+                                                   const RotationPolicy& rotation_policy = RotationPolicy(),
+                                                   size_t buffer_size = kDefaultBufferSize,
+                                                   size_t buffer_count = kDefaultBufferCount,
+                                                   bool drop_when_full = false);
+
+    /**
+     * 设置日志文件写完（重命名为.log）后的回调，如交给LogCompressor压缩
+     * @param callback 在写日志的线程或者后台I/O线程中调用，不能阻塞
+     */
+    void SetRotateCallback(RotateCallback callback);
+
+    /**
+     * @return 是否使用io_uring，false表示使用I/O线程池
+     */
+    bool IsUringEnabled() const { return uring_ != nullptr; }
+
+    /**
+     * @return 丢弃的日志条数，包括没有空闲缓冲区、日志文件打开失败和写文件失败丢弃的日志
+     */
+    uint64_t GetDroppedCount() const { return dropped_count_.load(std::memory_order_relaxed); }
+
+  private:
+    struct LogFile;
+    struct Buffer;
+
+    UringFileLogger(const std::string& dir_name, const RotationPolicy& rotation_policy, size_t buffer_size,
+                    size_t buffer_count, bool drop_when_full);
+
+    bool Init();
+
+    /**
+     * 创建io_uring实例并注册缓冲区
+     * @return 内核不支持io_uring或者不支持需要的操作时返回false
+     */
+    bool InitUring();
+
+    /**
+     * 恢复上次运行遗留的正在写入的日志文件，继续在其后写入
+     */
+    void RecoverLoggingFile();
+
+    /**
+     * 检查并切分日志，调用方需要持有mutex_
+     * @param cur_time 当前日志的时间戳
+     */
+    void CheckFileAndRotate(time_t cur_time);
+
+    /**
+     * 打开日志文件，已存在时在其后继续写入
+     * @return 失败时返回nullptr
+     */
+    LogFile* OpenLogFile(time_t ts, int log_index);
+
+    /**
+     * 关闭日志文件并重命名为.log，调用方需要持有mutex_，且文件上没有正在进行的写操作
+     */
+    void FinishLogFile(LogFile* log_file);
+
+    /**
+     * 把当前缓冲区交给后台线程，调用方需要持有mutex_
+     * @param sync 写完后是否执行fdatasync
+     */
+    void SubmitCurrentBuffer(bool sync);
+
+    /**
+     * 后台线程写完一个缓冲区后调用，调用方需要持有mutex_
+     */
+    void CompleteBuffer(Buffer* buffer);
+
+    /**
+     * 线程池模式下写完一个缓冲区后判断是否由它执行fdatasync，调用方需要持有mutex_
+     * @return 文件有等待的fdatasync且同一文件中更早交付的缓冲区都已经写完时返回true
+     */
+    bool TakeSync(const Buffer* buffer);
+
+    /**
+     * 写失败时丢弃缓冲区中剩余的数据，其中的日志计入丢弃条数
+     */
+    void DiscardBuffer(Buffer* buffer);
+
+    /**
+     * 把缓冲区的写操作（以及链接的fdatasync）放入io_uring提交队列
+     */
+    void PrepareUringWrite(Buffer* buffer);
+
+    // io_uring模式下的后台线程
+    void RunUring();
+    // 线程池模式下的后台线程
+    void RunWorker();
+
+  private:
+    // mutex_ 保护下面除了统计以外的所有成员
+    std::mutex mutex_;
+    // 有新的缓冲区要写或者需要退出时通知后台线程
+    std::condition_variable io_cond_;
+    // 有缓冲区写完时通知等待空闲缓冲区的线程
+    std::condition_variable free_cond_;
+    // 日志文件输出目录
+    const std::string dir_name_;
+    // 切分策略
+    const RotationPolicy rotation_policy_;
+    // 单个文件的大小上限，不按大小切分时为最大值
+    const size_t max_file_size_;
+    // 写缓冲区大小
+    const size_t buffer_size_;
+    // 所有缓冲区都在写时是否丢弃日志
+    const bool drop_when_full_;
+    // 所有写缓冲区
+    std::vector<Buffer> buffers_;
+    // 空闲的写缓冲区
+    std::vector<Buffer*> free_buffers_;
+    // 正在格式化日志的缓冲区，为nullptr时写日志前从free_buffers_中获取
+    Buffer* current_buffer_;
+    // 等待后台线程写出的缓冲区
+    std::deque<Buffer*> pending_buffers_;
+    // 当前日志文件
+    LogFile* current_file_;
+    // 当前时间节点下输出日志文件的序号
+    int log_index_;
+    // 当前文件的下一个切分时间点
+    time_t next_rotate_time_;
+    // 最近交付给后台线程的缓冲区序号
+    uint64_t submit_seq_;
+    // 日志文件写完后的回调
+    RotateCallback rotate_callback_;
+    // 析构时通知后台线程写完剩余的缓冲区后退出
+    bool stopping_;
+    // io_uring实例，为nullptr时使用线程池
+    std::unique_ptr<IoUring> uring_;
+    // 缓冲区是否已注册为io_uring的固定缓冲区
+    bool buffers_registered_;
+    // 后台线程
+    std::vector<std::thread> io_threads_;
+    // 丢弃的日志条数
+    std::atomic<uint64_t> dropped_count_;
+};
+
+typedef std::shared_ptr<UringFileLogger> UringFileLoggerPtr;
+}  // namespace Nlog
@@ -0,0 +1,175 @@
+// 把二进制日志文件还原为文本日志，输出到标准输出
+// 用法: nlog_decode <binary_log_file> [header_pattern]
+// 同一线程的日志按打印顺序输出，不同线程的日志按后台线程写入的数据块交错
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "../src/details/BinaryLog.h"
+#include "../src/details/HeaderPattern.h"
+#include "../src/details/LogMessage.h"
+
+namespace
+{
+// 解码后的调用点
+struct DecodedSite
+{
+    bool valid = false;
+    Nlog::LogSeverity severity = Nlog::INFO;
+    int line = 0;
+    std::string file;
+    std::string func;
+    std::string module;
+    std::string format;
+    std::string arg_types;
+};
+
+// 与Logger::DEFAULT_PATTERN一致
+const char kDefaultHeaderPattern[] = "[%Y-%M-%D %h:%m:%s.%i][%V][%T][%F:%L][%U]";
+
+bool ReadBytes(FILE* file, void* data, size_t length) { return fread(data, 1, length, file) == length; }
+
+bool ReadString(FILE* file, std::string& str)
+{
+    uint32_t length = 0;
+    if (!ReadBytes(file, &length, sizeof(length))) return false;
+    str.resize(length);
+    return length == 0 || ReadBytes(file, &str[0], length);
+}
+
+bool ReadSite(FILE* file, std::vector<DecodedSite>& sites)
+{
+    uint32_t site_id = 0;
+    uint32_t severity = 0;
+    int32_t line = 0;
+    if (!ReadBytes(file, &site_id, sizeof(site_id)) || !ReadBytes(file, &severity, sizeof(severity)) ||
+        !ReadBytes(file, &line, sizeof(line)) || site_id == 0)
+    {
+        return false;
+    }
+    if (site_id >= sites.size()) sites.resize(site_id + 1);
+
+    DecodedSite& site = sites[site_id];
+    site.severity = static_cast<Nlog::LogSeverity>(severity);
+    site.line = line;
+    site.valid = ReadString(file, site.file) && ReadString(file, site.func) && ReadString(file, site.module) &&
+                 ReadString(file, site.format) && ReadString(file, site.arg_types);
+    return site.valid;
+}
+
+// 输出一个数据块中的所有记录，返回false表示数据损坏
+bool DecodeBlock(const std::vector<char>& block, long thread_id, const std::vector<DecodedSite>& sites,
+                 const Nlog::HeaderPattern& header_pattern)
+{
+    // 文本长度按默认的最大长度限制
+    std::vector<char> text(Nlog::LogStream::kDefaultMaxSize + Nlog::LogStream::kReservedSize);
+    char header[Nlog::HeaderPattern::kMaxHeaderSize];
+    std::vector<Nlog::BinaryArgValue> args;
+
+    size_t pos = 0;
+    while (pos + sizeof(Nlog::BinaryRecordHeader) <= block.size())
+    {
+        Nlog::BinaryRecordHeader record;
+        memcpy(&record, &block[pos], sizeof(record));
+        if (record.length < sizeof(record) || record.length > block.size() - pos) return false;
+        if (record.site_id >= sites.size() || !sites[record.site_id].valid) return false;
+
+        const DecodedSite& site = sites[record.site_id];
+        args.resize(site.arg_types.size() + 1);
+        if (!Nlog::DecodeBinaryArgs(site.arg_types.c_str(), &block[pos + sizeof(record)],
+                                    record.length - sizeof(record), args.data()))
+        {
+            return false;
+        }
+
+        Nlog::LogStream stream(text.data(), Nlog::LogStream::kDefaultMaxSize);
+        stream << "<" << site.module << ">";
+        Nlog::FormatBinaryLog(stream, site.format.c_str(), args.data(), site.arg_types.size());
+        size_t text_length = stream.Finish();
+
+        struct timeval tv;
+        tv.tv_sec = record.timestamp_us / 1000000;
+        tv.tv_usec = record.timestamp_us % 1000000;
+        Nlog::LogSite log_site(site.severity, site.file.c_str(), site.file.size(), site.func.c_str(), site.func.size(),
+                               site.line, site.module.c_str());
+        Nlog::LogMessage log_message(log_site, tv, thread_id, text.data(), text_length);
+        size_t header_length = header_pattern.Format(log_message, header, sizeof(header));
+        fwrite(header, 1, header_length, stdout);
+        fwrite(text.data(), 1, text_length, stdout);
+
+        pos += record.length;
+    }
+    return pos == block.size();
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <binary_log_file> [header_pattern]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    Nlog::HeaderPattern header_pattern(argc > 2 ? argv[2] : kDefaultHeaderPattern);
+    std::vector<DecodedSite> sites;
+    std::vector<char> block;
+    bool has_magic = false;
+    bool ok = true;
+
+    int entry_type;
+    while (ok && (entry_type = fgetc(file)) != EOF)
+    {
+        if (entry_type == Nlog::kBinaryLogMagic[0])
+        {
+            // 新的文件头，调用点ID重新编号
+            char magic[Nlog::kBinaryLogMagicSize];
+            magic[0] = static_cast<char>(entry_type);
+            ok = ReadBytes(file, magic + 1, sizeof(magic) - 1) && memcmp(magic, Nlog::kBinaryLogMagic, sizeof(magic)) == 0;
+            sites.clear();
+            has_magic = true;
+        }
+        else if (!has_magic)
+        {
+            ok = false;
+        }
+        else if (entry_type == Nlog::kBinarySiteEntry)
+        {
+            ok = ReadSite(file, sites);
+        }
+        else if (entry_type == Nlog::kBinaryBlockEntry)
+        {
+            int64_t thread_id = 0;
+            uint32_t length = 0;
+            ok = ReadBytes(file, &thread_id, sizeof(thread_id)) && ReadBytes(file, &length, sizeof(length));
+            if (ok)
+            {
+                block.resize(length);
+                ok = length == 0 || ReadBytes(file, block.data(), length);
+            }
+            ok = ok && DecodeBlock(block, static_cast<long>(thread_id), sites, header_pattern);
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    fclose(file);
+    if (!ok)
+    {
+        fprintf(stderr, "%s: corrupted or truncated binary log\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}